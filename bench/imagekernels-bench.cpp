@@ -0,0 +1,300 @@
+// Times every image kernel at each level the processor supports and checks
+// that the vectorized levels produce the same bytes as the scalar one. Edge
+// cases are checked first, with --check nothing else is run. Built with
+// -DDISK_DABBLE_BENCHMARKS=ON.
+
+#include "imagedecoder.h"
+#include "imagekernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define BENCH_WIDTH 6000
+#define BENCH_HEIGHT 4000
+#define BENCH_RUNS 3
+
+static const KernelLevels levels[] = {
+    KernelLevels::Scalar,
+    KernelLevels::Sse2,
+    KernelLevels::Avx2,
+};
+
+static const char *LevelName(
+    KernelLevels level)
+{
+    switch (level)
+    {
+        case KernelLevels::Sse2:
+            return "sse2";
+        case KernelLevels::Avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+static std::shared_ptr<DecodedImage> MakeImage(
+    const std::vector<unsigned char> &pixels)
+{
+    auto copy = static_cast<unsigned char *>(malloc(pixels.size()));
+    memcpy(copy, pixels.data(), pixels.size());
+
+    return std::make_shared<DecodedImage>(BENCH_WIDTH, BENCH_HEIGHT, copy);
+}
+
+static std::vector<unsigned char> Bytes(
+    const std::shared_ptr<DecodedImage> &image)
+{
+    return std::vector<unsigned char>(image->Pixels(), image->Pixels() + image->ByteSize());
+}
+
+// Times run at every level and compares what output returns afterwards,
+// outside of the timing. Returns false when a level differs from the scalar
+// output.
+static bool Bench(
+    const char *name,
+    const std::function<void()> &run,
+    const std::function<std::vector<unsigned char>()> &output)
+{
+    std::vector<unsigned char> expected;
+    auto isEqual = true;
+
+    for (auto level : levels)
+    {
+        ImageKernels::SetLevel(level);
+        if (ImageKernels::Level() != level)
+        {
+            printf("%-24s %-7s not supported\n", name, LevelName(level));
+            continue;
+        }
+
+        auto best = 0.0;
+
+        for (int i = 0; i < BENCH_RUNS; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            best = i == 0 ? elapsed : std::min(best, elapsed);
+        }
+
+        if (level == KernelLevels::Scalar)
+        {
+            expected = output();
+            printf("%-24s %-7s %9.2f ms\n", name, LevelName(level), best);
+        }
+        else
+        {
+            auto isSame = output() == expected;
+            isEqual = isEqual && isSame;
+            printf("%-24s %-7s %9.2f ms%s\n", name, LevelName(level), best, isSame ? "" : "  differs from scalar");
+        }
+    }
+
+    ImageKernels::SetLevel(KernelLevels::Avx2);
+
+    return isEqual;
+}
+
+// Downscale of images with a side shorter than the factor, the blocks on the
+// edges are clamped to the image. Every level is compared with averages
+// computed here, rounding may differ by one.
+static bool CheckDownscaleEdges()
+{
+    std::mt19937 random(2);
+    auto isCorrect = true;
+
+    struct Size
+    {
+        int width;
+        int height;
+        int maxDimension;
+    };
+
+    for (auto size : {Size{2, 3000, 1024}, Size{3000, 2, 1024}, Size{1, 4099, 1024}, Size{7, 5, 2}, Size{1, 1, 1}})
+    {
+        std::vector<unsigned char> pixels(static_cast<size_t>(size.width) * size.height * 4);
+        for (auto &value : pixels)
+        {
+            value = static_cast<unsigned char>(random());
+        }
+
+        auto copy = static_cast<unsigned char *>(malloc(pixels.size()));
+        memcpy(copy, pixels.data(), pixels.size());
+        DecodedImage image(size.width, size.height, copy);
+
+        auto factor = (std::max(size.width, size.height) + size.maxDimension - 1) / size.maxDimension;
+        auto width = (size.width + factor - 1) / factor;
+        auto height = (size.height + factor - 1) / factor;
+
+        for (auto level : levels)
+        {
+            ImageKernels::SetLevel(level);
+            if (ImageKernels::Level() != level)
+            {
+                continue;
+            }
+
+            auto result = ImageDecoder::Downscale(image, size.maxDimension);
+            auto isSame = result != nullptr && result->Width() == width && result->Height() == height;
+
+            for (int y = 0; isSame && y < height; y++)
+            {
+                for (int x = 0; isSame && x < width; x++)
+                {
+                    auto columns = std::min(factor, size.width - x * factor);
+                    auto rows = std::min(factor, size.height - y * factor);
+
+                    for (int channel = 0; channel < 4; channel++)
+                    {
+                        double sum = 0;
+                        for (int row = 0; row < rows; row++)
+                        {
+                            for (int column = 0; column < columns; column++)
+                            {
+                                sum += pixels[(static_cast<size_t>(y * factor + row) * size.width + x * factor + column) * 4 + channel];
+                            }
+                        }
+
+                        auto expected = static_cast<int>(sum / (rows * columns) + 0.5);
+                        auto actual = static_cast<int>(result->Pixels()[(static_cast<size_t>(y) * width + x) * 4 + channel]);
+                        isSame = isSame && std::abs(expected - actual) <= 1;
+                    }
+                }
+            }
+
+            if (!isSame)
+            {
+                printf("Downscale %dx%d to %d %-7s is wrong\n", size.width, size.height, size.maxDimension, LevelName(level));
+            }
+
+            isCorrect = isCorrect && isSame;
+        }
+    }
+
+    ImageKernels::SetLevel(KernelLevels::Avx2);
+
+    return isCorrect;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    if (!CheckDownscaleEdges())
+    {
+        return 1;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+    {
+        printf("Edge cases are correct\n");
+
+        return 0;
+    }
+
+    std::mt19937 random(1);
+
+    // Noise with smooth gradients mixed in, so neither the flat nor the
+    // random case is the only one measured
+    size_t pixelCount = static_cast<size_t>(BENCH_WIDTH) * BENCH_HEIGHT;
+    std::vector<unsigned char> rgba(pixelCount * 4);
+    for (size_t i = 0; i < rgba.size(); i++)
+    {
+        auto pixel = i / 4;
+        rgba[i] = (pixel / 64) % 2 == 0 ? static_cast<unsigned char>(random()) : static_cast<unsigned char>(pixel % BENCH_WIDTH + i % 4);
+    }
+
+    std::vector<unsigned char> rgb(pixelCount * 3);
+    for (size_t i = 0; i < rgb.size(); i++)
+    {
+        rgb[i] = rgba[i];
+    }
+
+    auto image = MakeImage(rgba);
+    auto isEqual = true;
+
+    // Outputs are allocated up front, only the kernels that return an image
+    // allocate while they are timed, like they do when they are used
+    std::vector<unsigned char> output(pixelCount * 4);
+    std::shared_ptr<DecodedImage> outputImage;
+
+    auto outputBytes = [&]() { return output; };
+    auto outputImageBytes = [&]() { return Bytes(outputImage); };
+
+    isEqual &= Bench(
+        "ExpandRgbToRgba",
+        [&]() { ImageKernels::ExpandRgbToRgba(rgb.data(), output.data(), pixelCount); },
+        outputBytes);
+
+    for (auto factor : {2, 3, 8})
+    {
+        auto name = "BoxDownsample /" + std::to_string(factor);
+        auto width = (BENCH_WIDTH + factor - 1) / factor;
+        auto height = (BENCH_HEIGHT + factor - 1) / factor;
+
+        isEqual &= Bench(
+            name.c_str(),
+            [&]() { ImageKernels::BoxDownsample(rgba.data(), BENCH_WIDTH * 4, BENCH_WIDTH, BENCH_HEIGHT, factor, output.data(), static_cast<size_t>(width) * 4); },
+            [&]() { return std::vector<unsigned char>(output.begin(), output.begin() + static_cast<size_t>(width) * height * 4); });
+    }
+
+    std::vector<uint32_t> counts(1024);
+    isEqual &= Bench(
+        "Histogram",
+        [&]() {
+            std::fill(counts.begin(), counts.end(), 0);
+            ImageKernels::Histogram(rgba.data(), pixelCount, counts.data());
+        },
+        [&]() {
+            auto bytes = reinterpret_cast<const unsigned char *>(counts.data());
+            return std::vector<unsigned char>(bytes, bytes + counts.size() * sizeof(uint32_t));
+        });
+
+    // Flat areas are where counting into separate copies pays off
+    std::vector<unsigned char> flat(pixelCount * 4, 128);
+    isEqual &= Bench(
+        "Histogram flat",
+        [&]() {
+            std::fill(counts.begin(), counts.end(), 0);
+            ImageKernels::Histogram(flat.data(), pixelCount, counts.data());
+        },
+        [&]() {
+            auto bytes = reinterpret_cast<const unsigned char *>(counts.data());
+            return std::vector<unsigned char>(bytes, bytes + counts.size() * sizeof(uint32_t));
+        });
+
+    isEqual &= Bench(
+        "LanczosResize 1920x1280",
+        [&]() { outputImage = ImageKernels::LanczosResize(*image, 1920, 1280); },
+        outputImageBytes);
+
+    for (int orientation = 2; orientation <= 8; orientation++)
+    {
+        auto name = "Orient " + std::to_string(orientation);
+
+        isEqual &= Bench(
+            name.c_str(),
+            [&]() { outputImage = ImageKernels::Orient(*image, orientation); },
+            outputImageBytes);
+    }
+
+    if (!isEqual)
+    {
+        printf("Some levels differ from the scalar output\n");
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef AHOCORASICK_H
+#define AHOCORASICK_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class AhoCorasick
+{
+public:
+    typedef std::function<void(int patternIndex, size_t endOffset)> MatchFunc;
+
+    int AddPattern(
+        const std::string &pattern);
+
+    void Build();
+
+    bool IsBuilt() const { return _isBuilt; }
+
+    size_t PatternCount() const { return _patterns.size(); }
+
+    const std::string &Pattern(
+        int index) const { return _patterns[index]; }
+
+    // The returned state can be passed to the next call so a text can be fed
+    // in pieces, matches that span two pieces are still reported.
+    int Scan(
+        int state,
+        const char *data,
+        size_t size,
+        const MatchFunc &onMatch) const;
+
+    void FindAll(
+        const std::string &text,
+        const MatchFunc &onMatch) const;
+
+    static constexpr int InitialState = 0;
+
+private:
+    std::vector<std::string> _patterns;
+    std::vector<int> _transitions;
+    std::vector<std::vector<int>> _outputs;
+    bool _isBuilt = false;
+
+    int AddState();
+};
+
+#endif // AHOCORASICK_H
@@ -0,0 +1,126 @@
+#ifndef ANIMATIONPLAYER_H
+#define ANIMATIONPLAYER_H
+
+#include "framescheduler.h"
+#include "gifdecoder.h"
+#include "workerpool.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <imgui.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define ANIMATION_ATLAS_FRAMES 16
+#define ANIMATION_ATLAS_BUDGET (64ull * 1024 * 1024)
+#define ANIMATION_DECODE_AHEAD 4
+#define ANIMATION_DEFAULT_DELAY 100
+
+// Plays an animated gif. Frames are decoded on the worker pool a few ahead
+// of playback and uploaded into the slots of an atlas texture. When the
+// whole animation fits in the atlas it is decoded once and then played from
+// the atlas, longer animations keep streaming through the slots.
+class AnimationPlayer
+{
+public:
+    AnimationPlayer(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler);
+
+    virtual ~AnimationPlayer();
+
+    void Open(
+        const std::filesystem::path &path);
+
+    void Close();
+
+    // Uploads decoded frames and moves on when the delay of the current
+    // frame has passed. On the GL thread, every frame.
+    void Update();
+
+    // False for gifs with a single frame, those are shown as a still image
+    bool IsPlaying() const;
+
+    unsigned int TextureId() const { return _textureId; }
+
+    ImVec2 Size() const;
+
+    // The part of the atlas with the current frame
+    void CurrentFrame(
+        ImVec2 &uvMin,
+        ImVec2 &uvMax) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct DecodedFrame
+    {
+        int index = 0;
+        int delay = 0;
+        std::shared_ptr<DecodedImage> image;
+    };
+
+    // Shared with the decode job on the worker pool, so it can outlive the player
+    struct DecodeQueue
+    {
+        std::filesystem::path path;
+        int maxTextureSize = 0;
+        GifDecoder decoder;
+        bool isOpen = false;
+        std::atomic<bool> isCancelled = false;
+
+        std::mutex mutex;
+        bool isDecoding = false;
+        bool isFinished = false;
+        int width = 0;
+        int height = 0;
+        int slotCount = 0;
+        int nextIndex = 0;
+        int frameCount = 0; // Known once the end was reached
+        std::deque<DecodedFrame> frames;
+    };
+
+    struct AtlasFrame
+    {
+        int slot = 0;
+        int delay = 0;
+    };
+
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    std::shared_ptr<DecodeQueue> _decodeQueue;
+    unsigned int _textureId = 0;
+    int _frameWidth = 0;
+    int _frameHeight = 0;
+    int _columns = 0;
+    int _slotCount = 0;
+    std::vector<int> _slotDelays;
+    int _uploadedCount = 0;
+    int _frameCount = 0;
+    bool _isFullyCached = false;
+    std::deque<AtlasFrame> _playQueue;
+    Clock::time_point _frameShownAt;
+
+    void CreateAtlas(
+        int width,
+        int height,
+        int slotCount);
+
+    void Upload(
+        const DecodedFrame &frame);
+
+    void Advance();
+
+    static int SlotCount(
+        int width,
+        int height,
+        int maxTextureSize);
+
+    static void DecodeFrames(
+        std::shared_ptr<DecodeQueue> decodeQueue,
+        FrameScheduler *frameScheduler);
+};
+
+#endif // ANIMATIONPLAYER_H
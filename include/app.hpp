@@ -1,13 +1,23 @@
 #ifndef APP_H
 #define APP_H
 
+#include <decodedimagecache.h>
+#include <exifindex.h>
+#include <framescheduler.h>
+#include <histogramcache.h>
+#include <imagedirectoryindex.h>
 #include <imgui.h>
 #include <memory>
+#include <metadataindex.h>
 #include <opendocument.h>
 #include <serviceprovider.h>
 #include <settingsservice.h>
 #include <string>
+#include <texturecache.h>
+#include <textureuploader.h>
+#include <thumbnailcache.h>
 #include <vector>
+#include <workerpool.h>
 
 class App
 {
@@ -41,6 +51,16 @@ protected:
 private:
     ServiceProvider _services;
     SettingsService _settingsService;
+    FrameScheduler _frameScheduler;
+    WorkerPool _workerPool;
+    TextureUploader _textureUploader;
+    TextureCache _textureCache;
+    DecodedImageCache _decodedImageCache;
+    HistogramCache _histogramCache;
+    ThumbnailCache _thumbnailCache;
+    ExifIndex _exifIndex;
+    ImageDirectoryIndex _imageDirectoryIndex;
+    MetadataIndex _metadataIndex;
     void *_windowHandle;
     unsigned int _dockId;
     ImFont *_monoSpaceFont = nullptr;
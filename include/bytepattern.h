@@ -0,0 +1,38 @@
+#ifndef BYTEPATTERN_H
+#define BYTEPATTERN_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class BytePattern
+{
+public:
+    // Parses hex bytes like "4D 5A ?? 00", "??" (or "?") matches any byte
+    bool Parse(
+        const std::string &text);
+
+    size_t Size() const { return _bytes.size(); }
+
+    bool IsEmpty() const { return _bytes.empty(); }
+
+    std::string ToString() const;
+
+    // Calls onMatch with the offset of every match, stops early when onMatch
+    // returns false
+    void FindAll(
+        const unsigned char *data,
+        size_t size,
+        const std::function<bool(size_t offset)> &onMatch) const;
+
+private:
+    std::vector<unsigned char> _bytes;
+    std::vector<bool> _isWildcard;
+    size_t _firstFixed = 0;
+    size_t _lastFixed = 0;
+
+    bool MatchesAt(
+        const unsigned char *data) const;
+};
+
+#endif // BYTEPATTERN_H
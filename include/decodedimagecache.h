@@ -0,0 +1,101 @@
+#ifndef DECODEDIMAGECACHE_H
+#define DECODEDIMAGECACHE_H
+
+#include "framescheduler.h"
+#include "imagedecoder.h"
+#include "workerpool.h"
+#include <condition_variable>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#define DECODED_IMAGE_CACHE_BUDGET (1024ull * 1024 * 1024)
+
+enum class DecodeStates
+{
+    NotCached,
+    Queued,
+    Decoding,
+    Ready,
+    Failed,
+};
+
+struct DecodeRequest
+{
+    // Decodes the thumbnail embedded in the EXIF data instead of the image
+    static constexpr int EmbeddedThumbnail = -1;
+
+    std::filesystem::path path;
+    int maxDimension = 0; // 0 decodes at full resolution
+
+    bool operator<(
+        const DecodeRequest &other) const
+    {
+        return path < other.path || (path == other.path && maxDimension < other.maxDimension);
+    }
+};
+
+// Decoded pixels shared by all image widgets. Widgets tell the cache which
+// images they want, in order of importance; decodes that nobody wants any
+// more are dropped before they start. Images that are no longer wanted stay
+// cached until the budget runs out, least recently used go first.
+class DecodedImageCache
+{
+public:
+    DecodedImageCache(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler,
+        size_t budget = DECODED_IMAGE_CACHE_BUDGET);
+
+    virtual ~DecodedImageCache();
+
+    // The first request is the image the owner shows, the others are prefetched
+    void Request(
+        int owner,
+        const std::vector<DecodeRequest> &requests);
+
+    void Release(
+        int owner);
+
+    DecodeStates Lookup(
+        const DecodeRequest &request,
+        std::shared_ptr<DecodedImage> &image);
+
+    size_t Budget() const { return _budget; }
+
+    void SetBudget(
+        size_t budget);
+
+    size_t UsedBytes();
+
+private:
+    struct Entry
+    {
+        DecodeStates state = DecodeStates::Queued;
+        std::shared_ptr<DecodedImage> image;
+        std::set<int> wantedBy;
+        std::list<DecodeRequest>::iterator lruPosition;
+    };
+
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    size_t _budget;
+    size_t _usedBytes = 0;
+    std::mutex _mutex;
+    std::map<DecodeRequest, Entry> _entries;
+    std::list<DecodeRequest> _lru;
+    std::condition_variable _jobsDone;
+    int _jobsInFlight = 0;
+    bool _isStopping = false;
+
+    void Decode(
+        const DecodeRequest &request);
+
+    void Evict();
+};
+
+#endif // DECODEDIMAGECACHE_H
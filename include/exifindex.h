@@ -0,0 +1,103 @@
+#ifndef EXIFINDEX_H
+#define EXIFINDEX_H
+
+#include "framescheduler.h"
+#include "workerpool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sqlitelib.h>
+#include <string>
+#include <vector>
+
+#define EXIF_HEADER_SIZE (128 * 1024)
+#define EXIF_SCAN_BATCH 32
+
+struct ExifInfo
+{
+    double size = 0;
+    double modified = 0;
+    std::string captureTime; // As the camera wrote it, "YYYY:MM:DD HH:MM:SS" sorts as text
+    std::string camera;
+    int orientation = 1;
+    int width = 0;
+    int height = 0;
+};
+
+// Capture time, camera and dimensions of the images in a directory. Only the
+// first bytes of each file are read, on the worker pool in batches. Results
+// are stored in a database under the user profile and checked against the
+// size and modification time of the file, so a directory that was seen
+// before is scanned without reading any image.
+class ExifIndex
+{
+public:
+    ExifIndex(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler);
+
+    virtual ~ExifIndex();
+
+    bool Open(
+        const std::filesystem::path &databaseFile);
+
+    // Returns right away, a directory that is already being scanned is skipped
+    void Scan(
+        const std::filesystem::path &directory);
+
+    // Returns false when the image was not scanned yet
+    bool Lookup(
+        const std::filesystem::path &path,
+        ExifInfo &info);
+
+    // Changes every time scanned images become available
+    int Generation() const { return _generation; }
+
+    // Oldest first, images without a capture time keep their order after the others
+    void SortByCaptureTime(
+        std::vector<std::filesystem::path> &paths);
+
+    static bool Read(
+        const std::filesystem::path &path,
+        ExifInfo &info);
+
+private:
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    std::mutex _mutex;
+    std::map<std::filesystem::path, ExifInfo> _infos;
+    std::set<std::filesystem::path> _scanning;
+    std::atomic<int> _generation = 0;
+    std::condition_variable _jobsDone;
+    int _jobsInFlight = 0;
+    bool _isStopping = false;
+
+    std::unique_ptr<sqlitelib::Sqlite> _db;
+    std::mutex _dbMutex;
+
+    void EnsureTables();
+
+    void ScanDirectory(
+        const std::filesystem::path &directory);
+
+    void ReadBatch(
+        const std::filesystem::path &directory,
+        std::vector<std::pair<std::filesystem::path, ExifInfo>> batch,
+        std::shared_ptr<std::atomic<int>> batchesLeft);
+
+    std::map<std::filesystem::path, ExifInfo> Load(
+        const std::filesystem::path &directory);
+
+    void Store(
+        const std::filesystem::path &directory,
+        const std::vector<std::pair<std::filesystem::path, ExifInfo>> &infos);
+
+    void FinishJob();
+};
+
+#endif // EXIFINDEX_H
@@ -0,0 +1,43 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+// The main loop sleeps until there is input. Work that finishes in the
+// background, or that is spread over several frames, asks for a frame here.
+class FrameScheduler
+{
+public:
+    typedef std::function<void()> WakeFunc;
+
+    // Called from any thread when a frame is requested, it should make the
+    // main loop stop waiting for events
+    void SetWake(
+        WakeFunc wake);
+
+    // Thread safe, the next frame is rendered as soon as possible
+    void RequestFrame();
+
+    // Thread safe, the main loop wakes up by itself after the delay
+    void RequestFrameIn(
+        std::chrono::milliseconds delay);
+
+    // Seconds the main loop may wait for events before the next requested
+    // frame, negative when no frame is requested. Takes the request.
+    double TakeWaitTime();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::mutex _mutex;
+    WakeFunc _wake;
+    bool _isRequested = false;
+    Clock::time_point _nextFrame;
+
+    void Request(
+        Clock::time_point time);
+};
+
+#endif // FRAMESCHEDULER_H
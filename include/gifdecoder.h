@@ -0,0 +1,57 @@
+#ifndef GIFDECODER_H
+#define GIFDECODER_H
+
+#include "imagedecoder.h"
+#include "mappedfile.h"
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Decodes the frames of a gif one at a time, so a long animation never has
+// to be in memory at once. stb_image can only load all frames together.
+class GifDecoder
+{
+public:
+    GifDecoder();
+
+    GifDecoder(const GifDecoder &) = delete;
+    GifDecoder &operator=(const GifDecoder &) = delete;
+
+    virtual ~GifDecoder();
+
+    bool Open(
+        const std::filesystem::path &path);
+
+    // Returns nullptr after the last frame, or when the gif is corrupt.
+    // The delay is in milliseconds.
+    std::shared_ptr<DecodedImage> Next(
+        int &delay);
+
+    // Starts over at the first frame
+    void Rewind();
+
+    int Width() const { return _width; }
+
+    int Height() const { return _height; }
+
+    static bool IsGif(
+        const std::filesystem::path &path);
+
+private:
+    struct State;
+
+    MappedFile _file;
+    std::unique_ptr<State> _state;
+    int _width = 0;
+    int _height = 0;
+
+    // The previous frame and the one before it, a frame can be disposed by
+    // restoring to what was there before
+    std::vector<unsigned char> _previous;
+    std::vector<unsigned char> _twoBack;
+    int _decodedCount = 0;
+
+    void Reset();
+};
+
+#endif // GIFDECODER_H
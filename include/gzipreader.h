@@ -0,0 +1,47 @@
+#ifndef GZIPREADER_H
+#define GZIPREADER_H
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+class GzipReader
+{
+public:
+    GzipReader();
+
+    virtual ~GzipReader();
+
+    bool Open(
+        const std::filesystem::path &path);
+
+    // Inflates at most size bytes into buffer, returns 0 at the end of the
+    // stream or when the data is not valid gzip
+    size_t Read(
+        char *buffer,
+        size_t size);
+
+    bool HasError() const { return _hasError; }
+
+    static bool IsGzipFile(
+        const std::filesystem::path &path);
+
+private:
+    std::ifstream _file;
+    std::unique_ptr<struct mz_stream_s> _stream;
+    std::vector<unsigned char> _input;
+    size_t _inputPos = 0;
+    size_t _inputEnd = 0;
+    bool _inMember = false;
+    bool _hasError = false;
+
+    bool EnsureInput(
+        size_t count);
+
+    bool ReadMemberHeader();
+
+    void EndStream();
+};
+
+#endif // GZIPREADER_H
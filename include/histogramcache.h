@@ -0,0 +1,79 @@
+#ifndef HISTOGRAMCACHE_H
+#define HISTOGRAMCACHE_H
+
+#include "decodedimagecache.h"
+#include "framescheduler.h"
+#include "imagedecoder.h"
+#include "workerpool.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#define HISTOGRAM_CACHE_SIZE 32
+#define HISTOGRAM_STRIPE_PIXELS (1024 * 1024)
+
+struct ImageHistogram
+{
+    // Red, green, blue and alpha after each other, 256 counts each
+    std::array<uint32_t, 4 * 256> counts = {};
+    size_t countedPixels = 0;
+    size_t totalPixels = 0;
+
+    bool IsComplete() const { return totalPixels > 0 && countedPixels == totalPixels; }
+};
+
+// Per channel histograms of decoded images. The pixels are counted on the
+// worker pool in stripes, every stripe that is done is added to the result
+// right away, so large images show a histogram that fills in instead of
+// holding anything up. The last images asked for are kept.
+class HistogramCache
+{
+public:
+    HistogramCache(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler,
+        size_t capacity = HISTOGRAM_CACHE_SIZE);
+
+    virtual ~HistogramCache();
+
+    // Starts counting when the image was not seen before under this request,
+    // the histogram is partial until IsComplete()
+    ImageHistogram Get(
+        const DecodeRequest &request,
+        const std::shared_ptr<DecodedImage> &image);
+
+private:
+    struct Entry
+    {
+        // Stripes of an entry that was evicted or replaced must not end up
+        // in its successor
+        int id = 0;
+        std::weak_ptr<DecodedImage> image;
+        ImageHistogram histogram;
+        std::list<DecodeRequest>::iterator lruPosition;
+    };
+
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    size_t _capacity;
+    std::mutex _mutex;
+    std::map<DecodeRequest, Entry> _entries;
+    std::list<DecodeRequest> _lru;
+    int _nextId = 1;
+    std::condition_variable _jobsDone;
+    int _jobsInFlight = 0;
+    bool _isStopping = false;
+
+    void CountStripe(
+        const DecodeRequest &request,
+        int id,
+        std::shared_ptr<DecodedImage> image,
+        size_t first,
+        size_t count);
+};
+
+#endif // HISTOGRAMCACHE_H
@@ -0,0 +1,42 @@
+#ifndef IMAGEARCHIVE_H
+#define IMAGEARCHIVE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#define IMAGE_ARCHIVE_MAX_MEMBER_SIZE (1024ull * 1024 * 1024)
+
+// Zip and cbz files of images, read in place without extracting them.
+// Members are addressed by paths that continue past the archive, like
+// comics/issue1.cbz/pages/001.jpg, so they go through the decode caches
+// and the image widget the same way files in a folder do.
+class ImageArchive
+{
+public:
+    typedef std::function<void(const unsigned char *data, size_t size)> ReadFunc;
+
+    static bool IsArchive(
+        const std::filesystem::path &path);
+
+    // Returns false when no part of the path is an archive file
+    static bool Split(
+        const std::filesystem::path &path,
+        std::filesystem::path &archive,
+        std::filesystem::path &member);
+
+    // The member paths of the supported images, in the order of the archive
+    static std::vector<std::filesystem::path> Images(
+        const std::filesystem::path &archive);
+
+    // Hands the bytes of a member to read. Stored members, which is what
+    // most comic archives use, come straight from the mapped archive, the
+    // others are inflated into memory first. The bytes are read only, read
+    // must not write to them.
+    static bool Read(
+        const std::filesystem::path &memberPath,
+        const ReadFunc &read);
+};
+
+#endif // IMAGEARCHIVE_H
@@ -0,0 +1,100 @@
+#ifndef IMAGEDECODER_H
+#define IMAGEDECODER_H
+
+#include <filesystem>
+#include <memory>
+
+class DecodedImage
+{
+public:
+    DecodedImage(
+        int width,
+        int height,
+        unsigned char *pixels);
+
+    virtual ~DecodedImage();
+
+    DecodedImage(const DecodedImage &) = delete;
+    DecodedImage &operator=(const DecodedImage &) = delete;
+
+    int Width() const { return _width; }
+
+    int Height() const { return _height; }
+
+    // Always 4 bytes (RGBA) per pixel
+    const unsigned char *Pixels() const { return _pixels; }
+
+    size_t ByteSize() const { return static_cast<size_t>(_width) * _height * 4; }
+
+    int orientation = 1;
+
+    // The size of the image in the file, Width() and Height() are smaller
+    // when the image was decoded at a reduced size
+    int originalWidth;
+    int originalHeight;
+
+private:
+    int _width;
+    int _height;
+    unsigned char *_pixels;
+};
+
+class ImageDecoder
+{
+public:
+    // With a maxDimension the image is scaled down until its longest side
+    // fits, 0 keeps the full resolution
+    static std::shared_ptr<DecodedImage> Decode(
+        const std::filesystem::path &path,
+        int maxDimension);
+
+    // Decodes an image file that is already in memory, like a mapped file
+    // or an archive member
+    static std::shared_ptr<DecodedImage> DecodeMemory(
+        const unsigned char *data,
+        size_t size,
+        int maxDimension);
+
+    // The small preview most cameras store in the EXIF data of a jpeg, with
+    // originalWidth and originalHeight set to the size of the full image.
+    // Only the start of the file is read. Returns nullptr when there is none.
+    static std::shared_ptr<DecodedImage> DecodeEmbeddedThumbnail(
+        const std::filesystem::path &path);
+
+    static std::shared_ptr<DecodedImage> DecodeEmbeddedThumbnail(
+        const unsigned char *data,
+        size_t size);
+
+    static std::shared_ptr<DecodedImage> Downscale(
+        const DecodedImage &image,
+        int maxDimension);
+
+    // Returns 1 (upright) for anything that is not a jpeg with EXIF data
+    static int ReadOrientation(
+        const unsigned char *data,
+        size_t size);
+
+    static bool IsSupported(
+        const std::filesystem::path &path);
+
+    static bool IsJpeg(
+        const std::filesystem::path &path);
+
+    // The rotation in radians that displays an image with the given EXIF
+    // orientation upright
+    static float OrientationToRotation(
+        int orientation);
+
+private:
+    static bool IsConvertedAfterDecoding(
+        const unsigned char *data,
+        size_t size);
+
+    static unsigned char *LoadRgbAsRgba(
+        const unsigned char *data,
+        size_t size,
+        int &width,
+        int &height);
+};
+
+#endif // IMAGEDECODER_H
@@ -0,0 +1,91 @@
+#ifndef IMAGEDIRECTORYINDEX_H
+#define IMAGEDIRECTORYINDEX_H
+
+#include "exifindex.h"
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// The images of one directory in display order
+class ImageDirectoryListing
+{
+public:
+    ImageDirectoryListing(
+        const std::filesystem::path &directory,
+        std::filesystem::file_time_type modified,
+        std::vector<std::filesystem::path> images);
+
+    const std::filesystem::path &Directory() const { return _directory; }
+
+    std::filesystem::file_time_type Modified() const { return _modified; }
+
+    size_t Count() const { return _images.size(); }
+
+    const std::filesystem::path &At(
+        size_t index) const { return _images[index]; }
+
+    // Returns -1 when path is not one of the images
+    int IndexOf(
+        const std::filesystem::path &path) const;
+
+private:
+    std::filesystem::path _directory;
+    std::filesystem::file_time_type _modified;
+    std::vector<std::filesystem::path> _images;
+    std::unordered_map<std::filesystem::path::string_type, size_t> _indices;
+};
+
+enum class ImageOrders
+{
+    Name,
+    CaptureTime,
+};
+
+// Sorted image listings shared by all image widgets. A listing is built once
+// per directory and built again only when the directory modification time
+// changes. Building a listing starts an EXIF scan of the directory, listings
+// by capture time are sorted again as the scan finds more. Zip and cbz
+// archives are listed like directories, always by name.
+class ImageDirectoryIndex
+{
+public:
+    ImageDirectoryIndex(
+        ExifIndex *exifIndex);
+
+    std::shared_ptr<const ImageDirectoryListing> Get(
+        const std::filesystem::path &directory,
+        ImageOrders order = ImageOrders::Name);
+
+    // Natural order, case insensitive and with digit runs compared as numbers,
+    // so "img2.jpg" comes before "img10.jpg"
+    static bool NaturalLess(
+        const std::filesystem::path &a,
+        const std::filesystem::path &b);
+
+private:
+    struct CaptureTimeListing
+    {
+        int generation = 0;
+        std::shared_ptr<const ImageDirectoryListing> listing;
+    };
+
+    ExifIndex *_exifIndex;
+    std::mutex _mutex;
+    std::map<std::filesystem::path, std::shared_ptr<const ImageDirectoryListing>> _listings;
+    std::map<std::filesystem::path, CaptureTimeListing> _captureTimeListings;
+
+    std::shared_ptr<const ImageDirectoryListing> GetByName(
+        const std::filesystem::path &directory);
+
+    // NaturalLess on every part of the paths, so images in the same folder
+    // of an archive stay together
+    static bool NaturalPathLess(
+        const std::filesystem::path &a,
+        const std::filesystem::path &b);
+};
+
+#endif // IMAGEDIRECTORYINDEX_H
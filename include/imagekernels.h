@@ -0,0 +1,67 @@
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#include "imagedecoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+enum class KernelLevels
+{
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+// The pixel loops behind decoding, scaling and orienting images. Every kernel
+// has a scalar version and vectorized ones, the best level the processor
+// supports is picked on first use. Pixels are RGBA unless the name says
+// otherwise.
+class ImageKernels
+{
+public:
+    static KernelLevels Level();
+
+    // For comparing the versions against each other, kernels that are
+    // running keep the level they started with
+    static void SetLevel(
+        KernelLevels level);
+
+    static void ExpandRgbToRgba(
+        const unsigned char *rgb,
+        unsigned char *rgba,
+        size_t pixelCount);
+
+    // Every target pixel is the average of a factor x factor block, blocks on
+    // the right and bottom edge are smaller when the size is not a multiple
+    // of factor. The target is ceil(width / factor) x ceil(height / factor).
+    static void BoxDownsample(
+        const unsigned char *source,
+        size_t sourceStride,
+        int width,
+        int height,
+        int factor,
+        unsigned char *target,
+        size_t targetStride);
+
+    // Adds the pixels to four histograms of 256 counts, red, green, blue and
+    // alpha after each other. Scalar at every level.
+    static void Histogram(
+        const unsigned char *rgba,
+        size_t pixelCount,
+        uint32_t *counts);
+
+    // Lanczos with three lobes, sharper than a box filter and for any size
+    static std::shared_ptr<DecodedImage> LanczosResize(
+        const DecodedImage &image,
+        int width,
+        int height);
+
+    // Turns the pixels upright for the EXIF orientation, the mirrored ones
+    // included. The result has orientation 1.
+    static std::shared_ptr<DecodedImage> Orient(
+        const DecodedImage &image,
+        int orientation);
+};
+
+#endif // IMAGEKERNELS_H
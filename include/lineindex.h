@@ -0,0 +1,107 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include "framescheduler.h"
+#include "mappedfile.h"
+#include "workerpool.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define LINE_INDEX_FIRST_CHUNK_SIZE (64 * 1024)
+#define LINE_INDEX_CHUNK_SIZE (4 * 1024 * 1024)
+
+// The start offsets of the lines of a mapped file. The file is cut into
+// chunks whose line breaks are found with vector compares on the worker
+// pool, Update() appends the chunks that are done in file order. The first
+// chunk is small, so the first screen is there right away, and the line
+// count is extrapolated from all chunks that are done until it is exact.
+class LineIndex
+{
+public:
+    LineIndex(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler);
+
+    virtual ~LineIndex();
+
+    // The file stays mapped until the jobs that read it are done
+    void Open(
+        std::shared_ptr<MappedFile> file);
+
+    void Close();
+
+    // Call before reading the index, once per frame
+    void Update();
+
+    bool IsComplete() const { return _indexedBytes == _size; }
+
+    // The part from the start of the file that is indexed
+    size_t IndexedBytes() const { return _indexedBytes; }
+
+    size_t Size() const { return _size; }
+
+    // The lines whose start is known, the last one can still be partial
+    size_t LineCount() const { return _starts.size(); }
+
+    // Extrapolated from the chunks that are done, exact when complete
+    size_t EstimatedLineCount() const;
+
+    size_t LineStart(
+        size_t line) const { return _starts[line]; }
+
+    // The end of the line without its line break
+    size_t LineEnd(
+        size_t line) const;
+
+    size_t LineOf(
+        size_t offset) const;
+
+    // Adds the offset after every '\n' in data[begin, end) to starts
+    static void FindLineStarts(
+        const char *data,
+        size_t begin,
+        size_t end,
+        std::vector<size_t> &starts);
+
+private:
+    struct Chunk
+    {
+        size_t begin = 0;
+        size_t end = 0;
+        bool isDone = false;
+        std::vector<size_t> starts;
+    };
+
+    // Shared with the jobs on the worker pool, so they can outlive the index
+    struct ChunkQueue
+    {
+        std::shared_ptr<MappedFile> file;
+        std::atomic<bool> isCancelled = false;
+
+        std::mutex mutex;
+        std::vector<Chunk> chunks;
+        size_t doneBytes = 0;
+        size_t doneLines = 0;
+    };
+
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    std::shared_ptr<ChunkQueue> _chunkQueue;
+    const char *_data = nullptr;
+    size_t _size = 0;
+    size_t _indexedBytes = 0;
+    size_t _nextChunk = 0;
+    size_t _doneBytes = 0;
+    size_t _doneLines = 0;
+    std::vector<size_t> _starts;
+
+    static void IndexChunk(
+        std::shared_ptr<ChunkQueue> chunkQueue,
+        size_t index,
+        FrameScheduler *frameScheduler);
+};
+
+#endif // LINEINDEX_H
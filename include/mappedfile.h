@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <filesystem>
+
+class MappedFile
+{
+public:
+    MappedFile();
+
+    MappedFile(
+        const MappedFile &) = delete;
+
+    MappedFile &operator=(
+        const MappedFile &) = delete;
+
+    virtual ~MappedFile();
+
+    bool Open(
+        const std::filesystem::path &path);
+
+    void Close();
+
+    bool IsOpen() const { return _isOpen; }
+
+    const unsigned char *Data() const { return _data; }
+
+    size_t Size() const { return _size; }
+
+private:
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+    bool _isOpen = false;
+#ifdef _WIN32
+    void *_fileHandle = nullptr;
+    void *_mappingHandle = nullptr;
+#else
+    int _fileDescriptor = -1;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,47 @@
+#ifndef METADATAINDEX_H
+#define METADATAINDEX_H
+
+#include "metadataquery.h"
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sqlitelib.h>
+
+class MetadataIndex
+{
+public:
+    MetadataIndex();
+
+    virtual ~MetadataIndex();
+
+    bool Open(
+        const std::filesystem::path &databaseFile);
+
+    // Returns the indexed root that contains path, or an empty path when
+    // path is not covered by the index
+    std::filesystem::path FindIndexedRoot(
+        const std::filesystem::path &path,
+        int64_t &indexedAt);
+
+    void Replace(
+        const std::filesystem::path &root,
+        const std::vector<FileMetadata> &entries,
+        int64_t indexedAt);
+
+    // Answers the query for everything below path from the index alone,
+    // returns the number of index entries that were considered
+    size_t Query(
+        const std::filesystem::path &path,
+        const MetadataQuery &query,
+        int64_t now,
+        const std::function<void(const FileMetadata &)> &onMatch);
+
+private:
+    std::unique_ptr<sqlitelib::Sqlite> _db;
+    std::mutex _dbMutex;
+
+    void EnsureTables();
+};
+
+#endif // METADATAINDEX_H
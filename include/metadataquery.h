@@ -0,0 +1,102 @@
+#ifndef METADATAQUERY_H
+#define METADATAQUERY_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+enum class FileTypes
+{
+    File,
+    Directory,
+    Symlink,
+    Other,
+};
+
+enum MetadataFields
+{
+    MetadataFieldNone = 0,
+    MetadataFieldSize = 1 << 0,
+    MetadataFieldModified = 1 << 1,
+    MetadataFieldOwner = 1 << 2,
+    MetadataFieldAll = MetadataFieldSize | MetadataFieldModified | MetadataFieldOwner,
+};
+
+struct FileMetadata
+{
+    std::filesystem::path path;
+    FileTypes type = FileTypes::Other;
+    uint64_t size = 0;
+    int64_t modified = 0; // seconds since the unix epoch
+    std::string owner;
+};
+
+enum class CompareOperators
+{
+    Less,
+    LessOrEqual,
+    Equal,
+    GreaterOrEqual,
+    Greater,
+};
+
+struct NumericPredicate
+{
+    CompareOperators op;
+    int64_t value;
+
+    bool Matches(
+        int64_t actual) const;
+};
+
+// A query is a list of terms that must all match, for example
+//   *.log size>1G age<7d type:file owner:root mtime>=2023-01-31
+// A term without a key is a name glob, comma separated values are or'ed,
+// and so are several name terms.
+class MetadataQuery
+{
+public:
+    bool Parse(
+        const std::string &text);
+
+    const std::string &Error() const { return _error; }
+
+    // The metadata fields that need to be read to evaluate this query
+    int NeededFields() const;
+
+    bool Matches(
+        const FileMetadata &metadata,
+        int64_t now) const;
+
+    const std::vector<std::string> &NameGlobs() const { return _nameGlobs; }
+    const std::vector<FileTypes> &Types() const { return _types; }
+    const std::vector<std::string> &Owners() const { return _owners; }
+    const std::vector<NumericPredicate> &SizePredicates() const { return _size; }
+    const std::vector<NumericPredicate> &ModifiedPredicates() const { return _modified; }
+
+    // Age predicates are relative to the time of evaluation, this turns them
+    // into predicates on the modified time
+    std::vector<NumericPredicate> ModifiedPredicatesAt(
+        int64_t now) const;
+
+    static bool GlobMatches(
+        const std::string &glob,
+        const std::string &name);
+
+    static int64_t Now();
+
+private:
+    std::string _error;
+    std::vector<std::string> _nameGlobs;
+    std::vector<FileTypes> _types;
+    std::vector<std::string> _owners;
+    std::vector<NumericPredicate> _size;
+    std::vector<NumericPredicate> _modified;
+    std::vector<NumericPredicate> _age;
+
+    bool ParseTerm(
+        const std::string &term);
+};
+
+#endif // METADATAQUERY_H
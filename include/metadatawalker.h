@@ -0,0 +1,51 @@
+#ifndef METADATAWALKER_H
+#define METADATAWALKER_H
+
+#include "metadataquery.h"
+#include "workerpool.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+class MetadataWalker
+{
+public:
+    typedef std::function<void(const FileMetadata &)> EntryFunc;
+
+    MetadataWalker(
+        WorkerPool *workerPool,
+        const std::atomic<bool> &cancel);
+
+    // Walks the tree below root with one pool job per directory. onEntry is
+    // called from the worker threads for every entry. Only the fields in
+    // the mask are read besides the type.
+    void Walk(
+        const std::filesystem::path &root,
+        int fields,
+        const EntryFunc &onEntry);
+
+    static bool ReadMetadata(
+        const std::filesystem::directory_entry &entry,
+        int fields,
+        FileMetadata &metadata);
+
+private:
+    WorkerPool *_workerPool;
+    const std::atomic<bool> &_cancel;
+    std::mutex _pendingMutex;
+    std::condition_variable _pendingDone;
+    size_t _pending = 0;
+
+    void WalkDirectory(
+        const std::filesystem::path &directory,
+        int fields,
+        const EntryFunc &onEntry);
+
+    void Schedule(
+        const std::filesystem::path &directory,
+        int fields,
+        const EntryFunc &onEntry);
+};
+
+#endif // METADATAWALKER_H
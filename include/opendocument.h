@@ -28,6 +28,8 @@ private:
 class OpenDocument
 {
 public:
+    virtual ~OpenDocument() = default;
+
     void Render();
 
     void Open(
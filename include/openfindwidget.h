@@ -1,12 +1,40 @@
 #ifndef OPENFINDWIDGET_H
 #define OPENFINDWIDGET_H
 
+#include "ahocorasick.h"
+#include "bytepattern.h"
+#include "framescheduler.h"
+#include "metadataindex.h"
 #include "opendocument.h"
+#include "settingsservice.h"
+#include "workerpool.h"
+#include <atomic>
+#include <deque>
+#include <future>
 #include <imgui.h>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <sstream>
 #include <thread>
+#include <vector>
+
+struct FileSearchResult
+{
+    std::vector<std::string> lines;
+    std::vector<int> hitCounts;
+};
+
+enum class FindModes
+{
+    Text,
+    MultiplePatterns,
+    Bytes,
+    Metadata,
+};
+
+typedef std::function<void(const std::filesystem::path &, FileSearchResult &)> FileSearchFunc;
 
 class OpenFindWidget : public OpenDocument
 {
@@ -30,25 +58,98 @@ protected:
 
 private:
     char _buf[256] = {0};
+    char _patterns[4096] = {0};
+    FindModes _findMode = FindModes::Text;
     std::unique_ptr<std::thread> t1;
     std::mutex _linesToAddMutex;
     std::stringstream _content;
     bool _justChangedPath = false;
+    WorkerPool *_workerPool = nullptr;
+    FrameScheduler *_frameScheduler = nullptr;
+    MetadataIndex *_metadataIndex = nullptr;
+    ISettingsService *_settingsService = nullptr;
+    std::vector<SavedSearch> _savedSearches;
+    int _savedSearchId = -1;
+    std::atomic<bool> _cancelFind = false;
+
+    struct FindTotals
+    {
+        std::mutex mutex;
+        int fileCount = 0;
+        std::vector<int> hitCounts;
+    };
+
+    // Files are searched in batches and only a few batches are queued on the
+    // worker pool at a time, so the other users of the pool keep a thread
+    // and get their jobs in between
+    struct FindJobs
+    {
+        std::deque<std::future<void>> inFlight;
+        std::vector<std::filesystem::path> batch;
+        size_t maxInFlight = 1;
+    };
 
     void AddLine(
         const std::string &line);
 
+    void AddLines(
+        const std::vector<std::string> &lines);
+
     void FinishThread();
 
+    std::vector<std::string> CollectPatterns() const;
+
+    std::string PatternsText() const;
+
+    void RenderSavedSearches();
+
+    void SaveSearch();
+
+    void RunSavedSearch(
+        const SavedSearch &search);
+
+    int ActiveSavedSearchId() const;
+
     void StartFind(
-        const std::wstring &searchFor,
+        FindModes mode,
+        const std::vector<std::string> &searchFor,
+        const std::filesystem::path &path,
+        int savedSearchId);
+
+    void FinishSavedSearch(
+        int savedSearchId,
+        const std::map<std::filesystem::path, SavedSearchFile> &cachedFiles,
+        const std::map<std::filesystem::path, SavedSearchFile> &changedFiles,
+        const std::set<std::filesystem::path> &seenFiles,
+        size_t reusedCount);
+
+    void StartMetadataQuery(
+        const std::string &queryText,
+        const std::filesystem::path &path);
+
+    void BuildMetadataIndex(
         const std::filesystem::path &path);
 
     void RecursiveFind(
-        const std::wstring &searchFor,
         const std::filesystem::path &path,
-        int fileCount,
-        int hitCount);
+        const FileSearchFunc &searchFile,
+        FindJobs &jobs,
+        FindTotals &totals);
+
+    void SubmitFindBatch(
+        const FileSearchFunc &searchFile,
+        FindJobs &jobs,
+        FindTotals &totals);
+
+    void SearchFile(
+        const AhoCorasick &matcher,
+        const std::filesystem::path &path,
+        FileSearchResult &result);
+
+    void SearchFileBytes(
+        const BytePattern &pattern,
+        const std::filesystem::path &path,
+        FileSearchResult &result);
 };
 
 #endif // OPENFINDWIDGET_H
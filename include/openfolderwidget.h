@@ -1,11 +1,19 @@
 #ifndef OPENFOLDERWIDGET_H
 #define OPENFOLDERWIDGET_H
 
+#include "exifindex.h"
 #include "opendocument.h"
+#include "texturecache.h"
+#include "thumbnailcache.h"
 #include <filesystem>
 #include <functional>
 #include <set>
 #include <settingsservice.h>
+#include <vector>
+
+#define THUMBNAIL_GRID_CELL 128.0f
+#define THUMBNAIL_GRID_LOOKAHEAD_ROWS 2
+#define THUMBNAIL_GRID_UPLOADS_PER_FRAME 8
 
 struct folderItem
 {
@@ -41,6 +49,8 @@ public:
         int index,
         ServiceProvider *services);
 
+    virtual ~OpenFolderWidget();
+
     void MoveSelectionUp(
         int count = 1);
 
@@ -62,6 +72,10 @@ public:
 
     void ToggleShowInfo();
 
+    void ToggleShowGrid();
+
+    void ToggleSortByCaptureTime();
+
     void ToggleBookmark();
 
     void DeleteSelection();
@@ -78,8 +92,16 @@ protected:
     std::vector<std::filesystem::path> _pathInSections;
     bool _isBookmark = false;
     ISettingsService *_settingsService = nullptr;
+    ThumbnailCache *_thumbnailCache = nullptr;
+    ExifIndex *_exifIndex = nullptr;
+    ThumbnailAtlas *_thumbnailAtlas = nullptr;
+    std::vector<std::filesystem::path> _requestedThumbnails;
     bool _showFind = false;
     bool _showInfo = false;
+    bool _showGrid = false;
+    bool _sortByCaptureTime = false;
+    int _sortedGeneration = 0;
+    int _gridColumns = 1;
     bool _showDeletePopup = false;
     bool _showMoveToTrashPopup = false;
     bool _showManageOpenWithOptionsPopup = false;
@@ -99,6 +121,15 @@ protected:
 
     virtual void OnRender();
 
+    // Folders first and by name, files by name or by capture time
+    void SortItems();
+
+    void RenderList();
+
+    // Only the rows on screen are drawn, thumbnails are asked for those and
+    // a few rows around them
+    void RenderGrid();
+
     void RenderPathItemContextMenu(
         const std::filesystem::path &file);
 
@@ -1,9 +1,32 @@
 #ifndef OPENIMAGEWIDGET_H
 #define OPENIMAGEWIDGET_H
 
+#include "animationplayer.h"
+#include "decodedimagecache.h"
+#include "framescheduler.h"
+#include "histogramcache.h"
+#include "imagedirectoryindex.h"
 #include "opendocument.h"
+#include "texturecache.h"
+#include "tiledimage.h"
+#include <atomic>
 #include <filesystem>
 #include <imgui.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#define IMAGE_PREFETCH_AHEAD 3
+#define IMAGE_PREFETCH_BEHIND 1
+#define IMAGE_TILING_THRESHOLD 4096
+#define IMAGE_TILE_BUDGET (256ull * 1024 * 1024)
+#define IMAGE_MAX_PENDING_TILES 8
+#define IMAGE_TILE_UPLOADS_PER_FRAME 4
+#define IMAGE_HISTOGRAM_WIDTH 256.0f
+#define IMAGE_HISTOGRAM_HEIGHT 100.0f
 
 class OpenImageWidget : public OpenDocument
 {
@@ -12,10 +35,15 @@ public:
         int index,
         ServiceProvider *services);
 
+    virtual ~OpenImageWidget();
+
     void OpenPreviousImageInParentDirectory();
 
     void OpenNextImageInParentDirectory();
 
+    void OpenImageInParentDirectory(
+        int index);
+
     static bool IsImage(
         const std::filesystem::path &path);
 
@@ -26,12 +54,127 @@ protected:
         const std::filesystem::path &oldPath);
 
 private:
+    struct TileKey
+    {
+        int level;
+        int x;
+        int y;
+
+        bool operator<(
+            const TileKey &other) const
+        {
+            return std::tie(level, x, y) < std::tie(other.level, other.x, other.y);
+        }
+    };
+
+    struct TileTexture
+    {
+        unsigned int textureId = 0;
+        int lastUsedFrame = 0;
+    };
+
+    // Shared with the tile jobs on the worker pool, so they can outlive the widget
+    struct TileQueue
+    {
+        std::mutex mutex;
+        std::atomic<bool> isCancelled = false;
+        std::vector<std::pair<TileKey, std::shared_ptr<DecodedImage>>> readyTiles;
+    };
+
+    WorkerPool *_workerPool = nullptr;
+    FrameScheduler *_frameScheduler = nullptr;
+    TextureUploader *_textureUploader = nullptr;
+    TextureCache *_textureCache = nullptr;
+    DecodedImageCache *_decodedImageCache = nullptr;
+    HistogramCache *_histogramCache = nullptr;
+    ImageDirectoryIndex *_imageDirectoryIndex = nullptr;
+    ExifIndex *_exifIndex = nullptr;
+    std::shared_ptr<const ImageDirectoryListing> _listing;
+    bool _isInArchive = false;
+    ImageOrders _listingOrder = ImageOrders::Name;
+    int _listingGeneration = 0;
+    int _imageIndex = -1;
+    bool _isLoading = false;
+    bool _isLoadingFullResolution = false;
+    bool _isShowingThumbnail = false;
+    int _decodeDimension = 0;
+    ImVec2 _viewportSize;
+    int _browsingDirection = 1;
     unsigned int _textureId = 0;
-    ImVec2 _textureSize;
-    std::filesystem::path _prevImage, _nextImage;
+    CachedTexture _pendingTexture;
+    bool _pendingResetView = false;
+    bool _textureIsReduced = false;
+    ImVec2 _textureResolution;
+    ImVec2 _imageSize;
+    std::shared_ptr<TiledImage> _tiledImage;
+    std::map<TileKey, TileTexture> _tiles;
+    std::set<TileKey> _pendingTiles;
+    std::shared_ptr<TileQueue> _tileQueue;
+    std::unique_ptr<AnimationPlayer> _animationPlayer;
+    bool _isInspecting = false;
+    DecodeRequest _inspectedRequest;
+    std::shared_ptr<DecodedImage> _inspectedImage;
+    int _frame = 0;
     float _zoom = 1.0f;
     float _rotate = 0.0f;
     ImVec2 _pan;
+
+    std::vector<std::filesystem::path> PrefetchPaths() const;
+
+    void RequestImages();
+
+    void UpdateTextures();
+
+    int DecodeDimension() const;
+
+    const CachedTexture *FindTexture(
+        const std::filesystem::path &path,
+        int maxDimension);
+
+    void ShowTexture(
+        const CachedTexture &texture,
+        bool resetView);
+
+    // Shows the texture when its upload is done, until then the current one stays
+    void ShowWhenUploaded(
+        const CachedTexture &texture,
+        bool resetView);
+
+    // Keeps the texture on screen and the one waiting for its upload in the cache
+    void HoldTextures();
+
+    bool NeedsTiling(
+        const DecodedImage &image) const;
+
+    void ClearTiles();
+
+    void RenderTiles(
+        const ImVec2 &center,
+        const ImVec2 &size,
+        const ImVec2 &clipMin,
+        const ImVec2 &clipMax);
+
+    void UploadReadyTiles();
+
+    void EvictTiles();
+
+    void UpdateListing();
+
+    // The pixels of what is on screen, the full resolution ones when tiled.
+    // Stays empty when the decoded image already left the cache.
+    void UpdateInspectedImage();
+
+    void RenderHistogram(
+        const ImVec2 &pos);
+
+    void RenderPixelReadout(
+        const ImVec2 &center,
+        const ImVec2 &size,
+        const ImVec2 &pos);
+
+    // Returns an empty path when there is no image at that offset from the current one
+    std::filesystem::path ImageAtOffset(
+        int offset) const;
 };
 
 #endif // OPENIMAGEWIDGET_H
@@ -1,10 +1,26 @@
 #ifndef OPENTEXTWIDGET_H
 #define OPENTEXTWIDGET_H
 
+#include "framescheduler.h"
+#include "lineindex.h"
+#include "mappedfile.h"
 #include "opendocument.h"
+#include "piecetable.h"
+#include "workerpool.h"
+#include <atomic>
 #include <filesystem>
 #include <imgui.h>
+#include <memory>
+#include <mutex>
+#include <string>
 
+#define TEXT_MAX_DRAWN_LINE_LENGTH 4096
+
+// Files are mapped instead of read, whatever their size, and only the lines
+// that are visible are drawn. Opening and indexing happen on the worker pool,
+// so a slow disk never blocks the frame, and the lines show up as they are
+// indexed. Edits go into a piece table on top of the mapping, which needs the
+// line index, so the file is read only until its lines are indexed.
 class OpenTextWidget : public OpenDocument
 {
 public:
@@ -13,19 +29,100 @@ public:
         ServiceProvider *services,
         ImFont *monoSpaceFont);
 
+    virtual ~OpenTextWidget();
+
     void SaveFile();
 
     void SaveFileAs();
 
 private:
+    // Shared with the job that opens the file, so it can outlive the widget
+    struct OpenJob
+    {
+        std::filesystem::path path;
+        std::atomic<bool> isCancelled = false;
+
+        std::mutex mutex;
+        bool isDone = false;
+        std::shared_ptr<MappedFile> file;
+    };
+
     ImFont *_monoSpaceFont;
-    ImVector<char> _content;
-    bool _isDirty = false;
+    WorkerPool *_workerPool = nullptr;
+    FrameScheduler *_frameScheduler = nullptr;
+    std::shared_ptr<OpenJob> _openJob;
+    std::shared_ptr<MappedFile> _file;
+    std::unique_ptr<LineIndex> _lineIndex;
+    PieceTable _text;
+    std::string _lineBreak = "\n";
+    std::string _error;
+    int _goToLine = 0;
+    int _scrollToLine = -1;
+    size_t _cursor = 0;
+    // The other end of the selection, the same as the cursor when there is none
+    size_t _anchor = 0;
+    bool _isMouseSelecting = false;
+    // Where up and down try to keep the cursor
+    float _cursorX = 0.0f;
+    bool _scrollToCursor = false;
 
     virtual void OnRender();
 
     virtual void OnPathChanged(
         const std::filesystem::path &oldPath);
+
+    void OpenFile();
+
+    void CloseFile();
+
+    // Starts indexing once the file is open
+    void UpdateOpenJob();
+
+    static void OpenInBackground(
+        std::shared_ptr<OpenJob> openJob,
+        FrameScheduler *frameScheduler);
+
+    void RenderProgress();
+
+    void RenderText();
+
+    void RenderSelection(
+        size_t line,
+        const std::string &text,
+        const ImVec2 &textPos,
+        size_t selectionBegin,
+        size_t selectionEnd);
+
+    void HandleKeyboard(
+        size_t pageLines);
+
+    // Returns false when nothing is selected
+    bool EraseSelection();
+
+    void UpdateCursorX();
+
+    void MoveCursorToLine(
+        size_t line);
+
+    std::string LineText(
+        size_t line) const;
+
+    size_t PreviousCharacter(
+        size_t offset) const;
+
+    size_t NextCharacter(
+        size_t offset) const;
+
+    size_t PreviousWord(
+        size_t offset) const;
+
+    size_t NextWord(
+        size_t offset) const;
+
+    // The byte in the line that is closest to x
+    static size_t ColumnAt(
+        const std::string &text,
+        float x);
 };
 
 #endif // OPENTEXTWIDGET_H
@@ -0,0 +1,189 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include "lineindex.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// An editable text on top of an original that is never copied or changed,
+// like a mapped file. Inserted text goes into an append buffer, the text is
+// the sequence of pieces of both. The pieces are kept in a treap ordered by
+// position, where every node knows the length and line breaks of its
+// subtree, so edits and line lookups take O(log n) in the number of pieces.
+// Undo steps only remember pieces, whatever the size of the edit.
+class PieceTable
+{
+public:
+    PieceTable();
+
+    // The original and its line index, which must be complete, have to stay
+    // as they are while the table is open
+    void Open(
+        const char *original,
+        size_t size,
+        const LineIndex *originalLines);
+
+    void Close();
+
+    bool IsOpen() const { return _originalLines != nullptr; }
+
+    size_t Length() const;
+
+    size_t LineCount() const;
+
+    size_t LineStart(
+        size_t line) const;
+
+    // The end of the line without its line break
+    size_t LineEnd(
+        size_t line) const;
+
+    size_t LineOf(
+        size_t offset) const;
+
+    std::string Text(
+        size_t offset,
+        size_t length) const;
+
+    void Insert(
+        size_t offset,
+        const std::string &text);
+
+    void Erase(
+        size_t offset,
+        size_t length);
+
+    // Edits that follow each other, like typing a word, are undone as one
+    // step until this is called
+    void EndUndoStep();
+
+    bool CanUndo() const { return _undoPosition > 0; }
+
+    bool CanRedo() const { return _undoPosition < _undoSteps.size(); }
+
+    // Both return the offset where the text changed
+    size_t Undo();
+
+    size_t Redo();
+
+    bool IsModified() const { return _undoPosition != _savedPosition; }
+
+    void MarkSaved();
+
+    void Write(
+        std::ostream &stream) const;
+
+private:
+    enum class Sources
+    {
+        Original,
+        Added,
+    };
+
+    struct Piece
+    {
+        Sources source = Sources::Original;
+        size_t start = 0;
+        size_t length = 0;
+    };
+
+    struct Node
+    {
+        Piece piece;
+        size_t lineBreaks = 0;
+        uint32_t priority = 0;
+        int left = -1;
+        int right = -1;
+        size_t subtreeLength = 0;
+        size_t subtreeLineBreaks = 0;
+    };
+
+    // Replaces the pieces removed at offset by the pieces inserted
+    struct UndoStep
+    {
+        size_t offset = 0;
+        std::vector<Piece> removed;
+        std::vector<Piece> inserted;
+        bool isOpen = true;
+    };
+
+    const char *_original = nullptr;
+    size_t _originalSize = 0;
+    const LineIndex *_originalLines = nullptr;
+    std::string _added;
+    std::vector<size_t> _addedLineBreaks;
+    std::vector<Node> _nodes;
+    std::vector<int> _freeNodes;
+    int _root = -1;
+    std::mt19937 _random;
+    std::vector<UndoStep> _undoSteps;
+    size_t _undoPosition = 0;
+    size_t _savedPosition = 0;
+
+    const char *Data(
+        Sources source) const { return source == Sources::Original ? _original : _added.data(); }
+
+    size_t CountLineBreaks(
+        Sources source,
+        size_t begin,
+        size_t end) const;
+
+    // The offset in the source of the index-th line break at or after begin
+    size_t FindLineBreak(
+        Sources source,
+        size_t begin,
+        size_t index) const;
+
+    int NewNode(
+        const Piece &piece);
+
+    void FreeTree(
+        int node);
+
+    void UpdateNode(
+        int node);
+
+    // Cuts a piece in two when offset falls inside it
+    void Split(
+        int node,
+        size_t offset,
+        int &left,
+        int &right);
+
+    int Merge(
+        int left,
+        int right);
+
+    void CollectPieces(
+        int node,
+        std::vector<Piece> &pieces) const;
+
+    void CollectText(
+        int node,
+        size_t offset,
+        size_t length,
+        std::string &text) const;
+
+    void InsertPieces(
+        size_t offset,
+        const std::vector<Piece> &pieces);
+
+    std::vector<Piece> RemovePieces(
+        size_t offset,
+        size_t length);
+
+    static size_t TotalLength(
+        const std::vector<Piece> &pieces);
+
+    // Starts a new undo step unless the edit continues the open one
+    UndoStep &StepFor(
+        size_t offset,
+        size_t length,
+        bool isInsert);
+};
+
+#endif // PIECETABLE_H
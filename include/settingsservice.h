@@ -3,9 +3,12 @@
 
 #include <filesystem>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <sqlitelib.h>
 #include <string>
+#include <vector>
 
 #include <codecvt>
 #include <locale>
@@ -20,6 +23,25 @@ public:
     bool isCommandLineApp;
 };
 
+class SavedSearch
+{
+public:
+    int id;
+    std::wstring name;
+    std::filesystem::path root;
+    int mode;
+    std::wstring patterns;
+};
+
+class SavedSearchFile
+{
+public:
+    double modified;
+    double size;
+    std::vector<int> hitCounts;
+    std::vector<std::string> lines;
+};
+
 class ISettingsService
 {
 public:
@@ -57,6 +79,25 @@ public:
 
     virtual void DeleteOpenWithOption(
         int id) = 0;
+
+    virtual std::vector<SavedSearch> GetSavedSearches() = 0;
+
+    virtual int AddSavedSearch(
+        const std::wstring &name,
+        const std::filesystem::path &root,
+        int mode,
+        const std::wstring &patterns) = 0;
+
+    virtual void DeleteSavedSearch(
+        int id) = 0;
+
+    virtual std::map<std::filesystem::path, SavedSearchFile> GetSavedSearchFiles(
+        int searchId) = 0;
+
+    virtual void UpdateSavedSearchFiles(
+        int searchId,
+        const std::map<std::filesystem::path, SavedSearchFile> &changedFiles,
+        const std::vector<std::filesystem::path> &removedFiles) = 0;
 };
 
 class SettingsService :
@@ -98,8 +139,30 @@ public:
     virtual void DeleteOpenWithOption(
         int id);
 
+    virtual std::vector<SavedSearch> GetSavedSearches();
+
+    virtual int AddSavedSearch(
+        const std::wstring &name,
+        const std::filesystem::path &root,
+        int mode,
+        const std::wstring &patterns);
+
+    virtual void DeleteSavedSearch(
+        int id);
+
+    virtual std::map<std::filesystem::path, SavedSearchFile> GetSavedSearchFiles(
+        int searchId);
+
+    virtual void UpdateSavedSearchFiles(
+        int searchId,
+        const std::map<std::filesystem::path, SavedSearchFile> &changedFiles,
+        const std::vector<std::filesystem::path> &removedFiles);
+
 private:
     std::unique_ptr<sqlitelib::Sqlite> _db;
+    // Only for the saved search files, which the find thread uses
+    std::unique_ptr<sqlitelib::Sqlite> _searchDb;
+    std::mutex _searchDbMutex;
     std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> _wstringConverter;
 
     void EnsureTables();
@@ -0,0 +1,111 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include "decodedimagecache.h"
+#include "textureuploader.h"
+#include "thumbnailatlas.h"
+#include <filesystem>
+#include <imgui.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#define TEXTURE_CACHE_BUDGET (512ull * 1024 * 1024)
+
+struct CachedTexture
+{
+    std::filesystem::path path;
+    int maxDimension = 0;
+    unsigned int textureId = 0;
+    ImVec2 size;
+    ImVec2 imageSize;
+    int orientation = 1;
+    size_t byteSize = 0;
+};
+
+// Textures shared by all widgets, keyed by the decode request and the
+// modification time of the file so an edited image is not shown stale.
+// Widgets hold the textures they show, held textures are never evicted.
+// The others stay until the budget runs out, least recently used go first.
+// The thumbnail atlas lives here too, so its pages count against the same
+// budget. Only to be used on the GL thread.
+class TextureCache
+{
+public:
+    TextureCache(
+        TextureUploader *textureUploader,
+        size_t budget = TEXTURE_CACHE_BUDGET);
+
+    virtual ~TextureCache();
+
+    const CachedTexture *Find(
+        const DecodeRequest &request);
+
+    // Uploads with a full mipmap chain, the texture is usable once
+    // IsComplete says so
+    const CachedTexture &Upload(
+        const DecodeRequest &request,
+        const std::shared_ptr<DecodedImage> &image);
+
+    bool IsComplete(
+        const CachedTexture &texture) const;
+
+    bool IsUploading() const;
+
+    // Replaces what the owner held before, zero ids are ignored
+    void Hold(
+        int owner,
+        const std::vector<unsigned int> &textureIds);
+
+    void Release(
+        int owner);
+
+    ThumbnailAtlas *Thumbnails() { return &_thumbnails; }
+
+    // Once per frame, after the widgets render
+    void EndFrame();
+
+    // Deletes all textures, while the GL context still exists
+    void ReleaseAll();
+
+    size_t Budget() const { return _budget; }
+
+    size_t UsedBytes() const;
+
+private:
+    struct TextureKey
+    {
+        DecodeRequest request;
+        std::filesystem::file_time_type modified;
+
+        bool operator<(
+            const TextureKey &other) const
+        {
+            return request < other.request || (!(other.request < request) && modified < other.modified);
+        }
+    };
+
+    struct Entry
+    {
+        CachedTexture texture;
+        std::set<int> heldBy;
+        std::list<TextureKey>::iterator lruPosition;
+    };
+
+    TextureUploader *_textureUploader;
+    size_t _budget;
+    size_t _usedBytes = 0;
+    std::map<TextureKey, Entry> _entries;
+    std::map<unsigned int, TextureKey> _keysById;
+    std::list<TextureKey> _lru;
+    ThumbnailAtlas _thumbnails;
+
+    static TextureKey KeyFor(
+        const DecodeRequest &request);
+
+    void Evict();
+};
+
+#endif // TEXTURECACHE_H
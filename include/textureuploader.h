@@ -0,0 +1,100 @@
+#ifndef TEXTUREUPLOADER_H
+#define TEXTUREUPLOADER_H
+
+#include "framescheduler.h"
+#include "imagedecoder.h"
+#include "workerpool.h"
+#include <atomic>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+
+#define TEXTURE_UPLOAD_RING_SIZE (64ull * 1024 * 1024)
+#define TEXTURE_UPLOAD_SLICE_SIZE (4ull * 1024 * 1024)
+#define TEXTURE_UPLOAD_FRAME_BUDGET (16ull * 1024 * 1024)
+#define TEXTURE_UPLOAD_DIRECT_SIZE (1ull * 1024 * 1024)
+
+// Streams decoded images into textures through a persistently mapped pixel
+// buffer. The worker pool copies rows into the mapped ring, the GL thread
+// starts the transfer from there the next frame and the texture can be used
+// when its transfer is done. Large images are spread over several frames so
+// uploading never stalls rendering. Only to be used on the GL thread.
+class TextureUploader
+{
+public:
+    TextureUploader(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler);
+
+    virtual ~TextureUploader();
+
+    // Creates an RGBA texture for the image and queues its pixels, small
+    // images are uploaded right away
+    unsigned int Begin(
+        std::shared_ptr<DecodedImage> image,
+        bool hasMipmaps);
+
+    bool IsComplete(
+        unsigned int textureId) const;
+
+    // Use this instead of glDeleteTextures, so a running upload does not
+    // write into a texture name that is reused later
+    void DeleteTexture(
+        unsigned int textureId);
+
+    // Once per frame, before the widgets render
+    void Update();
+
+    // Frees the pixel buffer, while the GL context still exists
+    void Release();
+
+private:
+    struct Upload
+    {
+        unsigned int textureId = 0;
+        std::shared_ptr<DecodedImage> image;
+        bool hasMipmaps = false;
+        int nextRow = 0;
+        int slicesInFlight = 0;
+        bool isCancelled = false;
+    };
+
+    struct Slice
+    {
+        std::shared_ptr<Upload> upload;
+        size_t offset = 0;
+        int firstRow = 0;
+        int rowCount = 0;
+        std::atomic<bool> isCopied = false;
+        std::future<void> copy;
+        bool isSubmitted = false;
+        void *fence = nullptr;
+    };
+
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    bool _isInitialized = false;
+    bool _isStreaming = false;
+    unsigned int _buffer = 0;
+    unsigned char *_mapped = nullptr;
+    size_t _ringHead = 0;
+    std::map<unsigned int, std::shared_ptr<Upload>> _uploads;
+    std::deque<std::shared_ptr<Upload>> _queued;
+    std::deque<std::shared_ptr<Slice>> _slices;
+
+    void Initialize();
+
+    bool Allocate(
+        size_t size,
+        size_t &offset);
+
+    void Retire();
+
+    void Submit();
+
+    // Returns false when the frame budget ran out before everything was started
+    bool StartCopies();
+};
+
+#endif // TEXTUREUPLOADER_H
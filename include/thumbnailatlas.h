@@ -0,0 +1,78 @@
+#ifndef THUMBNAILATLAS_H
+#define THUMBNAILATLAS_H
+
+#include "imagedecoder.h"
+#include "thumbnailcache.h"
+#include <filesystem>
+#include <imgui.h>
+#include <map>
+#include <vector>
+
+#define THUMBNAIL_ATLAS_SIZE 2048
+#define THUMBNAIL_ATLAS_PAGES 4
+
+// Thumbnails packed into a few large textures instead of a texture each.
+// Every thumbnail gets a square slot of THUMBNAIL_SIZE, slots that were not
+// drawn for the longest time are reused first so VRAM stays bounded.
+class ThumbnailAtlas
+{
+public:
+    struct Placement
+    {
+        unsigned int textureId = 0;
+        ImVec2 uvMin;
+        ImVec2 uvMax;
+        ImVec2 size;
+        int orientation = 1;
+    };
+
+    ThumbnailAtlas() = default;
+
+    ThumbnailAtlas(const ThumbnailAtlas &) = delete;
+    ThumbnailAtlas &operator=(const ThumbnailAtlas &) = delete;
+
+    virtual ~ThumbnailAtlas();
+
+    // Marks the slot as used this frame
+    bool Find(
+        const std::filesystem::path &path,
+        Placement &placement);
+
+    // Fails when every slot is in use this frame
+    bool Add(
+        const std::filesystem::path &path,
+        const DecodedImage &thumbnail);
+
+    // Updates the mipmaps of pages that changed, once per frame after drawing
+    void EndFrame();
+
+    // Deletes the pages, while the GL context still exists
+    void Release();
+
+    size_t ByteSize() const;
+
+private:
+    struct Slot
+    {
+        std::filesystem::path path;
+        int lastUsedFrame = -1;
+        int width = 0;
+        int height = 0;
+        int orientation = 1;
+    };
+
+    std::vector<unsigned int> _pages;
+    std::vector<Slot> _slots;
+    std::map<std::filesystem::path, int> _slotsByPath;
+    std::vector<bool> _isPageChanged;
+    int _frame = 0;
+
+    static constexpr int SlotsPerRow = THUMBNAIL_ATLAS_SIZE / THUMBNAIL_SIZE;
+    static constexpr int SlotsPerPage = SlotsPerRow * SlotsPerRow;
+
+    int FreeSlot();
+
+    void AddPage();
+};
+
+#endif // THUMBNAILATLAS_H
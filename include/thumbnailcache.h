@@ -0,0 +1,105 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include "decodedimagecache.h"
+#include "framescheduler.h"
+#include "imagedecoder.h"
+#include "workerpool.h"
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sqlitelib.h>
+#include <vector>
+
+#define THUMBNAIL_SIZE 256
+#define THUMBNAIL_MIN_EMBEDDED_SIZE 160
+#define THUMBNAIL_MEMORY_BUDGET (128ull * 1024 * 1024)
+#define THUMBNAIL_WRITE_BATCH 64
+
+// Small previews of images for grids and lists. Thumbnails are made on the
+// worker pool and stored in a database under the user profile, keyed by
+// path and checked against the size and modification time of the file, so
+// a folder that was seen before shows its thumbnails without decoding.
+// Recently used thumbnails are also kept in memory.
+class ThumbnailCache
+{
+public:
+    ThumbnailCache(
+        WorkerPool *workerPool,
+        FrameScheduler *frameScheduler,
+        size_t budget = THUMBNAIL_MEMORY_BUDGET);
+
+    virtual ~ThumbnailCache();
+
+    bool Open(
+        const std::filesystem::path &databaseFile);
+
+    // In order of importance, thumbnails nobody wants any more are not made
+    void Request(
+        int owner,
+        const std::vector<std::filesystem::path> &paths);
+
+    void Release(
+        int owner);
+
+    DecodeStates Lookup(
+        const std::filesystem::path &path,
+        std::shared_ptr<DecodedImage> &thumbnail);
+
+private:
+    struct Entry
+    {
+        DecodeStates state = DecodeStates::Queued;
+        std::shared_ptr<DecodedImage> thumbnail;
+        std::set<int> wantedBy;
+        std::list<std::filesystem::path>::iterator lruPosition;
+    };
+
+    struct StoredThumbnail
+    {
+        std::filesystem::path path;
+        double size = 0;
+        double modified = 0;
+        std::shared_ptr<DecodedImage> thumbnail;
+    };
+
+    WorkerPool *_workerPool;
+    FrameScheduler *_frameScheduler;
+    size_t _budget;
+    size_t _usedBytes = 0;
+    std::mutex _mutex;
+    std::map<std::filesystem::path, Entry> _entries;
+    std::list<std::filesystem::path> _lru;
+    std::vector<StoredThumbnail> _pendingWrites;
+    std::condition_variable _jobsDone;
+    int _jobsInFlight = 0;
+    bool _isStopping = false;
+
+    std::unique_ptr<sqlitelib::Sqlite> _db;
+    std::mutex _dbMutex;
+
+    void EnsureTables();
+
+    void Make(
+        const std::filesystem::path &path);
+
+    std::shared_ptr<DecodedImage> Load(
+        const std::filesystem::path &path,
+        double size,
+        double modified);
+
+    void Store(
+        const std::vector<StoredThumbnail> &thumbnails);
+
+    static std::shared_ptr<DecodedImage> Generate(
+        const std::filesystem::path &path);
+
+    void Evict();
+};
+
+#endif // THUMBNAILCACHE_H
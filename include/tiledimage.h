@@ -0,0 +1,55 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include "imagedecoder.h"
+#include <memory>
+
+// Cuts a decoded image into square tiles on a pyramid of levels. Level 0 has
+// the full resolution, every next level halves it. Tiles are made on request,
+// so only the parts of the image that are looked at cost time and memory.
+class TiledImage
+{
+public:
+    static constexpr int TileSize = 512;
+
+    TiledImage(
+        std::shared_ptr<DecodedImage> image);
+
+    int Width() const { return _image->Width(); }
+
+    int Height() const { return _image->Height(); }
+
+    int LevelCount() const { return _levelCount; }
+
+    int TilesX(
+        int level) const;
+
+    int TilesY(
+        int level) const;
+
+    // The level whose resolution is closest to, but not below, scale screen
+    // pixels per image pixel
+    int LevelForScale(
+        float scale) const;
+
+    // The part of the full resolution image a tile covers, in pixels
+    void TileBounds(
+        int level,
+        int x,
+        int y,
+        int &left,
+        int &top,
+        int &right,
+        int &bottom) const;
+
+    std::shared_ptr<DecodedImage> RenderTile(
+        int level,
+        int x,
+        int y) const;
+
+private:
+    std::shared_ptr<DecodedImage> _image;
+    int _levelCount = 1;
+};
+
+#endif // TILEDIMAGE_H
@@ -0,0 +1,35 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+    WorkerPool(
+        size_t threadCount = 0);
+
+    virtual ~WorkerPool();
+
+    std::future<void> Enqueue(
+        std::function<void()> job);
+
+    size_t ThreadCount() const { return _threads.size(); }
+
+private:
+    std::vector<std::thread> _threads;
+    std::deque<std::packaged_task<void()>> _jobs;
+    std::mutex _jobsMutex;
+    std::condition_variable _jobsAvailable;
+    bool _isStopping = false;
+
+    void Work();
+};
+
+#endif // WORKERPOOL_H
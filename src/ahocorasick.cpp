@@ -0,0 +1,131 @@
+#include "ahocorasick.h"
+
+#include <queue>
+
+int AhoCorasick::AddPattern(
+    const std::string &pattern)
+{
+    _patterns.push_back(pattern);
+    _isBuilt = false;
+
+    return static_cast<int>(_patterns.size() - 1);
+}
+
+int AhoCorasick::AddState()
+{
+    _transitions.resize(_transitions.size() + 256, -1);
+    _outputs.emplace_back();
+
+    return static_cast<int>(_outputs.size() - 1);
+}
+
+void AhoCorasick::Build()
+{
+    _transitions.clear();
+    _outputs.clear();
+
+    AddState();
+
+    // Build the trie of all patterns
+    for (size_t i = 0; i < _patterns.size(); i++)
+    {
+        if (_patterns[i].empty())
+        {
+            continue;
+        }
+
+        int state = InitialState;
+        for (auto c : _patterns[i])
+        {
+            auto &next = _transitions[state * 256 + static_cast<unsigned char>(c)];
+            if (next < 0)
+            {
+                auto added = AddState();
+                _transitions[state * 256 + static_cast<unsigned char>(c)] = added;
+                state = added;
+            }
+            else
+            {
+                state = next;
+            }
+        }
+
+        _outputs[state].push_back(static_cast<int>(i));
+    }
+
+    // Turn the trie into a full automaton, breadth first so the failure state
+    // of every state is complete before its children are visited
+    std::vector<int> fail(_outputs.size(), InitialState);
+    std::queue<int> queue;
+
+    for (int c = 0; c < 256; c++)
+    {
+        auto &next = _transitions[c];
+        if (next < 0)
+        {
+            next = InitialState;
+        }
+        else
+        {
+            queue.push(next);
+        }
+    }
+
+    while (!queue.empty())
+    {
+        auto state = queue.front();
+        queue.pop();
+
+        auto &failOutputs = _outputs[fail[state]];
+        _outputs[state].insert(_outputs[state].end(), failOutputs.begin(), failOutputs.end());
+
+        for (int c = 0; c < 256; c++)
+        {
+            auto &next = _transitions[state * 256 + c];
+            auto fallback = _transitions[fail[state] * 256 + c];
+
+            if (next < 0)
+            {
+                next = fallback;
+            }
+            else
+            {
+                fail[next] = fallback;
+                queue.push(next);
+            }
+        }
+    }
+
+    _isBuilt = true;
+}
+
+int AhoCorasick::Scan(
+    int state,
+    const char *data,
+    size_t size,
+    const MatchFunc &onMatch) const
+{
+    auto transitions = _transitions.data();
+
+    for (size_t i = 0; i < size; i++)
+    {
+        state = transitions[state * 256 + static_cast<unsigned char>(data[i])];
+
+        if (!_outputs[state].empty())
+        {
+            for (auto patternIndex : _outputs[state])
+            {
+                onMatch(patternIndex, i + 1);
+            }
+        }
+    }
+
+    return state;
+}
+
+void AhoCorasick::FindAll(
+    const std::string &text,
+    const MatchFunc &onMatch) const
+{
+    Scan(InitialState, text.data(), text.size(), onMatch);
+}
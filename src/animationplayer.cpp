@@ -0,0 +1,323 @@
+#include "animationplayer.h"
+
+#include <algorithm>
+#include <glad/glad.h>
+
+AnimationPlayer::AnimationPlayer(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler)
+{}
+
+AnimationPlayer::~AnimationPlayer()
+{
+    Close();
+}
+
+void AnimationPlayer::Open(
+    const std::filesystem::path &path)
+{
+    Close();
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+    _decodeQueue = std::make_shared<DecodeQueue>();
+    _decodeQueue->path = path;
+    _decodeQueue->maxTextureSize = maxTextureSize;
+    _decodeQueue->isDecoding = true;
+
+    _workerPool->Enqueue([decodeQueue = _decodeQueue, frameScheduler = _frameScheduler]() {
+        DecodeFrames(decodeQueue, frameScheduler);
+    });
+}
+
+void AnimationPlayer::Close()
+{
+    if (_decodeQueue != nullptr)
+    {
+        _decodeQueue->isCancelled = true;
+        _decodeQueue = nullptr;
+    }
+
+    if (_textureId != 0)
+    {
+        glDeleteTextures(1, &_textureId);
+        _textureId = 0;
+    }
+
+    _slotCount = 0;
+    _slotDelays.clear();
+    _uploadedCount = 0;
+    _frameCount = 0;
+    _isFullyCached = false;
+    _playQueue.clear();
+}
+
+bool AnimationPlayer::IsPlaying() const
+{
+    return _textureId != 0 && !_playQueue.empty() && (_frameCount > 1 || _uploadedCount > 1);
+}
+
+ImVec2 AnimationPlayer::Size() const
+{
+    return ImVec2(static_cast<float>(_frameWidth), static_cast<float>(_frameHeight));
+}
+
+// Half a texel is left out on each side, linear filtering would otherwise
+// blend in the edges of the neighbouring frames
+void AnimationPlayer::CurrentFrame(
+    ImVec2 &uvMin,
+    ImVec2 &uvMax) const
+{
+    auto slot = _playQueue.front().slot;
+    auto rows = (_slotCount + _columns - 1) / _columns;
+    auto atlasWidth = static_cast<float>(_columns * _frameWidth);
+    auto atlasHeight = static_cast<float>(rows * _frameHeight);
+    auto left = static_cast<float>((slot % _columns) * _frameWidth);
+    auto top = static_cast<float>((slot / _columns) * _frameHeight);
+
+    uvMin = ImVec2((left + 0.5f) / atlasWidth, (top + 0.5f) / atlasHeight);
+    uvMax = ImVec2((left + _frameWidth - 0.5f) / atlasWidth, (top + _frameHeight - 0.5f) / atlasHeight);
+}
+
+void AnimationPlayer::Update()
+{
+    if (_decodeQueue == nullptr)
+    {
+        return;
+    }
+
+    std::vector<DecodedFrame> readyFrames;
+    bool startDecoding = false;
+
+    {
+        std::lock_guard<std::mutex> lock(_decodeQueue->mutex);
+
+        _frameCount = _decodeQueue->frameCount;
+
+        if (_textureId == 0 && _decodeQueue->slotCount >= 2 && !_decodeQueue->frames.empty())
+        {
+            CreateAtlas(_decodeQueue->width, _decodeQueue->height, _decodeQueue->slotCount);
+        }
+
+        // A slot is free once the frame in it has been shown
+        auto freeSlots = static_cast<int>(_slotCount - _playQueue.size());
+        while (_textureId != 0 && !_isFullyCached && freeSlots > 0 && !_decodeQueue->frames.empty())
+        {
+            readyFrames.push_back(_decodeQueue->frames.front());
+            _decodeQueue->frames.pop_front();
+            freeSlots--;
+        }
+
+        if (!_decodeQueue->isDecoding && !_decodeQueue->isFinished && _decodeQueue->frames.size() < ANIMATION_DECODE_AHEAD)
+        {
+            _decodeQueue->isDecoding = true;
+            startDecoding = true;
+        }
+    }
+
+    if (startDecoding)
+    {
+        _workerPool->Enqueue([decodeQueue = _decodeQueue, frameScheduler = _frameScheduler]() {
+            DecodeFrames(decodeQueue, frameScheduler);
+        });
+    }
+
+    for (const auto &frame : readyFrames)
+    {
+        Upload(frame);
+    }
+
+    // The first time through frame i went into slot i, when all of them fit
+    // the animation plays from the atlas from now on
+    if (!_isFullyCached && _frameCount > 1 && _frameCount <= _slotCount && _uploadedCount >= _frameCount)
+    {
+        auto current = _playQueue.front().slot;
+
+        _playQueue.clear();
+        for (int i = 0; i < _frameCount; i++)
+        {
+            auto slot = (current + i) % _frameCount;
+            _playQueue.push_back({slot, _slotDelays[slot]});
+        }
+
+        _isFullyCached = true;
+    }
+
+    Advance();
+}
+
+void AnimationPlayer::Advance()
+{
+    if (_playQueue.empty())
+    {
+        return;
+    }
+
+    auto now = Clock::now();
+    auto due = _frameShownAt + std::chrono::milliseconds(_playQueue.front().delay);
+
+    if (now < due)
+    {
+        _frameScheduler->RequestFrameIn(std::chrono::ceil<std::chrono::milliseconds>(due - now));
+
+        return;
+    }
+
+    // The decode job asks for a frame when the next one is ready
+    if (_playQueue.size() < 2)
+    {
+        return;
+    }
+
+    auto shown = _playQueue.front();
+    _playQueue.pop_front();
+
+    if (_isFullyCached)
+    {
+        _playQueue.push_back(shown);
+    }
+
+    // Keeps the pace when a frame was a little late, after a long stall the
+    // animation continues from now instead of racing to catch up
+    _frameShownAt = now - due > std::chrono::milliseconds(ANIMATION_DEFAULT_DELAY) ? now : due;
+
+    _frameScheduler->RequestFrameIn(std::chrono::milliseconds(_playQueue.front().delay));
+}
+
+void AnimationPlayer::CreateAtlas(
+    int width,
+    int height,
+    int slotCount)
+{
+    _frameWidth = width;
+    _frameHeight = height;
+    _slotCount = slotCount;
+    _slotDelays.assign(slotCount, ANIMATION_DEFAULT_DELAY);
+    _columns = std::min(slotCount, _decodeQueue->maxTextureSize / width);
+
+    auto rows = (slotCount + _columns - 1) / _columns;
+
+    glGenTextures(1, &_textureId);
+    glBindTexture(GL_TEXTURE_2D, _textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, _columns * width, rows * height);
+}
+
+void AnimationPlayer::Upload(
+    const DecodedFrame &frame)
+{
+    auto slot = _uploadedCount % _slotCount;
+
+    glBindTexture(GL_TEXTURE_2D, _textureId);
+    glTexSubImage2D(
+        GL_TEXTURE_2D,
+        0,
+        (slot % _columns) * _frameWidth,
+        (slot / _columns) * _frameHeight,
+        frame.image->Width(),
+        frame.image->Height(),
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        frame.image->Pixels());
+
+    if (_playQueue.empty())
+    {
+        _frameShownAt = Clock::now();
+    }
+
+    _slotDelays[slot] = frame.delay;
+    _playQueue.push_back({slot, frame.delay});
+    _uploadedCount++;
+}
+
+// As many slots as fit in the budget and in the largest texture, a frame
+// on screen and the next one need at least two
+int AnimationPlayer::SlotCount(
+    int width,
+    int height,
+    int maxTextureSize)
+{
+    if (width <= 0 || height <= 0 || width > maxTextureSize || height > maxTextureSize)
+    {
+        return 0;
+    }
+
+    auto frameBytes = static_cast<size_t>(width) * height * 4;
+    auto slotCount = static_cast<int>(std::clamp<size_t>(ANIMATION_ATLAS_BUDGET / frameBytes, 2, ANIMATION_ATLAS_FRAMES));
+    auto columns = std::min(slotCount, maxTextureSize / width);
+    auto rows = std::min((slotCount + columns - 1) / columns, maxTextureSize / height);
+
+    return std::min(slotCount, columns * rows);
+}
+
+// Runs on the worker pool until enough frames are decoded ahead, the player
+// starts it again when it has taken some
+void AnimationPlayer::DecodeFrames(
+    std::shared_ptr<DecodeQueue> decodeQueue,
+    FrameScheduler *frameScheduler)
+{
+    std::unique_lock<std::mutex> lock(decodeQueue->mutex);
+
+    if (!decodeQueue->isOpen)
+    {
+        decodeQueue->isOpen = true;
+
+        lock.unlock();
+        auto isOpened = decodeQueue->decoder.Open(decodeQueue->path);
+        lock.lock();
+
+        decodeQueue->width = decodeQueue->decoder.Width();
+        decodeQueue->height = decodeQueue->decoder.Height();
+        decodeQueue->slotCount = SlotCount(decodeQueue->width, decodeQueue->height, decodeQueue->maxTextureSize);
+
+        if (!isOpened || decodeQueue->slotCount < 2)
+        {
+            decodeQueue->isFinished = true;
+        }
+    }
+
+    while (!decodeQueue->isCancelled && !decodeQueue->isFinished && decodeQueue->frames.size() < ANIMATION_DECODE_AHEAD)
+    {
+        int delay = 0;
+
+        lock.unlock();
+        auto image = decodeQueue->decoder.Next(delay);
+        lock.lock();
+
+        if (image == nullptr)
+        {
+            decodeQueue->frameCount = decodeQueue->nextIndex;
+
+            // Single frames and animations that fit in the atlas are decoded once
+            if (decodeQueue->nextIndex <= decodeQueue->slotCount)
+            {
+                decodeQueue->isFinished = true;
+                break;
+            }
+
+            decodeQueue->nextIndex = 0;
+            decodeQueue->decoder.Rewind();
+
+            continue;
+        }
+
+        // Browsers play these delays at 10 frames per second, gifs rely on that
+        if (delay <= 10)
+        {
+            delay = ANIMATION_DEFAULT_DELAY;
+        }
+
+        decodeQueue->frames.push_back({decodeQueue->nextIndex++, delay, image});
+
+        frameScheduler->RequestFrame();
+    }
+
+    decodeQueue->isDecoding = false;
+}
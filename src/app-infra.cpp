@@ -24,7 +24,14 @@ struct WindowHandle
 
 App::App(
     const std::vector<std::string> &args)
-    : _args(args)
+    : _args(args),
+      _textureUploader(&_workerPool, &_frameScheduler),
+      _textureCache(&_textureUploader),
+      _decodedImageCache(&_workerPool, &_frameScheduler),
+      _histogramCache(&_workerPool, &_frameScheduler),
+      _thumbnailCache(&_workerPool, &_frameScheduler),
+      _exifIndex(&_workerPool, &_frameScheduler),
+      _imageDirectoryIndex(&_exifIndex)
 {}
 
 App::~App() = default;
@@ -92,6 +99,9 @@ bool App::Init()
         return false;
     }
 
+    // Thread safe, background work uses it to wake the main loop
+    _frameScheduler.SetWake([]() { glfwPostEmptyEvent(); });
+
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, OPENGL_LATEST_VERSION_MAJOR);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, OPENGL_LATEST_VERSION_MINOR);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -273,7 +283,21 @@ int App::Run()
 
     while (glfwWindowShouldClose(windowHandle->window) == 0 && running)
     {
-        glfwWaitEvents();
+        // Sleeps until there is input, or until a frame was asked for
+        auto waitTime = _frameScheduler.TakeWaitTime();
+        if (waitTime < 0.0)
+        {
+            glfwWaitEvents();
+        }
+        else if (waitTime > 0.0)
+        {
+            glfwWaitEventsTimeout(waitTime);
+        }
+        else
+        {
+            glfwPollEvents();
+        }
+
         glfwMakeContextCurrent(windowHandle->window);
 
         // Start the Dear ImGui frame
@@ -308,6 +332,8 @@ int App::Run()
 
     OnExit();
 
+    _frameScheduler.SetWake(nullptr);
+
     ImGui::SaveIniSettingsToDisk((GetUserProfileDir() / "imgui.ini").string().c_str());
 
     ClearWindowHandle();
@@ -6,6 +6,7 @@
 #include <sstream>
 
 #include <IconsMaterialDesign.h>
+#include <imagearchive.h>
 #include <openfindwidget.h>
 #include <openfolderwidget.h>
 #include <openimagewidget.h>
@@ -177,11 +178,71 @@ void App::OnInit()
             return (GenericServicePtr)&_settingsService;
         });
 
+    _services.Add<WorkerPool *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_workerPool;
+        });
+
+    _services.Add<FrameScheduler *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_frameScheduler;
+        });
+
+    _services.Add<TextureUploader *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_textureUploader;
+        });
+
+    _services.Add<TextureCache *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_textureCache;
+        });
+
+    _services.Add<DecodedImageCache *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_decodedImageCache;
+        });
+
+    _services.Add<HistogramCache *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_histogramCache;
+        });
+
+    // Without the database thumbnails are still made, they just don't last
+    _thumbnailCache.Open(GetUserProfileDir() / "thumbnails.sqlitedb");
+
+    _services.Add<ThumbnailCache *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_thumbnailCache;
+        });
+
+    _exifIndex.Open(GetUserProfileDir() / "exif-index.sqlitedb");
+
+    _services.Add<ExifIndex *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_exifIndex;
+        });
+
+    _services.Add<ImageDirectoryIndex *>(
+        [&](ServiceProvider &sp) -> GenericServicePtr {
+            return (GenericServicePtr)&_imageDirectoryIndex;
+        });
+
+    if (_metadataIndex.Open(GetUserProfileDir() / "metadata-index.sqlitedb"))
+    {
+        _services.Add<MetadataIndex *>(
+            [&](ServiceProvider &sp) -> GenericServicePtr {
+                return (GenericServicePtr)&_metadataIndex;
+            });
+    }
+
     auto openFiles = _settingsService.GetOpenFiles();
 
     for (const auto &pair : openFiles)
     {
-        if (!std::filesystem::exists(pair.second))
+        // Pages of an archive are reopened as long as the archive is there
+        std::filesystem::path archive, member;
+        if (!std::filesystem::exists(pair.second) && !ImageArchive::Split(pair.second, archive, member))
         {
             continue;
         }
@@ -214,6 +275,9 @@ void App::OnExit()
     _settingsService.SetOpenFiles(res);
 
     AppLog.FinishThread();
+
+    _textureCache.ReleaseAll();
+    _textureUploader.Release();
 }
 
 bool replace(
@@ -281,6 +345,9 @@ void App::ActivatePath(
     const std::filesystem::path &path,
     int index)
 {
+    // Archives without images open as text, like any other file
+    auto archivePages = ImageArchive::IsArchive(path) ? _imageDirectoryIndex.Get(path) : nullptr;
+
     if (std::filesystem::is_directory(path))
     {
         auto widget = std::make_unique<OpenFolderWidget>(
@@ -319,6 +386,16 @@ void App::ActivatePath(
 
         _queuedDocuments.push_back(std::move(widget));
     }
+    else if (archivePages != nullptr && archivePages->Count() > 0)
+    {
+        auto widget = std::make_unique<OpenImageWidget>(
+            index,
+            &_services);
+
+        widget->Open(archivePages->At(0));
+
+        _queuedDocuments.push_back(std::move(widget));
+    }
     else if (path.extension() == L".exe" || path.extension() == L".bat" || path.extension() == L".cmd")
     {
         ExecuteRunInCommand(path, L"start $fullpath", []() {});
@@ -349,6 +426,8 @@ void App::OnFrame()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    _textureUploader.Update();
+
     auto viewPort = ImGui::GetMainViewport();
 
     ImGui::ShowDemoWindow(nullptr);
@@ -461,6 +540,8 @@ void App::OnFrame()
         ImGui::EndPopup();
     }
     AddQueuedItems();
+
+    _textureCache.EndFrame();
 }
 
 std::filesystem::path App::GetUserProfileDir()
@@ -0,0 +1,180 @@
+#include "bytepattern.h"
+
+#include <cctype>
+#include <fmt/format.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BYTEPATTERN_USE_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int HexValue(
+    char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+    return -1;
+}
+
+static int LowestBit(
+    unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+bool BytePattern::Parse(
+    const std::string &text)
+{
+    _bytes.clear();
+    _isWildcard.clear();
+
+    size_t i = 0;
+    while (i < text.size())
+    {
+        if (std::isspace(static_cast<unsigned char>(text[i])) || text[i] == ',')
+        {
+            i++;
+            continue;
+        }
+
+        if (text[i] == '?')
+        {
+            _bytes.push_back(0);
+            _isWildcard.push_back(true);
+            i += (i + 1 < text.size() && text[i + 1] == '?') ? 2 : 1;
+            continue;
+        }
+
+        if (text.compare(i, 2, "0x") == 0 || text.compare(i, 2, "0X") == 0)
+        {
+            i += 2;
+            continue;
+        }
+
+        if (i + 1 >= text.size())
+        {
+            return false;
+        }
+
+        auto high = HexValue(text[i]);
+        auto low = HexValue(text[i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+
+        _bytes.push_back(static_cast<unsigned char>((high << 4) | low));
+        _isWildcard.push_back(false);
+        i += 2;
+    }
+
+    // The prefilter needs at least one byte that is not a wildcard
+    _firstFixed = _lastFixed = _bytes.size();
+    for (size_t b = 0; b < _bytes.size(); b++)
+    {
+        if (_isWildcard[b]) continue;
+
+        if (_firstFixed == _bytes.size())
+        {
+            _firstFixed = b;
+        }
+        _lastFixed = b;
+    }
+
+    return _firstFixed < _bytes.size();
+}
+
+std::string BytePattern::ToString() const
+{
+    std::string result;
+
+    for (size_t i = 0; i < _bytes.size(); i++)
+    {
+        if (!result.empty()) result += " ";
+        result += _isWildcard[i] ? "??" : fmt::format("{:02X}", _bytes[i]);
+    }
+
+    return result;
+}
+
+bool BytePattern::MatchesAt(
+    const unsigned char *data) const
+{
+    for (size_t i = 0; i < _bytes.size(); i++)
+    {
+        if (!_isWildcard[i] && data[i] != _bytes[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void BytePattern::FindAll(
+    const unsigned char *data,
+    size_t size,
+    const std::function<bool(size_t offset)> &onMatch) const
+{
+    if (_bytes.empty() || _firstFixed >= _bytes.size() || size < _bytes.size())
+    {
+        return;
+    }
+
+    auto lastStart = size - _bytes.size();
+    size_t start = 0;
+
+#ifdef BYTEPATTERN_USE_SSE2
+    // Compare the first and the last fixed byte of the pattern for 16
+    // candidate positions at once, only positions where both agree are
+    // verified byte by byte
+    auto first = _mm_set1_epi8(static_cast<char>(_bytes[_firstFixed]));
+    auto last = _mm_set1_epi8(static_cast<char>(_bytes[_lastFixed]));
+
+    for (; start + 16 <= lastStart + 1; start += 16)
+    {
+        auto blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + start + _firstFixed));
+        auto blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + start + _lastFixed));
+
+        auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(blockFirst, first),
+            _mm_cmpeq_epi8(blockLast, last))));
+
+        while (mask != 0)
+        {
+            auto offset = start + LowestBit(mask);
+            mask &= mask - 1;
+
+            if (MatchesAt(data + offset) && !onMatch(offset))
+            {
+                return;
+            }
+        }
+    }
+#endif
+
+    for (; start <= lastStart; start++)
+    {
+        if (data[start + _firstFixed] != _bytes[_firstFixed])
+        {
+            continue;
+        }
+
+        if (MatchesAt(data + start) && !onMatch(start))
+        {
+            return;
+        }
+    }
+}
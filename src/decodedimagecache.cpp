@@ -0,0 +1,195 @@
+#include "decodedimagecache.h"
+
+DecodedImageCache::DecodedImageCache(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler,
+    size_t budget)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler),
+      _budget(budget)
+{}
+
+DecodedImageCache::~DecodedImageCache()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _isStopping = true;
+
+    _jobsDone.wait(lock, [this]() { return _jobsInFlight == 0; });
+}
+
+void DecodedImageCache::Request(
+    int owner,
+    const std::vector<DecodeRequest> &requests)
+{
+    std::set<DecodeRequest> wanted(requests.begin(), requests.end());
+    std::vector<DecodeRequest> toDecode;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            if (wanted.find(it->first) == wanted.end())
+            {
+                it->second.wantedBy.erase(owner);
+            }
+
+            if (it->second.state == DecodeStates::Queued && it->second.wantedBy.empty())
+            {
+                it = _entries.erase(it);
+                continue;
+            }
+
+            ++it;
+        }
+
+        for (const auto &request : requests)
+        {
+            auto found = _entries.find(request);
+            if (found == _entries.end())
+            {
+                found = _entries.insert(std::make_pair(request, Entry())).first;
+                found->second.lruPosition = _lru.end();
+
+                toDecode.push_back(request);
+                _jobsInFlight++;
+            }
+
+            found->second.wantedBy.insert(owner);
+        }
+
+        Evict();
+    }
+
+    // Enqueued in the order given, so the image that is shown goes first
+    for (const auto &request : toDecode)
+    {
+        _workerPool->Enqueue([this, request]() { Decode(request); });
+    }
+}
+
+void DecodedImageCache::Release(
+    int owner)
+{
+    Request(owner, {});
+}
+
+DecodeStates DecodedImageCache::Lookup(
+    const DecodeRequest &request,
+    std::shared_ptr<DecodedImage> &image)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _entries.find(request);
+    if (found == _entries.end())
+    {
+        return DecodeStates::NotCached;
+    }
+
+    if (found->second.state == DecodeStates::Ready)
+    {
+        _lru.splice(_lru.begin(), _lru, found->second.lruPosition);
+        image = found->second.image;
+    }
+
+    return found->second.state;
+}
+
+void DecodedImageCache::SetBudget(
+    size_t budget)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _budget = budget;
+
+    Evict();
+}
+
+size_t DecodedImageCache::UsedBytes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _usedBytes;
+}
+
+void DecodedImageCache::Decode(
+    const DecodeRequest &request)
+{
+    bool shouldDecode = false;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _entries.find(request);
+        if (!_isStopping && found != _entries.end() && found->second.state == DecodeStates::Queued)
+        {
+            found->second.state = DecodeStates::Decoding;
+            shouldDecode = true;
+        }
+    }
+
+    std::shared_ptr<DecodedImage> image;
+    if (shouldDecode)
+    {
+        if (request.maxDimension == DecodeRequest::EmbeddedThumbnail)
+        {
+            image = ImageDecoder::DecodeEmbeddedThumbnail(request.path);
+        }
+        else
+        {
+            image = ImageDecoder::Decode(request.path, request.maxDimension);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _entries.find(request);
+    if (shouldDecode && found != _entries.end())
+    {
+        found->second.state = image != nullptr ? DecodeStates::Ready : DecodeStates::Failed;
+        found->second.image = image;
+
+        _lru.push_front(request);
+        found->second.lruPosition = _lru.begin();
+
+        if (image != nullptr)
+        {
+            _usedBytes += image->ByteSize();
+        }
+
+        Evict();
+    }
+
+    _jobsInFlight--;
+    _jobsDone.notify_all();
+
+    if (shouldDecode)
+    {
+        _frameScheduler->RequestFrame();
+    }
+}
+
+// Images somebody still wants are kept, even when that means going over budget
+void DecodedImageCache::Evict()
+{
+    auto it = _lru.end();
+    while (_usedBytes > _budget && it != _lru.begin())
+    {
+        --it;
+
+        auto found = _entries.find(*it);
+        if (!found->second.wantedBy.empty())
+        {
+            continue;
+        }
+
+        if (found->second.image != nullptr)
+        {
+            _usedBytes -= found->second.image->ByteSize();
+        }
+
+        _entries.erase(found);
+        it = _lru.erase(it);
+    }
+}
@@ -0,0 +1,453 @@
+#include "exifindex.h"
+#include "imagedecoder.h"
+
+#include <EXIF.H>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stb_image.h>
+
+static std::string Trimmed(
+    const char *text,
+    size_t maxLength)
+{
+    std::string result(text, strnlen(text, maxLength));
+
+    auto end = result.find_last_not_of(' ');
+
+    return end == std::string::npos ? std::string() : result.substr(0, end + 1);
+}
+
+ExifIndex::ExifIndex(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler)
+{}
+
+ExifIndex::~ExifIndex()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _isStopping = true;
+
+    _jobsDone.wait(lock, [this]() { return _jobsInFlight == 0; });
+}
+
+bool ExifIndex::Open(
+    const std::filesystem::path &databaseFile)
+{
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    _db = std::make_unique<sqlitelib::Sqlite>(databaseFile.string().c_str());
+
+    if (!_db->is_open())
+    {
+        _db = nullptr;
+
+        return false;
+    }
+
+    EnsureTables();
+
+    return true;
+}
+
+void ExifIndex::EnsureTables()
+{
+    auto queries = {
+        R"(CREATE TABLE IF NOT EXISTS ExifInfo (
+        path TEXT PRIMARY KEY,
+        directory TEXT NOT NULL,
+        size REAL NOT NULL,
+        modified REAL NOT NULL,
+        capture_time TEXT NOT NULL,
+        camera TEXT NOT NULL,
+        orientation INTEGER NOT NULL,
+        width INTEGER NOT NULL,
+        height INTEGER NOT NULL
+    );)",
+        R"(CREATE INDEX IF NOT EXISTS ExifInfoDirectory ON ExifInfo (directory);)",
+    };
+
+    for (auto query : queries)
+    {
+        try
+        {
+            _db->execute(query, -1);
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << _db->errmsg() << std::endl;
+        }
+    }
+}
+
+void ExifIndex::Scan(
+    const std::filesystem::path &directory)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_isStopping || !_scanning.insert(directory).second)
+        {
+            return;
+        }
+
+        _jobsInFlight++;
+    }
+
+    _workerPool->Enqueue([this, directory]() { ScanDirectory(directory); });
+}
+
+bool ExifIndex::Lookup(
+    const std::filesystem::path &path,
+    ExifInfo &info)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _infos.find(path);
+    if (found == _infos.end())
+    {
+        return false;
+    }
+
+    info = found->second;
+
+    return true;
+}
+
+void ExifIndex::SortByCaptureTime(
+    std::vector<std::filesystem::path> &paths)
+{
+    std::vector<std::pair<std::string, std::filesystem::path>> keyed;
+    keyed.reserve(paths.size());
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto &path : paths)
+        {
+            auto found = _infos.find(path);
+            keyed.emplace_back(found != _infos.end() ? found->second.captureTime : std::string(), std::move(path));
+        }
+    }
+
+    std::stable_sort(
+        keyed.begin(),
+        keyed.end(),
+        [](const auto &a, const auto &b) {
+            if (a.first.empty() || b.first.empty())
+            {
+                return !a.first.empty() && b.first.empty();
+            }
+
+            return a.first < b.first;
+        });
+
+    for (size_t i = 0; i < keyed.size(); i++)
+    {
+        paths[i] = std::move(keyed[i].second);
+    }
+}
+
+// Files that were scanned before and did not change come from the database,
+// the others are read in batches so every worker gets a share
+void ExifIndex::ScanDirectory(
+    const std::filesystem::path &directory)
+{
+    auto stored = Load(directory);
+
+    std::vector<std::pair<std::filesystem::path, ExifInfo>> known;
+    std::vector<std::pair<std::filesystem::path, ExifInfo>> toRead;
+
+    std::error_code ec;
+    for (auto const &dir_entry : std::filesystem::directory_iterator{directory, ec})
+    {
+        if (!ImageDecoder::IsSupported(dir_entry.path()))
+        {
+            continue;
+        }
+
+        std::error_code sizeError, modifiedError;
+
+        ExifInfo info;
+        info.size = static_cast<double>(std::filesystem::file_size(dir_entry.path(), sizeError));
+        info.modified = static_cast<double>(std::filesystem::last_write_time(dir_entry.path(), modifiedError).time_since_epoch().count());
+
+        if (sizeError || modifiedError)
+        {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto found = _infos.find(dir_entry.path());
+            if (found != _infos.end() && found->second.size == info.size && found->second.modified == info.modified)
+            {
+                continue;
+            }
+        }
+
+        auto found = stored.find(dir_entry.path());
+        if (found != stored.end() && found->second.size == info.size && found->second.modified == info.modified)
+        {
+            known.emplace_back(dir_entry.path(), found->second);
+        }
+        else
+        {
+            toRead.emplace_back(dir_entry.path(), info);
+        }
+    }
+
+    auto batchCount = static_cast<int>((toRead.size() + EXIF_SCAN_BATCH - 1) / EXIF_SCAN_BATCH);
+    auto batchesLeft = std::make_shared<std::atomic<int>>(batchCount);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto &info : known)
+        {
+            _infos[info.first] = info.second;
+        }
+
+        if (!known.empty())
+        {
+            _generation++;
+        }
+
+        if (batchCount == 0 || _isStopping)
+        {
+            _scanning.erase(directory);
+            batchCount = 0;
+        }
+
+        _jobsInFlight += batchCount;
+    }
+
+    for (int i = 0; i < batchCount; i++)
+    {
+        auto first = toRead.begin() + i * EXIF_SCAN_BATCH;
+        auto last = toRead.begin() + std::min(toRead.size(), static_cast<size_t>(i + 1) * EXIF_SCAN_BATCH);
+
+        std::vector<std::pair<std::filesystem::path, ExifInfo>> batch(first, last);
+
+        _workerPool->Enqueue([this, directory, batch, batchesLeft]() { ReadBatch(directory, batch, batchesLeft); });
+    }
+
+    if (!known.empty())
+    {
+        _frameScheduler->RequestFrame();
+    }
+
+    FinishJob();
+}
+
+// Files that fail to read are stored as well, with nothing but their size and
+// modification time, so they are not read again on every visit
+void ExifIndex::ReadBatch(
+    const std::filesystem::path &directory,
+    std::vector<std::pair<std::filesystem::path, ExifInfo>> batch,
+    std::shared_ptr<std::atomic<int>> batchesLeft)
+{
+    bool isStopping;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        isStopping = _isStopping;
+    }
+
+    if (!isStopping)
+    {
+        for (auto &info : batch)
+        {
+            Read(info.first, info.second);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (auto &info : batch)
+            {
+                _infos[info.first] = info.second;
+            }
+
+            _generation++;
+        }
+
+        Store(directory, batch);
+
+        _frameScheduler->RequestFrame();
+    }
+
+    if (--*batchesLeft == 0)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _scanning.erase(directory);
+    }
+
+    FinishJob();
+}
+
+void ExifIndex::FinishJob()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _jobsInFlight--;
+    _jobsDone.notify_all();
+}
+
+// Only the start of the file is read. A jpeg keeps its EXIF data in the first
+// segments and the parser stops at the compressed data, other formats have
+// their dimensions in the first few bytes.
+bool ExifIndex::Read(
+    const std::filesystem::path &path,
+    ExifInfo &info)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> header(EXIF_HEADER_SIZE);
+    file.read(reinterpret_cast<char *>(header.data()), static_cast<std::streamsize>(header.size()));
+    header.resize(static_cast<size_t>(file.gcount()));
+
+    if (header.empty())
+    {
+        return false;
+    }
+
+    // A header that ends before the compressed data fails to decode, what
+    // was found in the segments before that is still good
+    Cexif exif;
+    exif.DecodeExif(header.data(), header.size());
+
+    if (exif.m_exifinfo->IsExif)
+    {
+        info.captureTime = Trimmed(exif.m_exifinfo->DateTime, sizeof(exif.m_exifinfo->DateTime));
+        if (info.captureTime.rfind("0000", 0) == 0)
+        {
+            info.captureTime.clear();
+        }
+
+        auto make = Trimmed(exif.m_exifinfo->CameraMake, sizeof(exif.m_exifinfo->CameraMake));
+        auto model = Trimmed(exif.m_exifinfo->CameraModel, sizeof(exif.m_exifinfo->CameraModel));
+        info.camera = model.rfind(make, 0) == 0 ? model : Trimmed((make + " " + model).c_str(), make.size() + model.size() + 1);
+
+        info.orientation = exif.m_exifinfo->Orientation != 0 ? exif.m_exifinfo->Orientation : 1;
+    }
+
+    if (exif.m_exifinfo->Width > 0 && exif.m_exifinfo->Height > 0)
+    {
+        info.width = exif.m_exifinfo->Width;
+        info.height = exif.m_exifinfo->Height;
+    }
+    else
+    {
+        int channels;
+        if (!stbi_info_from_memory(header.data(), static_cast<int>(header.size()), &info.width, &info.height, &channels))
+        {
+            info.width = info.height = 0;
+        }
+    }
+
+    return true;
+}
+
+std::map<std::filesystem::path, ExifInfo> ExifIndex::Load(
+    const std::filesystem::path &directory)
+{
+    std::map<std::filesystem::path, ExifInfo> result;
+
+    std::vector<std::tuple<std::string, double, double, std::string, std::string, int, int, int>> rows;
+
+    {
+        std::lock_guard<std::mutex> lock(_dbMutex);
+
+        if (_db == nullptr)
+        {
+            return result;
+        }
+
+        try
+        {
+            rows = _db->prepare<std::string, double, double, std::string, std::string, int, int, int>(
+                          "SELECT path, size, modified, capture_time, camera, orientation, width, height FROM ExifInfo WHERE directory = ?", -1)
+                       .execute(directory.u8string());
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << _db->errmsg() << std::endl;
+        }
+    }
+
+    for (auto &row : rows)
+    {
+        ExifInfo info;
+        info.size = std::get<1>(row);
+        info.modified = std::get<2>(row);
+        info.captureTime = std::get<3>(row);
+        info.camera = std::get<4>(row);
+        info.orientation = std::get<5>(row);
+        info.width = std::get<6>(row);
+        info.height = std::get<7>(row);
+
+        result[std::filesystem::u8path(std::get<0>(row))] = info;
+    }
+
+    return result;
+}
+
+void ExifIndex::Store(
+    const std::filesystem::path &directory,
+    const std::vector<std::pair<std::filesystem::path, ExifInfo>> &infos)
+{
+    if (infos.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    if (_db == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        _db->execute("BEGIN TRANSACTION", -1);
+
+        auto insert = _db->prepare(R"(INSERT OR REPLACE INTO ExifInfo (path, directory, size, modified, capture_time, camera, orientation, width, height) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?))", -1);
+
+        for (const auto &info : infos)
+        {
+            insert.execute(
+                info.first.u8string(),
+                directory.u8string(),
+                info.second.size,
+                info.second.modified,
+                info.second.captureTime,
+                info.second.camera,
+                info.second.orientation,
+                info.second.width,
+                info.second.height);
+        }
+
+        _db->execute("COMMIT", -1);
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+
+        try
+        {
+            _db->execute("ROLLBACK", -1);
+        }
+        catch (std::exception &)
+        {
+        }
+    }
+}
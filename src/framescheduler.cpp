@@ -0,0 +1,63 @@
+#include "framescheduler.h"
+
+#include <algorithm>
+
+void FrameScheduler::SetWake(
+    WakeFunc wake)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _wake = wake;
+}
+
+void FrameScheduler::RequestFrame()
+{
+    Request(Clock::now());
+}
+
+void FrameScheduler::RequestFrameIn(
+    std::chrono::milliseconds delay)
+{
+    Request(Clock::now() + delay);
+}
+
+void FrameScheduler::Request(
+    Clock::time_point time)
+{
+    WakeFunc wake;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_isRequested && _nextFrame <= time)
+        {
+            return;
+        }
+
+        _isRequested = true;
+        _nextFrame = time;
+        wake = _wake;
+    }
+
+    // The loop may be waiting with a longer timeout, or without one
+    if (wake)
+    {
+        wake();
+    }
+}
+
+double FrameScheduler::TakeWaitTime()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_isRequested)
+    {
+        return -1.0;
+    }
+
+    _isRequested = false;
+
+    auto wait = std::chrono::duration<double>(_nextFrame - Clock::now()).count();
+
+    return std::max(0.0, wait);
+}
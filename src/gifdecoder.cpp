@@ -0,0 +1,136 @@
+#include "gifdecoder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+// A private copy of the gif loader, its frame by frame functions are not
+// part of the public stb_image interface. The public functions of the copy
+// are static and unused, which is not worth a warning.
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4505)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_GIF
+#define STBI_NO_STDIO
+#include <stb_image.h>
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+struct GifDecoder::State
+{
+    stbi__context context;
+    stbi__gif gif;
+};
+
+GifDecoder::GifDecoder() = default;
+
+GifDecoder::~GifDecoder()
+{
+    Reset();
+}
+
+bool GifDecoder::IsGif(
+    const std::filesystem::path &path)
+{
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    return extension == ".gif";
+}
+
+bool GifDecoder::Open(
+    const std::filesystem::path &path)
+{
+    Reset();
+
+    if (!_file.Open(path) || _file.Size() > static_cast<size_t>(INT_MAX))
+    {
+        return false;
+    }
+
+    Rewind();
+
+    int width, height, channels;
+    if (!stbi__gif_info_raw(&_state->context, &width, &height, &channels))
+    {
+        return false;
+    }
+
+    _width = width;
+    _height = height;
+
+    Rewind();
+
+    return true;
+}
+
+void GifDecoder::Reset()
+{
+    if (_state != nullptr)
+    {
+        STBI_FREE(_state->gif.out);
+        STBI_FREE(_state->gif.history);
+        STBI_FREE(_state->gif.background);
+    }
+
+    _state = nullptr;
+    _previous.clear();
+    _twoBack.clear();
+    _decodedCount = 0;
+}
+
+void GifDecoder::Rewind()
+{
+    Reset();
+
+    _state = std::make_unique<State>();
+    std::memset(&_state->gif, 0, sizeof(_state->gif));
+    stbi__start_mem(&_state->context, _file.Data(), static_cast<int>(_file.Size()));
+}
+
+std::shared_ptr<DecodedImage> GifDecoder::Next(
+    int &delay)
+{
+    if (_state == nullptr)
+    {
+        return nullptr;
+    }
+
+    int channels;
+    auto twoBack = _decodedCount >= 2 ? _twoBack.data() : nullptr;
+    auto frame = stbi__gif_load_next(&_state->context, &_state->gif, &channels, 4, twoBack);
+
+    // The loader returns its context at the end of the stream
+    if (frame == nullptr || frame == reinterpret_cast<stbi_uc *>(&_state->context))
+    {
+        return nullptr;
+    }
+
+    auto byteSize = static_cast<size_t>(_state->gif.w) * _state->gif.h * 4;
+
+    _twoBack.swap(_previous);
+    _previous.assign(frame, frame + byteSize);
+    _decodedCount++;
+
+    auto pixels = static_cast<unsigned char *>(std::malloc(byteSize));
+    if (pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::memcpy(pixels, frame, byteSize);
+
+    delay = _state->gif.delay;
+
+    return std::make_shared<DecodedImage>(_state->gif.w, _state->gif.h, pixels);
+}
@@ -0,0 +1,235 @@
+#include "gzipreader.h"
+
+#include <cstring>
+#include <miniz.h>
+
+#define GZIP_INPUT_CHUNK_SIZE (64 * 1024)
+
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+
+GzipReader::GzipReader() = default;
+
+GzipReader::~GzipReader()
+{
+    EndStream();
+}
+
+bool GzipReader::IsGzipFile(
+    const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    unsigned char magic[2] = {0};
+    if (!file.read(reinterpret_cast<char *>(magic), 2))
+    {
+        return false;
+    }
+
+    return magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+bool GzipReader::Open(
+    const std::filesystem::path &path)
+{
+    EndStream();
+
+    _file.open(path, std::ios::binary);
+    _input.resize(GZIP_INPUT_CHUNK_SIZE);
+    _inputPos = _inputEnd = 0;
+    _hasError = false;
+
+    if (!_file.is_open() || !ReadMemberHeader())
+    {
+        _hasError = true;
+
+        return false;
+    }
+
+    return true;
+}
+
+void GzipReader::EndStream()
+{
+    if (_stream != nullptr)
+    {
+        mz_inflateEnd(_stream.get());
+        _stream = nullptr;
+    }
+
+    _inMember = false;
+}
+
+bool GzipReader::EnsureInput(
+    size_t count)
+{
+    if (_inputEnd - _inputPos >= count)
+    {
+        return true;
+    }
+
+    // Move the unread bytes to the front and top up from the file
+    memmove(_input.data(), _input.data() + _inputPos, _inputEnd - _inputPos);
+    _inputEnd -= _inputPos;
+    _inputPos = 0;
+
+    if (count > _input.size())
+    {
+        _input.resize(count);
+    }
+
+    _file.read(reinterpret_cast<char *>(_input.data() + _inputEnd), _input.size() - _inputEnd);
+    _inputEnd += static_cast<size_t>(_file.gcount());
+
+    return _inputEnd - _inputPos >= count;
+}
+
+bool GzipReader::ReadMemberHeader()
+{
+    if (!EnsureInput(10))
+    {
+        return false;
+    }
+
+    auto header = _input.data() + _inputPos;
+    if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8)
+    {
+        return false;
+    }
+
+    auto flags = header[3];
+    _inputPos += 10;
+
+    if (flags & GZIP_FLAG_EXTRA)
+    {
+        if (!EnsureInput(2))
+        {
+            return false;
+        }
+
+        size_t extraLength = _input[_inputPos] | (_input[_inputPos + 1] << 8);
+        _inputPos += 2;
+
+        if (!EnsureInput(extraLength))
+        {
+            return false;
+        }
+
+        _inputPos += extraLength;
+    }
+
+    for (auto flag : {GZIP_FLAG_NAME, GZIP_FLAG_COMMENT})
+    {
+        if ((flags & flag) == 0)
+        {
+            continue;
+        }
+
+        while (true)
+        {
+            if (!EnsureInput(1))
+            {
+                return false;
+            }
+
+            if (_input[_inputPos++] == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    if (flags & GZIP_FLAG_HCRC)
+    {
+        if (!EnsureInput(2))
+        {
+            return false;
+        }
+
+        _inputPos += 2;
+    }
+
+    _stream = std::make_unique<mz_stream>();
+    memset(_stream.get(), 0, sizeof(mz_stream));
+
+    // gzip members hold raw deflate data, hence the negative window size
+    if (mz_inflateInit2(_stream.get(), -MZ_DEFAULT_WINDOW_BITS) != MZ_OK)
+    {
+        _stream = nullptr;
+
+        return false;
+    }
+
+    _inMember = true;
+
+    return true;
+}
+
+size_t GzipReader::Read(
+    char *buffer,
+    size_t size)
+{
+    size_t produced = 0;
+
+    while (produced < size && !_hasError)
+    {
+        if (!_inMember)
+        {
+            // Skip the crc32 and size trailer, concatenated members are
+            // inflated as one stream just like gzip itself does
+            if (!EnsureInput(8))
+            {
+                break;
+            }
+            _inputPos += 8;
+
+            if (!EnsureInput(1))
+            {
+                break;
+            }
+
+            if (!ReadMemberHeader())
+            {
+                _hasError = true;
+                break;
+            }
+        }
+
+        if (_inputPos == _inputEnd && !EnsureInput(1))
+        {
+            _hasError = true;
+            break;
+        }
+
+        _stream->next_in = _input.data() + _inputPos;
+        _stream->avail_in = static_cast<unsigned int>(_inputEnd - _inputPos);
+        _stream->next_out = reinterpret_cast<unsigned char *>(buffer + produced);
+        _stream->avail_out = static_cast<unsigned int>(size - produced);
+
+        auto status = mz_inflate(_stream.get(), MZ_SYNC_FLUSH);
+
+        _inputPos = _inputEnd - _stream->avail_in;
+        produced = size - _stream->avail_out;
+
+        if (status == MZ_STREAM_END)
+        {
+            EndStream();
+        }
+        else if (status == MZ_BUF_ERROR)
+        {
+            // No progress was possible with the input we have, read more
+            if (!EnsureInput(_inputEnd - _inputPos + 1))
+            {
+                _hasError = true;
+            }
+        }
+        else if (status != MZ_OK)
+        {
+            _hasError = true;
+        }
+    }
+
+    return produced;
+}
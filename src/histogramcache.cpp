@@ -0,0 +1,133 @@
+#include "histogramcache.h"
+#include "imagekernels.h"
+
+#include <algorithm>
+
+HistogramCache::HistogramCache(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler,
+    size_t capacity)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler),
+      _capacity(capacity)
+{}
+
+HistogramCache::~HistogramCache()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _isStopping = true;
+
+    _jobsDone.wait(lock, [this]() { return _jobsInFlight == 0; });
+}
+
+ImageHistogram HistogramCache::Get(
+    const DecodeRequest &request,
+    const std::shared_ptr<DecodedImage> &image)
+{
+    if (image == nullptr)
+    {
+        return ImageHistogram();
+    }
+
+    int id = 0;
+    size_t pixelCount = static_cast<size_t>(image->Width()) * image->Height();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _entries.find(request);
+        // Compared by owner, the address of a freed image can come back
+        if (found != _entries.end() && !found->second.image.owner_before(image) && !image.owner_before(found->second.image))
+        {
+            _lru.splice(_lru.begin(), _lru, found->second.lruPosition);
+
+            return found->second.histogram;
+        }
+
+        // A new image, or the file was decoded again
+        if (found == _entries.end())
+        {
+            _lru.push_front(request);
+            found = _entries.insert(std::make_pair(request, Entry())).first;
+        }
+        else
+        {
+            _lru.splice(_lru.begin(), _lru, found->second.lruPosition);
+        }
+
+        id = _nextId++;
+
+        found->second.id = id;
+        found->second.image = image;
+        found->second.histogram = ImageHistogram();
+        found->second.histogram.totalPixels = pixelCount;
+        found->second.lruPosition = _lru.begin();
+
+        while (_entries.size() > _capacity)
+        {
+            _entries.erase(_lru.back());
+            _lru.pop_back();
+        }
+
+        _jobsInFlight += static_cast<int>((pixelCount + HISTOGRAM_STRIPE_PIXELS - 1) / HISTOGRAM_STRIPE_PIXELS);
+    }
+
+    for (size_t first = 0; first < pixelCount; first += HISTOGRAM_STRIPE_PIXELS)
+    {
+        auto count = std::min(static_cast<size_t>(HISTOGRAM_STRIPE_PIXELS), pixelCount - first);
+
+        _workerPool->Enqueue([this, request, id, image, first, count]() { CountStripe(request, id, image, first, count); });
+    }
+
+    ImageHistogram histogram;
+    histogram.totalPixels = pixelCount;
+
+    return histogram;
+}
+
+void HistogramCache::CountStripe(
+    const DecodeRequest &request,
+    int id,
+    std::shared_ptr<DecodedImage> image,
+    size_t first,
+    size_t count)
+{
+    bool isWanted = false;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _entries.find(request);
+        isWanted = !_isStopping && found != _entries.end() && found->second.id == id;
+    }
+
+    std::array<uint32_t, 4 * 256> counts = {};
+
+    if (isWanted)
+    {
+        ImageKernels::Histogram(image->Pixels() + first * 4, count, counts.data());
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _entries.find(request);
+    if (isWanted && found != _entries.end() && found->second.id == id)
+    {
+        auto &histogram = found->second.histogram;
+
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            histogram.counts[i] += counts[i];
+        }
+        histogram.countedPixels += count;
+    }
+
+    _jobsInFlight--;
+    _jobsDone.notify_all();
+
+    if (isWanted)
+    {
+        _frameScheduler->RequestFrame();
+    }
+}
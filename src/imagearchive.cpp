@@ -0,0 +1,183 @@
+#include "imagearchive.h"
+#include "imagedecoder.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <miniz.h>
+
+#define ZIP_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE 30
+
+bool ImageArchive::IsArchive(
+    const std::filesystem::path &path)
+{
+    auto ext = path.extension().wstring();
+
+    std::transform(
+        ext.begin(),
+        ext.end(),
+        ext.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    return ext == L".zip" || ext == L".cbz";
+}
+
+bool ImageArchive::Split(
+    const std::filesystem::path &path,
+    std::filesystem::path &archive,
+    std::filesystem::path &member)
+{
+    std::error_code ec;
+
+    for (auto part = path.parent_path(); part.has_relative_path(); part = part.parent_path())
+    {
+        if (IsArchive(part) && std::filesystem::is_regular_file(part, ec))
+        {
+            archive = part;
+            member = path.lexically_relative(part);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<std::filesystem::path> ImageArchive::Images(
+    const std::filesystem::path &archive)
+{
+    std::vector<std::filesystem::path> images;
+
+    MappedFile file;
+    if (!file.Open(archive))
+    {
+        return images;
+    }
+
+    mz_zip_archive zip;
+
+    memset(&zip, 0, sizeof(zip));
+    if (!mz_zip_reader_init_mem(&zip, file.Data(), file.Size(), 0))
+    {
+        return images;
+    }
+
+    mz_zip_archive_file_stat stat;
+    for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&zip); i++)
+    {
+        if (!mz_zip_reader_file_stat(&zip, i, &stat) || stat.m_is_directory || stat.m_is_encrypted)
+        {
+            continue;
+        }
+
+        auto member = std::filesystem::u8path(stat.m_filename);
+
+        // Absolute or parent relative names would point outside the archive
+        if (member.empty() || member.has_root_path() || *member.lexically_normal().begin() == "..")
+        {
+            continue;
+        }
+
+        if (ImageDecoder::IsSupported(member))
+        {
+            images.push_back(archive / member);
+        }
+    }
+
+    mz_zip_reader_end(&zip);
+
+    return images;
+}
+
+// The data of a member that is stored without compression, found behind its
+// local header. Returns nullptr when it has to be inflated.
+static const unsigned char *StoredData(
+    const MappedFile &file,
+    const mz_zip_archive_file_stat &stat)
+{
+    if (stat.m_method != 0 || stat.m_is_encrypted || stat.m_comp_size != stat.m_uncomp_size)
+    {
+        return nullptr;
+    }
+
+    auto data = file.Data();
+    auto offset = static_cast<size_t>(stat.m_local_header_ofs);
+    if (offset + ZIP_LOCAL_HEADER_SIZE > file.Size())
+    {
+        return nullptr;
+    }
+
+    auto header = data + offset;
+    auto signature = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+    if (signature != ZIP_LOCAL_HEADER_SIGNATURE)
+    {
+        return nullptr;
+    }
+
+    auto nameLength = static_cast<size_t>(header[26] | (header[27] << 8));
+    auto extraLength = static_cast<size_t>(header[28] | (header[29] << 8));
+    auto start = offset + ZIP_LOCAL_HEADER_SIZE + nameLength + extraLength;
+    if (start > file.Size() || file.Size() - start < stat.m_comp_size)
+    {
+        return nullptr;
+    }
+
+    return data + start;
+}
+
+bool ImageArchive::Read(
+    const std::filesystem::path &memberPath,
+    const ReadFunc &read)
+{
+    std::filesystem::path archive, member;
+    if (!Split(memberPath, archive, member))
+    {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.Open(archive))
+    {
+        return false;
+    }
+
+    mz_zip_archive zip;
+
+    memset(&zip, 0, sizeof(zip));
+    if (!mz_zip_reader_init_mem(&zip, file.Data(), file.Size(), 0))
+    {
+        return false;
+    }
+
+    auto isRead = false;
+
+    mz_zip_archive_file_stat stat;
+    auto index = mz_zip_reader_locate_file(&zip, member.generic_u8string().c_str(), nullptr, MZ_ZIP_FLAG_CASE_SENSITIVE);
+    if (index >= 0 && mz_zip_reader_file_stat(&zip, index, &stat) && stat.m_uncomp_size <= IMAGE_ARCHIVE_MAX_MEMBER_SIZE)
+    {
+        auto stored = StoredData(file, stat);
+        if (stored != nullptr)
+        {
+            // A read only page of the mapping, decoding never writes to it
+            read(stored, static_cast<size_t>(stat.m_uncomp_size));
+            isRead = true;
+        }
+        else
+        {
+            size_t size = 0;
+            auto inflated = mz_zip_reader_extract_to_heap(&zip, index, &size, 0);
+            if (inflated != nullptr)
+            {
+                read(static_cast<const unsigned char *>(inflated), size);
+                isRead = true;
+
+                mz_free(inflated);
+            }
+        }
+    }
+
+    mz_zip_reader_end(&zip);
+
+    return isRead;
+}
@@ -0,0 +1,320 @@
+#include "imagedecoder.h"
+#include "imagearchive.h"
+#include "imagekernels.h"
+#include "mappedfile.h"
+
+#include <EXIF.H>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stb_image.h>
+
+DecodedImage::DecodedImage(
+    int width,
+    int height,
+    unsigned char *pixels)
+    : originalWidth(width),
+      originalHeight(height),
+      _width(width),
+      _height(height),
+      _pixels(pixels)
+{}
+
+DecodedImage::~DecodedImage()
+{
+    stbi_image_free(_pixels);
+}
+
+// The file is mapped once and both stb_image and the EXIF parser read from
+// the mapping, instead of each reading the file. Paths that are not files
+// can be members of an archive. The mapping is read only, neither of them
+// writes to the buffer.
+std::shared_ptr<DecodedImage> ImageDecoder::Decode(
+    const std::filesystem::path &path,
+    int maxDimension)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        std::shared_ptr<DecodedImage> image;
+
+        ImageArchive::Read(path, [&](const unsigned char *data, size_t size) {
+            if (size <= static_cast<size_t>(INT_MAX))
+            {
+                image = DecodeMemory(data, size, maxDimension);
+            }
+        });
+
+        return image;
+    }
+
+    if (file.Size() > static_cast<size_t>(INT_MAX))
+    {
+        return nullptr;
+    }
+
+    return DecodeMemory(file.Data(), file.Size(), maxDimension);
+}
+
+std::shared_ptr<DecodedImage> ImageDecoder::DecodeMemory(
+    const unsigned char *data,
+    size_t size,
+    int maxDimension)
+{
+    if (data == nullptr || size == 0)
+    {
+        return nullptr;
+    }
+
+    int x, y, channels;
+    auto imageData = IsConvertedAfterDecoding(data, size)
+                         ? LoadRgbAsRgba(data, size, x, y)
+                         : nullptr;
+
+    if (imageData == nullptr)
+    {
+        imageData = stbi_load_from_memory(data, static_cast<int>(size), &x, &y, &channels, 4);
+    }
+
+    if (imageData == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto image = std::make_shared<DecodedImage>(x, y, imageData);
+
+    if (maxDimension > 0 && std::max(x, y) > maxDimension)
+    {
+        image = Downscale(*image, maxDimension);
+    }
+
+    if (image != nullptr)
+    {
+        image->orientation = ReadOrientation(data, size);
+    }
+
+    return image;
+}
+
+// Jpeg, png, bmp and gif are written as RGBA while decoding. Other formats are
+// decoded with the channels of the file and converted after.
+bool ImageDecoder::IsConvertedAfterDecoding(
+    const unsigned char *data,
+    size_t size)
+{
+    if (size < 4)
+    {
+        return false;
+    }
+
+    if (data[0] == 0xFF && data[1] == 0xD8) return false;
+    if (memcmp(data, "\x89PNG", 4) == 0) return false;
+    if (memcmp(data, "BM", 2) == 0) return false;
+    if (memcmp(data, "GIF", 3) == 0) return false;
+
+    return true;
+}
+
+// Returns nullptr when the image does not have three channels
+unsigned char *ImageDecoder::LoadRgbAsRgba(
+    const unsigned char *data,
+    size_t size,
+    int &width,
+    int &height)
+{
+    int channels;
+    if (!stbi_info_from_memory(data, static_cast<int>(size), &width, &height, &channels) || channels != 3)
+    {
+        return nullptr;
+    }
+
+    auto rgb = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &channels, 3);
+    if (rgb == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto rgba = static_cast<unsigned char *>(malloc(static_cast<size_t>(width) * height * 4));
+    if (rgba != nullptr)
+    {
+        ImageKernels::ExpandRgbToRgba(rgb, rgba, static_cast<size_t>(width) * height);
+    }
+
+    stbi_image_free(rgb);
+
+    return rgba;
+}
+
+std::shared_ptr<DecodedImage> ImageDecoder::DecodeEmbeddedThumbnail(
+    const std::filesystem::path &path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        std::shared_ptr<DecodedImage> image;
+
+        ImageArchive::Read(path, [&](const unsigned char *data, size_t size) {
+            image = DecodeEmbeddedThumbnail(data, size);
+        });
+
+        return image;
+    }
+
+    return DecodeEmbeddedThumbnail(file.Data(), file.Size());
+}
+
+std::shared_ptr<DecodedImage> ImageDecoder::DecodeEmbeddedThumbnail(
+    const unsigned char *data,
+    size_t size)
+{
+    if (data == nullptr)
+    {
+        return nullptr;
+    }
+
+    // The data is usually a read only mapping, the buffer overload of
+    // DecodeExif only reads it and the thumbnail points into it
+    Cexif exif;
+    if (!exif.DecodeExif(data, size) || exif.m_exifinfo->ThumbnailPointer == nullptr || exif.m_exifinfo->ThumbnailSize == 0)
+    {
+        return nullptr;
+    }
+
+    auto thumbnailEnd = exif.m_exifinfo->ThumbnailPointer + exif.m_exifinfo->ThumbnailSize;
+    if (exif.m_exifinfo->ThumbnailPointer < data || thumbnailEnd > data + size)
+    {
+        return nullptr;
+    }
+
+    int x, y, channels;
+    auto imageData = stbi_load_from_memory(exif.m_exifinfo->ThumbnailPointer, static_cast<int>(exif.m_exifinfo->ThumbnailSize), &x, &y, &channels, 4);
+    if (imageData == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto image = std::make_shared<DecodedImage>(x, y, imageData);
+
+    image->orientation = exif.m_exifinfo->Orientation != 0 ? exif.m_exifinfo->Orientation : 1;
+
+    if (exif.m_exifinfo->Width > 0 && exif.m_exifinfo->Height > 0)
+    {
+        image->originalWidth = exif.m_exifinfo->Width;
+        image->originalHeight = exif.m_exifinfo->Height;
+    }
+
+    return image;
+}
+
+// Box filter with a whole factor, every output pixel is the average of a
+// factor x factor block. Sharp enough because the texture is mipmapped and
+// the full resolution is decoded when the user zooms in.
+std::shared_ptr<DecodedImage> ImageDecoder::Downscale(
+    const DecodedImage &image,
+    int maxDimension)
+{
+    auto longest = std::max(image.Width(), image.Height());
+    auto factor = (longest + maxDimension - 1) / maxDimension;
+
+    // Blocks on the right and bottom edge are smaller, so a side shorter
+    // than factor still gets one pixel
+    auto width = (image.Width() + factor - 1) / factor;
+    auto height = (image.Height() + factor - 1) / factor;
+
+    auto pixels = static_cast<unsigned char *>(malloc(static_cast<size_t>(width) * height * 4));
+    if (pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    ImageKernels::BoxDownsample(
+        image.Pixels(),
+        static_cast<size_t>(image.Width()) * 4,
+        image.Width(),
+        image.Height(),
+        factor,
+        pixels,
+        static_cast<size_t>(width) * 4);
+
+    auto result = std::make_shared<DecodedImage>(width, height, pixels);
+
+    result->orientation = image.orientation;
+    result->originalWidth = image.originalWidth;
+    result->originalHeight = image.originalHeight;
+
+    return result;
+}
+
+int ImageDecoder::ReadOrientation(
+    const unsigned char *data,
+    size_t size)
+{
+    Cexif exif;
+    if (!exif.DecodeExif(data, size) || exif.m_exifinfo->Orientation == 0)
+    {
+        return 1;
+    }
+
+    return exif.m_exifinfo->Orientation;
+}
+
+bool ImageDecoder::IsSupported(
+    const std::filesystem::path &path)
+{
+    auto ext = path.extension().wstring();
+
+    std::transform(
+        ext.begin(),
+        ext.end(),
+        ext.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    if (ext == L".png") return true;
+    if (ext == L".jpg") return true;
+    if (ext == L".jpeg") return true;
+    if (ext == L".bmp") return true;
+    if (ext == L".gif") return true;
+    if (ext == L".tga") return true;
+    if (ext == L".pic") return true;
+    if (ext == L".ppm") return true;
+    if (ext == L".pgm") return true;
+
+    return false;
+}
+
+bool ImageDecoder::IsJpeg(
+    const std::filesystem::path &path)
+{
+    auto ext = path.extension().wstring();
+
+    std::transform(
+        ext.begin(),
+        ext.end(),
+        ext.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    return ext == L".jpg" || ext == L".jpeg";
+}
+
+float ImageDecoder::OrientationToRotation(
+    int orientation)
+{
+    auto degrees = 0.0f;
+
+    if (orientation == 8)
+    {
+        degrees = -90.0f;
+    }
+    else if (orientation == 3)
+    {
+        degrees = 180.0f;
+    }
+    else if (orientation == 6)
+    {
+        degrees = 90.0f;
+    }
+
+    return degrees * 4.0f * std::atan(1.0f) / 180.0f;
+}
@@ -0,0 +1,208 @@
+#include "imagedirectoryindex.h"
+#include "imagearchive.h"
+#include "imagedecoder.h"
+
+#include <algorithm>
+#include <cwctype>
+
+ImageDirectoryListing::ImageDirectoryListing(
+    const std::filesystem::path &directory,
+    std::filesystem::file_time_type modified,
+    std::vector<std::filesystem::path> images)
+    : _directory(directory),
+      _modified(modified),
+      _images(std::move(images))
+{
+    _indices.reserve(_images.size());
+
+    for (size_t i = 0; i < _images.size(); i++)
+    {
+        _indices[_images[i].native()] = i;
+    }
+}
+
+int ImageDirectoryListing::IndexOf(
+    const std::filesystem::path &path) const
+{
+    auto found = _indices.find(path.native());
+    if (found == _indices.end())
+    {
+        return -1;
+    }
+
+    return static_cast<int>(found->second);
+}
+
+ImageDirectoryIndex::ImageDirectoryIndex(
+    ExifIndex *exifIndex)
+    : _exifIndex(exifIndex)
+{}
+
+std::shared_ptr<const ImageDirectoryListing> ImageDirectoryIndex::Get(
+    const std::filesystem::path &directory,
+    ImageOrders order)
+{
+    auto byName = GetByName(directory);
+
+    // Archive members are not in the EXIF index
+    if (order == ImageOrders::Name || ImageArchive::IsArchive(directory))
+    {
+        return byName;
+    }
+
+    auto generation = _exifIndex->Generation();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _captureTimeListings.find(directory);
+        if (found != _captureTimeListings.end() && found->second.generation == generation && found->second.listing->Modified() == byName->Modified())
+        {
+            return found->second.listing;
+        }
+    }
+
+    std::vector<std::filesystem::path> images;
+    images.reserve(byName->Count());
+
+    for (size_t i = 0; i < byName->Count(); i++)
+    {
+        images.push_back(byName->At(i));
+    }
+
+    _exifIndex->SortByCaptureTime(images);
+
+    auto listing = std::make_shared<const ImageDirectoryListing>(directory, byName->Modified(), std::move(images));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _captureTimeListings[directory] = {generation, listing};
+
+    return listing;
+}
+
+std::shared_ptr<const ImageDirectoryListing> ImageDirectoryIndex::GetByName(
+    const std::filesystem::path &directory)
+{
+    std::error_code ec;
+    auto modified = std::filesystem::last_write_time(directory, ec);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _listings.find(directory);
+        if (found != _listings.end() && !ec && found->second->Modified() == modified)
+        {
+            return found->second;
+        }
+    }
+
+    std::vector<std::filesystem::path> images;
+
+    if (ImageArchive::IsArchive(directory) && std::filesystem::is_regular_file(directory, ec))
+    {
+        images = ImageArchive::Images(directory);
+
+        std::sort(images.begin(), images.end(), NaturalPathLess);
+    }
+    else
+    {
+        for (auto const &dir_entry : std::filesystem::directory_iterator{directory, ec})
+        {
+            if (ImageDecoder::IsSupported(dir_entry.path()))
+            {
+                images.push_back(dir_entry.path());
+            }
+        }
+
+        std::sort(images.begin(), images.end(), NaturalLess);
+
+        _exifIndex->Scan(directory);
+    }
+
+    auto listing = std::make_shared<const ImageDirectoryListing>(directory, modified, std::move(images));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _listings[directory] = listing;
+
+    return listing;
+}
+
+bool ImageDirectoryIndex::NaturalLess(
+    const std::filesystem::path &a,
+    const std::filesystem::path &b)
+{
+    auto left = a.filename().wstring();
+    auto right = b.filename().wstring();
+
+    size_t i = 0, j = 0;
+    while (i < left.size() && j < right.size())
+    {
+        if (std::iswdigit(left[i]) && std::iswdigit(right[j]))
+        {
+            auto numberStartLeft = i, numberStartRight = j;
+
+            while (numberStartLeft < left.size() - 1 && left[numberStartLeft] == L'0' && std::iswdigit(left[numberStartLeft + 1])) numberStartLeft++;
+            while (numberStartRight < right.size() - 1 && right[numberStartRight] == L'0' && std::iswdigit(right[numberStartRight + 1])) numberStartRight++;
+
+            i = numberStartLeft;
+            j = numberStartRight;
+            while (i < left.size() && std::iswdigit(left[i])) i++;
+            while (j < right.size() && std::iswdigit(right[j])) j++;
+
+            // Without leading zeros the longer number is the larger one
+            if (i - numberStartLeft != j - numberStartRight)
+            {
+                return i - numberStartLeft < j - numberStartRight;
+            }
+
+            auto compared = left.compare(numberStartLeft, i - numberStartLeft, right, numberStartRight, j - numberStartRight);
+            if (compared != 0)
+            {
+                return compared < 0;
+            }
+
+            continue;
+        }
+
+        auto l = std::towlower(left[i]);
+        auto r = std::towlower(right[j]);
+        if (l != r)
+        {
+            return l < r;
+        }
+
+        i++;
+        j++;
+    }
+
+    if (left.size() - i != right.size() - j)
+    {
+        return left.size() - i < right.size() - j;
+    }
+
+    return left < right;
+}
+
+bool ImageDirectoryIndex::NaturalPathLess(
+    const std::filesystem::path &a,
+    const std::filesystem::path &b)
+{
+    auto left = a.begin();
+    auto right = b.begin();
+
+    for (; left != a.end() && right != b.end(); ++left, ++right)
+    {
+        if (NaturalLess(*left, *right))
+        {
+            return true;
+        }
+        if (NaturalLess(*right, *left))
+        {
+            return false;
+        }
+    }
+
+    return left == a.end() && right != b.end();
+}
@@ -0,0 +1,778 @@
+#include "imagekernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define IMAGEKERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define IMAGEKERNELS_AVX2
+#else
+#include <cpuid.h>
+#define IMAGEKERNELS_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static KernelLevels DetectLevel()
+{
+#if defined(IMAGEKERNELS_X86)
+#if defined(_MSC_VER)
+    int info[4];
+
+    // AVX2 needs the processor and the OS, which has to save the ymm registers
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        auto hasOsSupport = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+
+        __cpuidex(info, 7, 0);
+        if (hasOsSupport && (info[1] & (1 << 5)) != 0)
+        {
+            return KernelLevels::Avx2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return KernelLevels::Avx2;
+    }
+#endif
+
+    return KernelLevels::Sse2;
+#else
+    return KernelLevels::Scalar;
+#endif
+}
+
+static KernelLevels &CurrentLevel()
+{
+    static KernelLevels level = DetectLevel();
+
+    return level;
+}
+
+KernelLevels ImageKernels::Level()
+{
+    return CurrentLevel();
+}
+
+void ImageKernels::SetLevel(
+    KernelLevels level)
+{
+    CurrentLevel() = std::min(level, DetectLevel());
+}
+
+static unsigned char *AllocatePixels(
+    int width,
+    int height)
+{
+    return static_cast<unsigned char *>(malloc(static_cast<size_t>(width) * height * 4));
+}
+
+// RGB to RGBA
+
+static void ExpandRgbToRgbaScalar(
+    const unsigned char *rgb,
+    unsigned char *rgba,
+    size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        rgba[i * 4] = rgb[i * 3];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+#if defined(IMAGEKERNELS_X86)
+// Eight pixels per step, two loads of 16 bytes of which 12 are used. The
+// last pixels are left to the scalar loop so no load reads past the end.
+IMAGEKERNELS_AVX2
+static void ExpandRgbToRgbaAvx2(
+    const unsigned char *rgb,
+    unsigned char *rgba,
+    size_t pixelCount)
+{
+    const auto shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const auto alpha = _mm256_set1_epi32(static_cast<int>(0xff000000));
+
+    size_t i = 0;
+    for (; i + 10 <= pixelCount; i += 8)
+    {
+        auto low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + i * 3));
+        auto high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + i * 3 + 12));
+        auto pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+
+        pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + i * 4), pixels);
+    }
+
+    ExpandRgbToRgbaScalar(rgb + i * 3, rgba + i * 4, pixelCount - i);
+}
+#endif
+
+// SSE2 has no byte shuffle, the scalar loop is what it would come down to
+void ImageKernels::ExpandRgbToRgba(
+    const unsigned char *rgb,
+    unsigned char *rgba,
+    size_t pixelCount)
+{
+#if defined(IMAGEKERNELS_X86)
+    if (Level() == KernelLevels::Avx2)
+    {
+        ExpandRgbToRgbaAvx2(rgb, rgba, pixelCount);
+
+        return;
+    }
+#endif
+
+    ExpandRgbToRgbaScalar(rgb, rgba, pixelCount);
+}
+
+// Box downsampling, in two steps per target row: the source rows of a block
+// are added up per byte, then the sums are added up per block of columns
+
+static void AccumulateRowScalar(
+    const unsigned char *line,
+    uint32_t *sums,
+    size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        sums[i] += line[i];
+    }
+}
+
+static void ReduceRowScalar(
+    const uint32_t *sums,
+    int width,
+    int factor,
+    int rows,
+    unsigned char *target)
+{
+    for (int x = 0; x * factor < width; x++)
+    {
+        auto columns = std::min(factor, width - x * factor);
+        auto scale = 1.0f / static_cast<float>(rows * columns);
+
+        uint32_t sum[4] = {0, 0, 0, 0};
+        for (int column = 0; column < columns; column++)
+        {
+            auto pixel = sums + static_cast<size_t>(x * factor + column) * 4;
+
+            sum[0] += pixel[0];
+            sum[1] += pixel[1];
+            sum[2] += pixel[2];
+            sum[3] += pixel[3];
+        }
+
+        for (int channel = 0; channel < 4; channel++)
+        {
+            target[x * 4 + channel] = static_cast<unsigned char>(static_cast<int>(static_cast<float>(sum[channel]) * scale + 0.5f));
+        }
+    }
+}
+
+#if defined(IMAGEKERNELS_X86)
+static void AccumulateRowSse2(
+    const unsigned char *line,
+    uint32_t *sums,
+    size_t count)
+{
+    const auto zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + i));
+        auto low = _mm_unpacklo_epi8(bytes, zero);
+        auto high = _mm_unpackhi_epi8(bytes, zero);
+
+        auto sum = reinterpret_cast<__m128i *>(sums + i);
+        _mm_storeu_si128(sum, _mm_add_epi32(_mm_loadu_si128(sum), _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128(sum + 1, _mm_add_epi32(_mm_loadu_si128(sum + 1), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128(sum + 2, _mm_add_epi32(_mm_loadu_si128(sum + 2), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128(sum + 3, _mm_add_epi32(_mm_loadu_si128(sum + 3), _mm_unpackhi_epi16(high, zero)));
+    }
+
+    AccumulateRowScalar(line + i, sums + i, count - i);
+}
+
+IMAGEKERNELS_AVX2
+static void AccumulateRowAvx2(
+    const unsigned char *line,
+    uint32_t *sums,
+    size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + i));
+
+        auto sum = reinterpret_cast<__m256i *>(sums + i);
+        _mm256_storeu_si256(sum, _mm256_add_epi32(_mm256_loadu_si256(sum), _mm256_cvtepu8_epi32(bytes)));
+        _mm256_storeu_si256(sum + 1, _mm256_add_epi32(_mm256_loadu_si256(sum + 1), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8))));
+    }
+
+    AccumulateRowScalar(line + i, sums + i, count - i);
+}
+
+// The four channels of a pixel fit one register, so a block is added up with
+// one add per column
+static void ReduceRowSse2(
+    const uint32_t *sums,
+    int width,
+    int factor,
+    int rows,
+    unsigned char *target)
+{
+    const auto half = _mm_set1_ps(0.5f);
+
+    for (int x = 0; x * factor < width; x++)
+    {
+        auto columns = std::min(factor, width - x * factor);
+        auto scale = _mm_set1_ps(1.0f / static_cast<float>(rows * columns));
+
+        auto sum = _mm_setzero_si128();
+        for (int column = 0; column < columns; column++)
+        {
+            sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + static_cast<size_t>(x * factor + column) * 4)));
+        }
+
+        auto average = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale), half));
+        average = _mm_packs_epi32(average, average);
+        average = _mm_packus_epi16(average, average);
+
+        auto pixel = _mm_cvtsi128_si32(average);
+        memcpy(target + x * 4, &pixel, 4);
+    }
+}
+#endif
+
+void ImageKernels::BoxDownsample(
+    const unsigned char *source,
+    size_t sourceStride,
+    int width,
+    int height,
+    int factor,
+    unsigned char *target,
+    size_t targetStride)
+{
+    auto level = Level();
+
+    auto accumulate = AccumulateRowScalar;
+    auto reduce = ReduceRowScalar;
+
+#if defined(IMAGEKERNELS_X86)
+    if (level == KernelLevels::Avx2)
+    {
+        accumulate = AccumulateRowAvx2;
+        reduce = ReduceRowSse2;
+    }
+    else if (level == KernelLevels::Sse2)
+    {
+        accumulate = AccumulateRowSse2;
+        reduce = ReduceRowSse2;
+    }
+#endif
+
+    auto count = static_cast<size_t>(width) * 4;
+    std::vector<uint32_t> sums(count);
+
+    for (int y = 0; y * factor < height; y++)
+    {
+        std::fill(sums.begin(), sums.end(), 0);
+
+        auto rows = std::min(factor, height - y * factor);
+        for (int row = 0; row < rows; row++)
+        {
+            accumulate(source + (static_cast<size_t>(y) * factor + row) * sourceStride, sums.data(), count);
+        }
+
+        reduce(sums.data(), width, factor, rows, target + static_cast<size_t>(y) * targetStride);
+    }
+}
+
+// Histograms
+
+static void HistogramScalar(
+    const unsigned char *rgba,
+    size_t pixelCount,
+    uint32_t *counts)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        counts[rgba[i * 4]]++;
+        counts[256 + rgba[i * 4 + 1]]++;
+        counts[512 + rgba[i * 4 + 2]]++;
+        counts[768 + rgba[i * 4 + 3]]++;
+    }
+}
+
+// The same at every level. There is no scatter to bin with, and counting
+// into several copies of the histograms to break the dependencies between
+// equal neighbours measured slower than this in imagekernels-bench.
+void ImageKernels::Histogram(
+    const unsigned char *rgba,
+    size_t pixelCount,
+    uint32_t *counts)
+{
+    HistogramScalar(rgba, pixelCount, counts);
+}
+
+// Lanczos resizing, separable: the rows are resized into floats first, then
+// the columns of that into the target
+
+struct Contributions
+{
+    int taps = 0;
+    std::vector<int> first;
+    std::vector<float> weights; // taps per target pixel, zero where the source ends
+};
+
+static float Lanczos3(
+    float x)
+{
+    if (x == 0.0f)
+    {
+        return 1.0f;
+    }
+
+    if (x <= -3.0f || x >= 3.0f)
+    {
+        return 0.0f;
+    }
+
+    const float pi = 3.14159265358979f;
+    auto px = pi * x;
+
+    return 3.0f * std::sin(px) * std::sin(px / 3.0f) / (px * px);
+}
+
+// When shrinking the filter is stretched over the source, so every source
+// pixel counts
+static Contributions ComputeContributions(
+    int sourceSize,
+    int targetSize)
+{
+    Contributions result;
+
+    auto scale = static_cast<float>(sourceSize) / static_cast<float>(targetSize);
+    auto stretch = std::max(scale, 1.0f);
+    auto support = 3.0f * stretch;
+
+    result.taps = static_cast<int>(std::ceil(support * 2.0f)) + 1;
+    result.first.resize(targetSize);
+    result.weights.assign(static_cast<size_t>(targetSize) * result.taps, 0.0f);
+
+    for (int i = 0; i < targetSize; i++)
+    {
+        auto center = (static_cast<float>(i) + 0.5f) * scale;
+        auto first = std::max(0, static_cast<int>(std::floor(center - support)));
+        auto last = std::min(sourceSize - 1, static_cast<int>(std::ceil(center + support)));
+        last = std::min(last, first + result.taps - 1);
+
+        auto weights = &result.weights[static_cast<size_t>(i) * result.taps];
+
+        float total = 0.0f;
+        for (int j = first; j <= last; j++)
+        {
+            weights[j - first] = Lanczos3((static_cast<float>(j) + 0.5f - center) / stretch);
+            total += weights[j - first];
+        }
+
+        if (total != 0.0f)
+        {
+            for (int j = 0; j <= last - first; j++)
+            {
+                weights[j] /= total;
+            }
+        }
+
+        result.first[i] = first;
+    }
+
+    return result;
+}
+
+static void ResizeRowScalar(
+    const unsigned char *line,
+    int sourceWidth,
+    const Contributions &contributions,
+    int targetWidth,
+    float *target)
+{
+    for (int x = 0; x < targetWidth; x++)
+    {
+        auto first = contributions.first[x];
+        auto weights = &contributions.weights[static_cast<size_t>(x) * contributions.taps];
+        auto taps = std::min(contributions.taps, sourceWidth - first);
+
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int tap = 0; tap < taps; tap++)
+        {
+            auto pixel = line + static_cast<size_t>(first + tap) * 4;
+
+            for (int channel = 0; channel < 4; channel++)
+            {
+                sum[channel] += weights[tap] * static_cast<float>(pixel[channel]);
+            }
+        }
+
+        memcpy(target + static_cast<size_t>(x) * 4, sum, sizeof(sum));
+    }
+}
+
+static void ResizeColumnsScalar(
+    const float *rows,
+    size_t rowStride,
+    const float *weights,
+    int taps,
+    size_t count,
+    unsigned char *target)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        float sum = 0.0f;
+        for (int tap = 0; tap < taps; tap++)
+        {
+            sum += weights[tap] * rows[tap * rowStride + i];
+        }
+
+        target[i] = static_cast<unsigned char>(static_cast<int>(std::min(std::max(sum, 0.0f), 255.0f) + 0.5f));
+    }
+}
+
+#if defined(IMAGEKERNELS_X86)
+static void ResizeRowSse2(
+    const unsigned char *line,
+    int sourceWidth,
+    const Contributions &contributions,
+    int targetWidth,
+    float *target)
+{
+    const auto zero = _mm_setzero_si128();
+
+    for (int x = 0; x < targetWidth; x++)
+    {
+        auto first = contributions.first[x];
+        auto weights = &contributions.weights[static_cast<size_t>(x) * contributions.taps];
+        auto taps = std::min(contributions.taps, sourceWidth - first);
+
+        auto sum = _mm_setzero_ps();
+        for (int tap = 0; tap < taps; tap++)
+        {
+            int32_t bytes;
+            memcpy(&bytes, line + static_cast<size_t>(first + tap) * 4, 4);
+
+            auto pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_cvtepi32_ps(pixel)));
+        }
+
+        _mm_storeu_ps(target + static_cast<size_t>(x) * 4, sum);
+    }
+}
+
+static void ResizeColumnsSse2(
+    const float *rows,
+    size_t rowStride,
+    const float *weights,
+    int taps,
+    size_t count,
+    unsigned char *target)
+{
+    const auto low = _mm_setzero_ps();
+    const auto high = _mm_set1_ps(255.0f);
+    const auto half = _mm_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        auto sum = _mm_setzero_ps();
+        for (int tap = 0; tap < taps; tap++)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(rows + tap * rowStride + i)));
+        }
+
+        auto value = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(sum, low), high), half));
+        value = _mm_packs_epi32(value, value);
+        value = _mm_packus_epi16(value, value);
+
+        auto pixel = _mm_cvtsi128_si32(value);
+        memcpy(target + i, &pixel, 4);
+    }
+
+    ResizeColumnsScalar(rows + i, rowStride, weights, taps, count - i, target + i);
+}
+
+IMAGEKERNELS_AVX2
+static void ResizeColumnsAvx2(
+    const float *rows,
+    size_t rowStride,
+    const float *weights,
+    int taps,
+    size_t count,
+    unsigned char *target)
+{
+    const auto low = _mm256_setzero_ps();
+    const auto high = _mm256_set1_ps(255.0f);
+    const auto half = _mm256_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        auto sum = _mm256_setzero_ps();
+        for (int tap = 0; tap < taps; tap++)
+        {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[tap]), _mm256_loadu_ps(rows + tap * rowStride + i)));
+        }
+
+        auto value = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(sum, low), high), half));
+        auto packed = _mm_packs_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+        packed = _mm_packus_epi16(packed, packed);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(target + i), packed);
+    }
+
+    ResizeColumnsScalar(rows + i, rowStride, weights, taps, count - i, target + i);
+}
+#endif
+
+std::shared_ptr<DecodedImage> ImageKernels::LanczosResize(
+    const DecodedImage &image,
+    int width,
+    int height)
+{
+    width = std::max(1, width);
+    height = std::max(1, height);
+
+    auto pixels = AllocatePixels(width, height);
+    if (pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto level = Level();
+
+    auto resizeRow = ResizeRowScalar;
+    auto resizeColumns = ResizeColumnsScalar;
+
+#if defined(IMAGEKERNELS_X86)
+    if (level == KernelLevels::Avx2)
+    {
+        resizeRow = ResizeRowSse2;
+        resizeColumns = ResizeColumnsAvx2;
+    }
+    else if (level == KernelLevels::Sse2)
+    {
+        resizeRow = ResizeRowSse2;
+        resizeColumns = ResizeColumnsSse2;
+    }
+#endif
+
+    auto horizontal = ComputeContributions(image.Width(), width);
+    auto vertical = ComputeContributions(image.Height(), height);
+
+    auto rowStride = static_cast<size_t>(width) * 4;
+    std::vector<float> rows(rowStride * image.Height());
+
+    for (int y = 0; y < image.Height(); y++)
+    {
+        resizeRow(
+            image.Pixels() + static_cast<size_t>(y) * image.Width() * 4,
+            image.Width(),
+            horizontal,
+            width,
+            &rows[y * rowStride]);
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        auto first = vertical.first[y];
+
+        resizeColumns(
+            &rows[first * rowStride],
+            rowStride,
+            &vertical.weights[static_cast<size_t>(y) * vertical.taps],
+            std::min(vertical.taps, image.Height() - first),
+            rowStride,
+            pixels + static_cast<size_t>(y) * rowStride);
+    }
+
+    auto result = std::make_shared<DecodedImage>(width, height, pixels);
+
+    result->orientation = image.orientation;
+    result->originalWidth = image.originalWidth;
+    result->originalHeight = image.originalHeight;
+
+    return result;
+}
+
+// Orientation. Orientations 5 to 8 are a transpose followed by mirroring,
+// the others only mirror. Moving pixels is bound by memory, so the vector
+// version is SSE2 on both levels.
+
+static void Transpose(
+    const uint32_t *source,
+    int width,
+    int height,
+    bool mirrorX,
+    bool mirrorY,
+    uint32_t *target,
+    bool isVectorized)
+{
+    auto blockRows = 0;
+
+#if defined(IMAGEKERNELS_X86)
+    if (isVectorized)
+    {
+        // 4x4 blocks, the pixels of a block go from four source rows to four
+        // target rows in registers
+        blockRows = width / 4 * 4;
+        auto blockColumns = height / 4 * 4;
+
+        for (int y = 0; y < blockRows; y += 4)
+        {
+            for (int x = 0; x < blockColumns; x += 4)
+            {
+                auto r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + static_cast<size_t>(x) * width + y));
+                auto r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + static_cast<size_t>(x + 1) * width + y));
+                auto r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + static_cast<size_t>(x + 2) * width + y));
+                auto r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + static_cast<size_t>(x + 3) * width + y));
+
+                auto t0 = _mm_unpacklo_epi32(r0, r1);
+                auto t1 = _mm_unpacklo_epi32(r2, r3);
+                auto t2 = _mm_unpackhi_epi32(r0, r1);
+                auto t3 = _mm_unpackhi_epi32(r2, r3);
+
+                __m128i columns[4] = {
+                    _mm_unpacklo_epi64(t0, t1),
+                    _mm_unpackhi_epi64(t0, t1),
+                    _mm_unpacklo_epi64(t2, t3),
+                    _mm_unpackhi_epi64(t2, t3),
+                };
+
+                auto targetX = mirrorX ? height - 4 - x : x;
+
+                for (int i = 0; i < 4; i++)
+                {
+                    auto targetY = mirrorY ? width - 1 - (y + i) : y + i;
+                    auto value = mirrorX ? _mm_shuffle_epi32(columns[i], _MM_SHUFFLE(0, 1, 2, 3)) : columns[i];
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(target + static_cast<size_t>(targetY) * height + targetX), value);
+                }
+            }
+
+            // The columns the blocks did not reach
+            for (int i = y; i < y + 4; i++)
+            {
+                auto targetRow = target + static_cast<size_t>(mirrorY ? width - 1 - i : i) * height;
+
+                for (int x = blockColumns; x < height; x++)
+                {
+                    targetRow[mirrorX ? height - 1 - x : x] = source[static_cast<size_t>(x) * width + i];
+                }
+            }
+        }
+    }
+#endif
+
+    for (int y = blockRows; y < width; y++)
+    {
+        auto targetRow = target + static_cast<size_t>(mirrorY ? width - 1 - y : y) * height;
+
+        for (int x = 0; x < height; x++)
+        {
+            targetRow[mirrorX ? height - 1 - x : x] = source[static_cast<size_t>(x) * width + y];
+        }
+    }
+}
+
+static void MirrorRow(
+    const uint32_t *source,
+    int width,
+    uint32_t *target,
+    bool isVectorized)
+{
+    int x = 0;
+
+#if defined(IMAGEKERNELS_X86)
+    if (isVectorized)
+    {
+        for (; x + 4 <= width; x += 4)
+        {
+            auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + width - 4 - x));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target + x), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3)));
+        }
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        target[x] = source[width - 1 - x];
+    }
+}
+
+std::shared_ptr<DecodedImage> ImageKernels::Orient(
+    const DecodedImage &image,
+    int orientation)
+{
+    auto isTransposed = orientation >= 5 && orientation <= 8;
+    auto width = isTransposed ? image.Height() : image.Width();
+    auto height = isTransposed ? image.Width() : image.Height();
+
+    auto pixels = AllocatePixels(width, height);
+    if (pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto isVectorized = Level() != KernelLevels::Scalar;
+    auto source = reinterpret_cast<const uint32_t *>(image.Pixels());
+    auto target = reinterpret_cast<uint32_t *>(pixels);
+
+    auto mirrorX = orientation == 2 || orientation == 3 || orientation == 6 || orientation == 7;
+    auto mirrorY = orientation == 3 || orientation == 4 || orientation == 7 || orientation == 8;
+
+    if (isTransposed)
+    {
+        Transpose(source, image.Width(), image.Height(), mirrorX, mirrorY, target, isVectorized);
+    }
+    else
+    {
+        for (int y = 0; y < height; y++)
+        {
+            auto sourceRow = source + static_cast<size_t>(mirrorY ? height - 1 - y : y) * width;
+            auto targetRow = target + static_cast<size_t>(y) * width;
+
+            if (mirrorX)
+            {
+                MirrorRow(sourceRow, width, targetRow, isVectorized);
+            }
+            else
+            {
+                memcpy(targetRow, sourceRow, static_cast<size_t>(width) * 4);
+            }
+        }
+    }
+
+    auto result = std::make_shared<DecodedImage>(width, height, pixels);
+
+    result->originalWidth = isTransposed ? image.originalHeight : image.originalWidth;
+    result->originalHeight = isTransposed ? image.originalWidth : image.originalHeight;
+
+    return result;
+}
@@ -0,0 +1,302 @@
+#include "lineindex.h"
+#include "imagekernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define LINEINDEX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define LINEINDEX_AVX2
+#else
+#define LINEINDEX_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+LineIndex::LineIndex(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler)
+{
+    _starts.assign(1, 0);
+}
+
+LineIndex::~LineIndex()
+{
+    Close();
+}
+
+void LineIndex::Open(
+    std::shared_ptr<MappedFile> file)
+{
+    Close();
+
+    _data = reinterpret_cast<const char *>(file->Data());
+    _size = _data != nullptr ? file->Size() : 0;
+
+    _chunkQueue = std::make_shared<ChunkQueue>();
+    _chunkQueue->file = file;
+
+    for (size_t begin = 0; begin < _size;)
+    {
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = begin + std::min(_size - begin, static_cast<size_t>(begin == 0 ? LINE_INDEX_FIRST_CHUNK_SIZE : LINE_INDEX_CHUNK_SIZE));
+
+        _chunkQueue->chunks.push_back(std::move(chunk));
+
+        begin = _chunkQueue->chunks.back().end;
+    }
+
+    // Enqueued in file order, the chunks mostly finish in that order too
+    for (size_t i = 0; i < _chunkQueue->chunks.size(); i++)
+    {
+        _workerPool->Enqueue([chunkQueue = _chunkQueue, i, frameScheduler = _frameScheduler]() {
+            IndexChunk(chunkQueue, i, frameScheduler);
+        });
+    }
+}
+
+void LineIndex::Close()
+{
+    if (_chunkQueue != nullptr)
+    {
+        _chunkQueue->isCancelled = true;
+        _chunkQueue = nullptr;
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _indexedBytes = 0;
+    _nextChunk = 0;
+    _doneBytes = 0;
+    _doneLines = 0;
+    _starts.assign(1, 0);
+}
+
+void LineIndex::Update()
+{
+    if (_chunkQueue == nullptr || IsComplete())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_chunkQueue->mutex);
+
+    auto &chunks = _chunkQueue->chunks;
+    while (_nextChunk < chunks.size() && chunks[_nextChunk].isDone)
+    {
+        auto &chunk = chunks[_nextChunk];
+
+        _starts.insert(_starts.end(), chunk.starts.begin(), chunk.starts.end());
+        _indexedBytes = chunk.end;
+
+        chunk.starts = std::vector<size_t>();
+        _nextChunk++;
+    }
+
+    _doneBytes = _chunkQueue->doneBytes;
+    _doneLines = _chunkQueue->doneLines;
+}
+
+size_t LineIndex::EstimatedLineCount() const
+{
+    if (IsComplete() || _doneBytes == 0)
+    {
+        return _starts.size();
+    }
+
+    auto estimate = 1.0 + static_cast<double>(_doneLines) * _size / _doneBytes;
+
+    return std::max(_starts.size(), static_cast<size_t>(estimate));
+}
+
+size_t LineIndex::LineEnd(
+    size_t line) const
+{
+    auto end = line + 1 < _starts.size() ? _starts[line + 1] - 1 : _indexedBytes;
+
+    if (end > _starts[line] && _data[end - 1] == '\r')
+    {
+        end--;
+    }
+
+    return end;
+}
+
+size_t LineIndex::LineOf(
+    size_t offset) const
+{
+    auto found = std::upper_bound(_starts.begin(), _starts.end(), offset);
+
+    return static_cast<size_t>(found - _starts.begin()) - 1;
+}
+
+void LineIndex::IndexChunk(
+    std::shared_ptr<ChunkQueue> chunkQueue,
+    size_t index,
+    FrameScheduler *frameScheduler)
+{
+    if (chunkQueue->isCancelled)
+    {
+        return;
+    }
+
+    size_t begin, end;
+    {
+        std::lock_guard<std::mutex> lock(chunkQueue->mutex);
+
+        begin = chunkQueue->chunks[index].begin;
+        end = chunkQueue->chunks[index].end;
+    }
+
+    // Roughly one line per 64 bytes, to save most of the reallocations
+    std::vector<size_t> starts;
+    starts.reserve((end - begin) / 64);
+
+    FindLineStarts(reinterpret_cast<const char *>(chunkQueue->file->Data()), begin, end, starts);
+
+    {
+        std::lock_guard<std::mutex> lock(chunkQueue->mutex);
+
+        auto &chunk = chunkQueue->chunks[index];
+
+        chunkQueue->doneBytes += end - begin;
+        chunkQueue->doneLines += starts.size();
+
+        chunk.starts = std::move(starts);
+        chunk.isDone = true;
+    }
+
+    frameScheduler->RequestFrame();
+}
+
+// Line breaks
+
+static void FindLineStartsScalar(
+    const char *data,
+    size_t begin,
+    size_t end,
+    std::vector<size_t> &starts)
+{
+    auto position = data + begin;
+    while (position < data + end)
+    {
+        auto newline = static_cast<const char *>(memchr(position, '\n', (data + end) - position));
+        if (newline == nullptr)
+        {
+            break;
+        }
+
+        starts.push_back(static_cast<size_t>(newline - data) + 1);
+        position = newline + 1;
+    }
+}
+
+#if defined(LINEINDEX_X86)
+static int LowestBit(
+    uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// One bit per byte of a 64 byte block, set where it is a '\n'
+static void AddLineStarts(
+    uint64_t mask,
+    size_t offset,
+    std::vector<size_t> &starts)
+{
+    while (mask != 0)
+    {
+        starts.push_back(offset + LowestBit(mask) + 1);
+        mask &= mask - 1;
+    }
+}
+
+static void FindLineStartsSse2(
+    const char *data,
+    size_t begin,
+    size_t end,
+    std::vector<size_t> &starts)
+{
+    const auto newline = _mm_set1_epi8('\n');
+
+    auto i = begin;
+    for (; i + 64 <= end; i += 64)
+    {
+        uint64_t mask = 0;
+        for (int part = 0; part < 4; part++)
+        {
+            auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + part * 16));
+            auto bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+
+            mask |= static_cast<uint64_t>(bits) << (part * 16);
+        }
+
+        AddLineStarts(mask, i, starts);
+    }
+
+    FindLineStartsScalar(data, i, end, starts);
+}
+
+LINEINDEX_AVX2
+static void FindLineStartsAvx2(
+    const char *data,
+    size_t begin,
+    size_t end,
+    std::vector<size_t> &starts)
+{
+    const auto newline = _mm256_set1_epi8('\n');
+
+    auto i = begin;
+    for (; i + 64 <= end; i += 64)
+    {
+        auto low = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), newline);
+        auto high = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 32)), newline);
+
+        auto mask = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(low))) |
+                    (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32);
+
+        AddLineStarts(mask, i, starts);
+    }
+
+    FindLineStartsScalar(data, i, end, starts);
+}
+#endif
+
+// Dispatched on the level the image kernels detected
+void LineIndex::FindLineStarts(
+    const char *data,
+    size_t begin,
+    size_t end,
+    std::vector<size_t> &starts)
+{
+#if defined(LINEINDEX_X86)
+    auto level = ImageKernels::Level();
+    if (level == KernelLevels::Avx2)
+    {
+        FindLineStartsAvx2(data, begin, end, starts);
+
+        return;
+    }
+    if (level == KernelLevels::Sse2)
+    {
+        FindLineStartsSse2(data, begin, end, starts);
+
+        return;
+    }
+#endif
+
+    FindLineStartsScalar(data, begin, end, starts);
+}
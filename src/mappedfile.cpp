@@ -0,0 +1,157 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() = default;
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(
+    const std::filesystem::path &path)
+{
+    Close();
+
+    auto file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+
+        return false;
+    }
+
+    _fileHandle = file;
+    _size = static_cast<size_t>(size.QuadPart);
+    _isOpen = true;
+
+    // Empty files cannot be mapped, they are open with no data
+    if (_size == 0)
+    {
+        return true;
+    }
+
+    _mappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mappingHandle == nullptr)
+    {
+        Close();
+
+        return false;
+    }
+
+    _data = static_cast<const unsigned char *>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (_data == nullptr)
+    {
+        Close();
+
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data != nullptr)
+    {
+        UnmapViewOfFile(_data);
+        _data = nullptr;
+    }
+
+    if (_mappingHandle != nullptr)
+    {
+        CloseHandle(_mappingHandle);
+        _mappingHandle = nullptr;
+    }
+
+    if (_fileHandle != nullptr)
+    {
+        CloseHandle(_fileHandle);
+        _fileHandle = nullptr;
+    }
+
+    _size = 0;
+    _isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(
+    const std::filesystem::path &path)
+{
+    Close();
+
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+
+        return false;
+    }
+
+    _fileDescriptor = fd;
+    _size = static_cast<size_t>(info.st_size);
+    _isOpen = true;
+
+    // Empty files cannot be mapped, they are open with no data
+    if (_size == 0)
+    {
+        return true;
+    }
+
+    auto data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        Close();
+
+        return false;
+    }
+
+    madvise(data, _size, MADV_SEQUENTIAL);
+
+    _data = static_cast<const unsigned char *>(data);
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data != nullptr)
+    {
+        munmap(const_cast<unsigned char *>(_data), _size);
+        _data = nullptr;
+    }
+
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+        _fileDescriptor = -1;
+    }
+
+    _size = 0;
+    _isOpen = false;
+}
+
+#endif
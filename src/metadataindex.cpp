@@ -0,0 +1,252 @@
+#include "metadataindex.h"
+
+#include <fmt/format.h>
+#include <iostream>
+
+static void PrefixRange(
+    const std::filesystem::path &root,
+    std::string &from,
+    std::string &to)
+{
+    auto rootBytes = root.u8string();
+
+    if (rootBytes.empty() || rootBytes.back() != static_cast<char>(std::filesystem::path::preferred_separator))
+    {
+        rootBytes += static_cast<char>(std::filesystem::path::preferred_separator);
+    }
+
+    // Every path below root sorts between "root/" and "root0", the character
+    // that follows the separator
+    from = rootBytes;
+    to = rootBytes;
+    to.back() = static_cast<char>(to.back() + 1);
+}
+
+static const char *CompareOperatorSql(
+    CompareOperators op)
+{
+    switch (op)
+    {
+        case CompareOperators::Less:
+            return "<";
+        case CompareOperators::LessOrEqual:
+            return "<=";
+        case CompareOperators::GreaterOrEqual:
+            return ">=";
+        case CompareOperators::Greater:
+            return ">";
+        default:
+            return "=";
+    }
+}
+
+MetadataIndex::MetadataIndex() = default;
+
+MetadataIndex::~MetadataIndex() = default;
+
+bool MetadataIndex::Open(
+    const std::filesystem::path &databaseFile)
+{
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    _db = std::make_unique<sqlitelib::Sqlite>(databaseFile.string().c_str());
+
+    if (!_db->is_open())
+    {
+        _db = nullptr;
+
+        return false;
+    }
+
+    EnsureTables();
+
+    return true;
+}
+
+void MetadataIndex::EnsureTables()
+{
+    auto queries = {
+        R"(CREATE TABLE IF NOT EXISTS IndexedRoots (
+        path TEXT PRIMARY KEY,
+        indexed_at REAL NOT NULL
+    );)",
+        R"(CREATE TABLE IF NOT EXISTS Files (
+        path TEXT PRIMARY KEY,
+        type INTEGER NOT NULL,
+        size REAL NOT NULL,
+        modified REAL NOT NULL,
+        owner TEXT NOT NULL
+    );)",
+        R"(CREATE INDEX IF NOT EXISTS FilesBySize ON Files (size);)",
+        R"(CREATE INDEX IF NOT EXISTS FilesByModified ON Files (modified);)",
+    };
+
+    for (auto query : queries)
+    {
+        try
+        {
+            _db->execute(query, -1);
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << _db->errmsg() << std::endl;
+        }
+    }
+}
+
+std::filesystem::path MetadataIndex::FindIndexedRoot(
+    const std::filesystem::path &path,
+    int64_t &indexedAt)
+{
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    if (_db == nullptr)
+    {
+        return std::filesystem::path();
+    }
+
+    auto pathBytes = path.u8string();
+
+    try
+    {
+        auto rows = _db->prepare<std::string, double>("SELECT r.path, r.indexed_at FROM IndexedRoots r", -1)
+                        .execute();
+
+        for (const auto &row : rows)
+        {
+            std::string from, to;
+            auto &root = std::get<0>(row);
+            PrefixRange(std::filesystem::u8path(root), from, to);
+
+            if (pathBytes == root || (pathBytes >= from && pathBytes < to))
+            {
+                indexedAt = static_cast<int64_t>(std::get<1>(row));
+
+                return std::filesystem::u8path(root);
+            }
+        }
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+    }
+
+    return std::filesystem::path();
+}
+
+void MetadataIndex::Replace(
+    const std::filesystem::path &root,
+    const std::vector<FileMetadata> &entries,
+    int64_t indexedAt)
+{
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    if (_db == nullptr)
+    {
+        return;
+    }
+
+    std::string from, to;
+    PrefixRange(root, from, to);
+
+    try
+    {
+        _db->execute("BEGIN TRANSACTION", -1);
+
+        // Roots below this root are covered by it from now on
+        _db->execute("DELETE FROM IndexedRoots WHERE path = ? OR (path >= ? AND path < ?)", -1, root.u8string(), from, to);
+        _db->execute("DELETE FROM Files WHERE path >= ? AND path < ?", -1, from, to);
+
+        auto insert = _db->prepare("INSERT OR REPLACE INTO Files (path, type, size, modified, owner) VALUES (?, ?, ?, ?, ?)", -1);
+
+        for (const auto &entry : entries)
+        {
+            insert.execute(
+                entry.path.u8string(),
+                static_cast<int>(entry.type),
+                static_cast<double>(entry.size),
+                static_cast<double>(entry.modified),
+                entry.owner);
+        }
+
+        _db->execute("INSERT INTO IndexedRoots (path, indexed_at) VALUES (?, ?)", -1, root.u8string(), static_cast<double>(indexedAt));
+
+        _db->execute("COMMIT", -1);
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+
+        try
+        {
+            _db->execute("ROLLBACK", -1);
+        }
+        catch (std::exception &)
+        {
+        }
+    }
+}
+
+size_t MetadataIndex::Query(
+    const std::filesystem::path &path,
+    const MetadataQuery &query,
+    int64_t now,
+    const std::function<void(const FileMetadata &)> &onMatch)
+{
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    if (_db == nullptr)
+    {
+        return 0;
+    }
+
+    std::string from, to;
+    PrefixRange(path, from, to);
+
+    // Size and time ranges are left to sqlite so they can use the indices,
+    // names, types and owners are checked by the query itself
+    auto sql = std::string("SELECT f.path, f.type, f.size, f.modified, f.owner FROM Files f WHERE f.path >= ? AND f.path < ?");
+
+    for (const auto &predicate : query.SizePredicates())
+    {
+        sql += fmt::format(" AND f.size {} {}", CompareOperatorSql(predicate.op), predicate.value);
+    }
+
+    for (const auto &predicate : query.ModifiedPredicatesAt(now))
+    {
+        sql += fmt::format(" AND f.modified {} {}", CompareOperatorSql(predicate.op), predicate.value);
+    }
+
+    sql += " ORDER BY f.path";
+
+    size_t considered = 0;
+
+    try
+    {
+        auto statement = _db->prepare<std::string, int, double, double, std::string>(sql.c_str(), static_cast<int>(sql.size()));
+
+        for (const auto &row : statement.execute_cursor(from, to))
+        {
+            FileMetadata metadata;
+
+            metadata.path = std::filesystem::u8path(std::get<0>(row));
+            metadata.type = static_cast<FileTypes>(std::get<1>(row));
+            metadata.size = static_cast<uint64_t>(std::get<2>(row));
+            metadata.modified = static_cast<int64_t>(std::get<3>(row));
+            metadata.owner = std::get<4>(row);
+
+            considered++;
+
+            if (query.Matches(metadata, now))
+            {
+                onMatch(metadata);
+            }
+        }
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+    }
+
+    return considered;
+}
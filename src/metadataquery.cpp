@@ -0,0 +1,443 @@
+#include "metadataquery.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fmt/format.h>
+#include <sstream>
+
+static std::string ToLower(
+    std::string text)
+{
+    std::transform(
+        text.begin(),
+        text.end(),
+        text.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    return text;
+}
+
+static std::vector<std::string> SplitList(
+    const std::string &text)
+{
+    std::vector<std::string> result;
+    std::istringstream values(text);
+    std::string value;
+
+    while (getline(values, value, ','))
+    {
+        if (!value.empty())
+        {
+            result.push_back(value);
+        }
+    }
+
+    return result;
+}
+
+static bool ParseOperator(
+    const std::string &text,
+    size_t &pos,
+    CompareOperators &op)
+{
+    if (text.compare(pos, 2, ">=") == 0) op = CompareOperators::GreaterOrEqual, pos += 2;
+    else if (text.compare(pos, 2, "<=") == 0) op = CompareOperators::LessOrEqual, pos += 2;
+    else if (text.compare(pos, 1, ">") == 0) op = CompareOperators::Greater, pos += 1;
+    else if (text.compare(pos, 1, "<") == 0) op = CompareOperators::Less, pos += 1;
+    else if (text.compare(pos, 1, "=") == 0 || text.compare(pos, 1, ":") == 0) op = CompareOperators::Equal, pos += 1;
+    else return false;
+
+    return true;
+}
+
+static bool ParseSize(
+    const std::string &text,
+    int64_t &result)
+{
+    char *end = nullptr;
+    auto number = strtod(text.c_str(), &end);
+    if (end == text.c_str())
+    {
+        return false;
+    }
+
+    auto unit = ToLower(end);
+    double multiplier = 1;
+
+    if (unit == "" || unit == "b") multiplier = 1;
+    else if (unit == "k" || unit == "kb") multiplier = 1024.0;
+    else if (unit == "m" || unit == "mb") multiplier = 1024.0 * 1024.0;
+    else if (unit == "g" || unit == "gb") multiplier = 1024.0 * 1024.0 * 1024.0;
+    else if (unit == "t" || unit == "tb") multiplier = 1024.0 * 1024.0 * 1024.0 * 1024.0;
+    else return false;
+
+    result = static_cast<int64_t>(number * multiplier);
+
+    return true;
+}
+
+static bool ParseDuration(
+    const std::string &text,
+    int64_t &result)
+{
+    char *end = nullptr;
+    auto number = strtod(text.c_str(), &end);
+    if (end == text.c_str())
+    {
+        return false;
+    }
+
+    auto unit = ToLower(end);
+    double seconds = 0;
+
+    if (unit == "s") seconds = 1;
+    else if (unit == "m") seconds = 60;
+    else if (unit == "h") seconds = 60 * 60;
+    else if (unit == "d") seconds = 24 * 60 * 60;
+    else if (unit == "w") seconds = 7 * 24 * 60 * 60;
+    else if (unit == "y") seconds = 365 * 24 * 60 * 60;
+    else return false;
+
+    result = static_cast<int64_t>(number * seconds);
+
+    return true;
+}
+
+static bool ParseDate(
+    const std::string &text,
+    int64_t &result)
+{
+    std::tm date = {};
+    int hour = 0, minute = 0;
+
+    auto parsed = sscanf(text.c_str(), "%d-%d-%d%*[T ]%d:%d", &date.tm_year, &date.tm_mon, &date.tm_mday, &hour, &minute);
+    if (parsed < 3)
+    {
+        return false;
+    }
+
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    date.tm_hour = hour;
+    date.tm_min = minute;
+    date.tm_isdst = -1;
+
+    auto time = mktime(&date);
+    if (time == -1)
+    {
+        return false;
+    }
+
+    result = static_cast<int64_t>(time);
+
+    return true;
+}
+
+bool NumericPredicate::Matches(
+    int64_t actual) const
+{
+    switch (op)
+    {
+        case CompareOperators::Less:
+            return actual < value;
+        case CompareOperators::LessOrEqual:
+            return actual <= value;
+        case CompareOperators::Equal:
+            return actual == value;
+        case CompareOperators::GreaterOrEqual:
+            return actual >= value;
+        case CompareOperators::Greater:
+            return actual > value;
+    }
+
+    return false;
+}
+
+bool MetadataQuery::Parse(
+    const std::string &text)
+{
+    _error.clear();
+    _nameGlobs.clear();
+    _types.clear();
+    _owners.clear();
+    _size.clear();
+    _modified.clear();
+    _age.clear();
+
+    std::istringstream terms(text);
+    std::string term;
+
+    while (terms >> term)
+    {
+        if (!ParseTerm(term))
+        {
+            if (_error.empty())
+            {
+                _error = fmt::format("Could not understand \"{}\"", term);
+            }
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MetadataQuery::ParseTerm(
+    const std::string &term)
+{
+    auto keyEnd = term.find_first_of(":<>=");
+    if (keyEnd == std::string::npos)
+    {
+        // More name terms add globs, a name matches any of them
+        auto globs = SplitList(term);
+        _nameGlobs.insert(_nameGlobs.end(), globs.begin(), globs.end());
+
+        return true;
+    }
+
+    auto key = ToLower(term.substr(0, keyEnd));
+    size_t pos = keyEnd;
+    CompareOperators op;
+
+    if (!ParseOperator(term, pos, op))
+    {
+        return false;
+    }
+
+    auto value = term.substr(pos);
+
+    if (key == "name")
+    {
+        auto globs = SplitList(value);
+        _nameGlobs.insert(_nameGlobs.end(), globs.begin(), globs.end());
+
+        return op == CompareOperators::Equal;
+    }
+
+    if (key == "type")
+    {
+        for (const auto &type : SplitList(ToLower(value)))
+        {
+            if (type == "file" || type == "f") _types.push_back(FileTypes::File);
+            else if (type == "dir" || type == "directory" || type == "d") _types.push_back(FileTypes::Directory);
+            else if (type == "link" || type == "symlink" || type == "l") _types.push_back(FileTypes::Symlink);
+            else if (type == "other") _types.push_back(FileTypes::Other);
+            else
+            {
+                _error = fmt::format("Unknown type \"{}\", use file, dir, link or other", type);
+
+                return false;
+            }
+        }
+
+        return op == CompareOperators::Equal;
+    }
+
+    if (key == "owner")
+    {
+        auto owners = SplitList(value);
+        _owners.insert(_owners.end(), owners.begin(), owners.end());
+
+        return op == CompareOperators::Equal;
+    }
+
+    NumericPredicate predicate = {op, 0};
+
+    if (key == "size")
+    {
+        if (!ParseSize(value, predicate.value))
+        {
+            _error = fmt::format("\"{}\" is not a size, use for example 100, 10k, 1.5M or 2G", value);
+
+            return false;
+        }
+
+        _size.push_back(predicate);
+
+        return true;
+    }
+
+    if (key == "age")
+    {
+        if (!ParseDuration(value, predicate.value))
+        {
+            _error = fmt::format("\"{}\" is not a duration, use for example 30m, 12h, 7d, 2w or 1y", value);
+
+            return false;
+        }
+
+        _age.push_back(predicate);
+
+        return true;
+    }
+
+    if (key == "mtime" || key == "modified")
+    {
+        if (!ParseDate(value, predicate.value))
+        {
+            _error = fmt::format("\"{}\" is not a date, use YYYY-MM-DD or YYYY-MM-DDTHH:MM", value);
+
+            return false;
+        }
+
+        _modified.push_back(predicate);
+
+        return true;
+    }
+
+    _error = fmt::format("Unknown key \"{}\", use name, type, owner, size, age or mtime", key);
+
+    return false;
+}
+
+int MetadataQuery::NeededFields() const
+{
+    int fields = MetadataFieldNone;
+
+    if (!_size.empty()) fields |= MetadataFieldSize;
+    if (!_modified.empty() || !_age.empty()) fields |= MetadataFieldModified;
+    if (!_owners.empty()) fields |= MetadataFieldOwner;
+
+    return fields;
+}
+
+std::vector<NumericPredicate> MetadataQuery::ModifiedPredicatesAt(
+    int64_t now) const
+{
+    auto result = _modified;
+
+    // age < x means modified > now - x, so the comparison flips
+    for (const auto &age : _age)
+    {
+        NumericPredicate predicate = {age.op, now - age.value};
+
+        switch (age.op)
+        {
+            case CompareOperators::Less:
+                predicate.op = CompareOperators::Greater;
+                break;
+            case CompareOperators::LessOrEqual:
+                predicate.op = CompareOperators::GreaterOrEqual;
+                break;
+            case CompareOperators::GreaterOrEqual:
+                predicate.op = CompareOperators::LessOrEqual;
+                break;
+            case CompareOperators::Greater:
+                predicate.op = CompareOperators::Less;
+                break;
+            default:
+                break;
+        }
+
+        result.push_back(predicate);
+    }
+
+    return result;
+}
+
+bool MetadataQuery::Matches(
+    const FileMetadata &metadata,
+    int64_t now) const
+{
+    if (!_types.empty() && std::find(_types.begin(), _types.end(), metadata.type) == _types.end())
+    {
+        return false;
+    }
+
+    if (!_nameGlobs.empty())
+    {
+        auto name = metadata.path.filename().u8string();
+        auto found = std::any_of(_nameGlobs.begin(), _nameGlobs.end(), [&](const std::string &glob) {
+            return GlobMatches(glob, name);
+        });
+
+        if (!found)
+        {
+            return false;
+        }
+    }
+
+    for (const auto &predicate : _size)
+    {
+        if (!predicate.Matches(static_cast<int64_t>(metadata.size)))
+        {
+            return false;
+        }
+    }
+
+    if (!_modified.empty() || !_age.empty())
+    {
+        for (const auto &predicate : ModifiedPredicatesAt(now))
+        {
+            if (!predicate.Matches(metadata.modified))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (!_owners.empty())
+    {
+        auto owner = ToLower(metadata.owner);
+        auto found = std::any_of(_owners.begin(), _owners.end(), [&](const std::string &o) {
+            return ToLower(o) == owner;
+        });
+
+        if (!found)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MetadataQuery::GlobMatches(
+    const std::string &glob,
+    const std::string &name)
+{
+    size_t g = 0, n = 0;
+    size_t starGlob = std::string::npos, starName = 0;
+
+    while (n < name.size())
+    {
+        if (g < glob.size() && (glob[g] == '?' || std::tolower(static_cast<unsigned char>(glob[g])) == std::tolower(static_cast<unsigned char>(name[n]))))
+        {
+            g++;
+            n++;
+        }
+        else if (g < glob.size() && glob[g] == '*')
+        {
+            starGlob = g++;
+            starName = n;
+        }
+        else if (starGlob != std::string::npos)
+        {
+            // Let the last star swallow one more character and retry
+            g = starGlob + 1;
+            n = ++starName;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (g < glob.size() && glob[g] == '*')
+    {
+        g++;
+    }
+
+    return g == glob.size();
+}
+
+int64_t MetadataQuery::Now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
@@ -0,0 +1,240 @@
+#include "metadatawalker.h"
+
+#include <chrono>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <aclapi.h>
+#else
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MetadataWalker::MetadataWalker(
+    WorkerPool *workerPool,
+    const std::atomic<bool> &cancel)
+    : _workerPool(workerPool),
+      _cancel(cancel)
+{}
+
+void MetadataWalker::Walk(
+    const std::filesystem::path &root,
+    int fields,
+    const EntryFunc &onEntry)
+{
+    Schedule(root, fields, onEntry);
+
+    std::unique_lock<std::mutex> lock(_pendingMutex);
+    _pendingDone.wait(lock, [this]() { return _pending == 0; });
+}
+
+void MetadataWalker::Schedule(
+    const std::filesystem::path &directory,
+    int fields,
+    const EntryFunc &onEntry)
+{
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        _pending++;
+    }
+
+    auto job = [this, directory, fields, &onEntry]() {
+        WalkDirectory(directory, fields, onEntry);
+
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        if (--_pending == 0)
+        {
+            _pendingDone.notify_all();
+        }
+    };
+
+    if (_workerPool != nullptr)
+    {
+        _workerPool->Enqueue(job);
+    }
+    else
+    {
+        job();
+    }
+}
+
+void MetadataWalker::WalkDirectory(
+    const std::filesystem::path &directory,
+    int fields,
+    const EntryFunc &onEntry)
+{
+    std::error_code ec;
+    std::filesystem::directory_iterator entries(directory, std::filesystem::directory_options::skip_permission_denied, ec);
+
+    for (auto end = std::filesystem::directory_iterator(); !ec && entries != end; entries.increment(ec))
+    {
+        if (_cancel)
+        {
+            return;
+        }
+
+        FileMetadata metadata;
+        if (!ReadMetadata(*entries, fields, metadata))
+        {
+            continue;
+        }
+
+        onEntry(metadata);
+
+        if (metadata.type == FileTypes::Directory)
+        {
+            Schedule(metadata.path, fields, onEntry);
+        }
+    }
+}
+
+#if defined(__linux__) && defined(STATX_TYPE)
+
+static std::string OwnerName(
+    uid_t uid)
+{
+    static std::mutex ownersMutex;
+    static std::map<uid_t, std::string> owners;
+
+    std::lock_guard<std::mutex> lock(ownersMutex);
+
+    auto found = owners.find(uid);
+    if (found != owners.end())
+    {
+        return found->second;
+    }
+
+    struct passwd pwd, *result = nullptr;
+    char buffer[1024];
+    std::string name = std::to_string(uid);
+
+    if (getpwuid_r(uid, &pwd, buffer, sizeof(buffer), &result) == 0 && result != nullptr)
+    {
+        name = result->pw_name;
+    }
+
+    owners.insert(std::make_pair(uid, name));
+
+    return name;
+}
+
+bool MetadataWalker::ReadMetadata(
+    const std::filesystem::directory_entry &entry,
+    int fields,
+    FileMetadata &metadata)
+{
+    unsigned int mask = STATX_TYPE;
+    if (fields & MetadataFieldSize) mask |= STATX_SIZE;
+    if (fields & MetadataFieldModified) mask |= STATX_MTIME;
+    if (fields & MetadataFieldOwner) mask |= STATX_UID;
+
+    struct statx info;
+    if (statx(AT_FDCWD, entry.path().c_str(), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mask, &info) != 0)
+    {
+        return false;
+    }
+
+    metadata.path = entry.path();
+
+    if (S_ISREG(info.stx_mode)) metadata.type = FileTypes::File;
+    else if (S_ISDIR(info.stx_mode)) metadata.type = FileTypes::Directory;
+    else if (S_ISLNK(info.stx_mode)) metadata.type = FileTypes::Symlink;
+    else metadata.type = FileTypes::Other;
+
+    if (info.stx_mask & STATX_SIZE) metadata.size = info.stx_size;
+    if (info.stx_mask & STATX_MTIME) metadata.modified = info.stx_mtime.tv_sec;
+    if (info.stx_mask & STATX_UID) metadata.owner = OwnerName(info.stx_uid);
+
+    return true;
+}
+
+#else
+
+static std::string OwnerName(
+    const std::filesystem::path &path)
+{
+#ifdef _WIN32
+    PSID owner = nullptr;
+    PSECURITY_DESCRIPTOR securityDescriptor = nullptr;
+
+    if (GetNamedSecurityInfoW(path.wstring().c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION, &owner, nullptr, nullptr, nullptr, &securityDescriptor) != ERROR_SUCCESS)
+    {
+        return std::string();
+    }
+
+    wchar_t name[256], domain[256];
+    DWORD nameSize = 256, domainSize = 256;
+    SID_NAME_USE use;
+    std::wstring result;
+
+    if (LookupAccountSidW(nullptr, owner, name, &nameSize, domain, &domainSize, &use))
+    {
+        result = name;
+    }
+
+    LocalFree(securityDescriptor);
+
+    return std::filesystem::path(result).u8string();
+#else
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0)
+    {
+        return std::string();
+    }
+
+    auto pw = getpwuid(info.st_uid);
+
+    return pw != nullptr ? std::string(pw->pw_name) : std::to_string(info.st_uid);
+#endif
+}
+
+bool MetadataWalker::ReadMetadata(
+    const std::filesystem::directory_entry &entry,
+    int fields,
+    FileMetadata &metadata)
+{
+    // On Windows the directory iteration already delivers the type, size
+    // and time, so this does not touch the disk again
+    std::error_code ec;
+    auto status = entry.symlink_status(ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    metadata.path = entry.path();
+
+    if (std::filesystem::is_regular_file(status)) metadata.type = FileTypes::File;
+    else if (std::filesystem::is_directory(status)) metadata.type = FileTypes::Directory;
+    else if (std::filesystem::is_symlink(status)) metadata.type = FileTypes::Symlink;
+    else metadata.type = FileTypes::Other;
+
+    if ((fields & MetadataFieldSize) && metadata.type == FileTypes::File)
+    {
+        metadata.size = entry.file_size(ec);
+    }
+
+    if (fields & MetadataFieldModified)
+    {
+        auto writeTime = entry.last_write_time(ec);
+        if (!ec)
+        {
+            auto systemTime = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                writeTime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
+
+            metadata.modified = std::chrono::duration_cast<std::chrono::seconds>(systemTime.time_since_epoch()).count();
+        }
+    }
+
+    if (fields & MetadataFieldOwner)
+    {
+        metadata.owner = OwnerName(entry.path());
+    }
+
+    return true;
+}
+
+#endif
@@ -1,9 +1,167 @@
 #include "openfindwidget.h"
+#include "gzipreader.h"
+#include "mappedfile.h"
+#include "metadatawalker.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fmt/chrono.h>
 #include <fmt/format.h>
 #include <fstream>
 #include <sstream>
 
+#define FIND_CHUNK_SIZE (64 * 1024)
+#define FIND_MAX_LINE_LENGTH 4096
+#define FIND_MAX_OFFSETS_PER_FILE 1000
+#define FIND_FILES_PER_JOB 16
+
+namespace
+{
+    // Feeds chunks of a file through the automaton. The automaton state and the
+    // current line are carried over between chunks, so hits that straddle a
+    // chunk boundary are found and reported with their complete line.
+    class LineSearch
+    {
+    public:
+        LineSearch(
+            const AhoCorasick &matcher,
+            const std::filesystem::path &path,
+            FileSearchResult &result)
+            : _matcher(matcher),
+              _path(path),
+              _result(result)
+        {}
+
+        void Feed(
+            const char *data,
+            size_t size)
+        {
+            auto end = data + size;
+
+            while (data < end)
+            {
+                auto newLine = static_cast<const char *>(memchr(data, '\n', end - data));
+                auto segmentEnd = newLine != nullptr ? newLine : end;
+
+                _state = _matcher.Scan(_state, data, segmentEnd - data, [&](int patternIndex, size_t) {
+                    _result.hitCounts[patternIndex]++;
+                    if (std::find(_patternsInLine.begin(), _patternsInLine.end(), patternIndex) == _patternsInLine.end())
+                    {
+                        _patternsInLine.push_back(patternIndex);
+                    }
+                });
+
+                if (_line.size() < FIND_MAX_LINE_LENGTH)
+                {
+                    _line.append(data, std::min<size_t>(segmentEnd - data, FIND_MAX_LINE_LENGTH - _line.size()));
+                }
+
+                if (newLine == nullptr)
+                {
+                    break;
+                }
+
+                EndLine();
+                data = newLine + 1;
+            }
+        }
+
+        void Finish()
+        {
+            if (!_line.empty() || !_patternsInLine.empty())
+            {
+                EndLine();
+            }
+
+            if (!_result.lines.empty())
+            {
+                _result.lines.push_back("");
+            }
+        }
+
+    private:
+        const AhoCorasick &_matcher;
+        const std::filesystem::path &_path;
+        FileSearchResult &_result;
+        int _state = AhoCorasick::InitialState;
+        unsigned int _curLine = 0;
+        std::string _line;
+        std::vector<int> _patternsInLine;
+
+        void EndLine()
+        {
+            _curLine++;
+
+            if (!_line.empty() && _line.back() == '\r')
+            {
+                _line.pop_back();
+            }
+
+            if (!_patternsInLine.empty())
+            {
+                if (_result.lines.empty())
+                {
+                    _result.lines.push_back(_path.string());
+                }
+
+                if (_matcher.PatternCount() == 1)
+                {
+                    _result.lines.push_back(fmt::format(" {:>5} {}", _curLine, _line));
+                }
+                else
+                {
+                    std::string tags;
+                    for (auto patternIndex : _patternsInLine)
+                    {
+                        if (!tags.empty()) tags += ", ";
+                        tags += _matcher.Pattern(patternIndex);
+                    }
+                    _result.lines.push_back(fmt::format(" {:>5} [{}] {}", _curLine, tags, _line));
+                }
+            }
+
+            _state = AhoCorasick::InitialState;
+            _line.clear();
+            _patternsInLine.clear();
+        }
+    };
+    std::string FormatTime(
+        int64_t time)
+    {
+        return fmt::format("{:%Y-%m-%d %H:%M}", fmt::localtime(static_cast<std::time_t>(time)));
+    }
+
+    std::string FormatSize(
+        uint64_t size)
+    {
+        const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+        double value = static_cast<double>(size);
+        int unit = 0;
+
+        while (value >= 1024.0 && unit < 4)
+        {
+            value /= 1024.0;
+            unit++;
+        }
+
+        return unit == 0 ? fmt::format("{} B", size) : fmt::format("{:.1f} {}", value, units[unit]);
+    }
+
+    std::vector<std::string> FormatMetadata(
+        const FileMetadata &metadata,
+        int fields)
+    {
+        const char *types[] = {"file", "dir", "link", "other"};
+
+        auto details = fmt::format(" {:<5}", types[static_cast<int>(metadata.type)]);
+        if (fields & MetadataFieldSize) details += fmt::format(" {:>10}", FormatSize(metadata.size));
+        if (fields & MetadataFieldModified) details += fmt::format("  {}", FormatTime(metadata.modified));
+        if (fields & MetadataFieldOwner) details += fmt::format("  {}", metadata.owner);
+
+        return {metadata.path.string(), details};
+    }
+} // namespace
+
 OpenFindWidget::OpenFindWidget(
     int index,
     ServiceProvider *services,
@@ -11,6 +169,15 @@ OpenFindWidget::OpenFindWidget(
     : OpenDocument(index, services),
       _monoSpaceFont(monoSpaceFont)
 {
+    _workerPool = services->Resolve<WorkerPool *>();
+    _frameScheduler = services->Resolve<FrameScheduler *>();
+    _metadataIndex = services->Resolve<MetadataIndex *>();
+    _settingsService = services->Resolve<ISettingsService *>();
+
+    if (_settingsService != nullptr)
+    {
+        _savedSearches = _settingsService->GetSavedSearches();
+    }
 }
 
 void OpenFindWidget::OnPathChanged(
@@ -53,21 +220,69 @@ void OpenFindWidget::OnRender()
         _justChangedPath = false;
         ImGui::SetKeyboardFocusHere(0);
     }
-    ImGui::InputText("###searchFor", _buf, 256);
+    if (_findMode == FindModes::MultiplePatterns)
+    {
+        ImGui::InputTextMultiline(
+            "###patterns",
+            _patterns,
+            sizeof(_patterns),
+            ImVec2(0.0f, ImGui::GetTextLineHeight() * 6));
+    }
+    else
+    {
+        ImGui::InputText("###searchFor", _buf, 256);
+    }
 
     ImGui::SameLine();
 
-    auto enterPressed = ImGui::IsKeyPressed(ImGuiKey_Enter);
+    auto enterPressed = _findMode != FindModes::MultiplePatterns && ImGui::IsKeyPressed(ImGuiKey_Enter);
 
     if (ImGui::Button("Find") || enterPressed)
     {
         FinishThread();
 
-        t1 = std::make_unique<std::thread>([this]() {
-            StartFind(Convert(_buf), _documentPath);
+        auto patterns = CollectPatterns();
+
+        _savedSearchId = ActiveSavedSearchId();
+
+        t1 = std::make_unique<std::thread>([this, mode = _findMode, patterns, savedSearchId = _savedSearchId]() {
+            StartFind(mode, patterns, _documentPath, savedSearchId);
         });
     }
 
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Text", _findMode == FindModes::Text)) _findMode = FindModes::Text;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Multiple patterns", _findMode == FindModes::MultiplePatterns)) _findMode = FindModes::MultiplePatterns;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Hex bytes", _findMode == FindModes::Bytes)) _findMode = FindModes::Bytes;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Metadata", _findMode == FindModes::Metadata)) _findMode = FindModes::Metadata;
+
+    if (_findMode == FindModes::Metadata)
+    {
+        ImGui::TextDisabled("*.log size>1G age<7d type:file owner:name mtime>=2023-01-31");
+
+        if (_metadataIndex != nullptr)
+        {
+            ImGui::SameLine();
+
+            if (ImGui::Button("Build index"))
+            {
+                FinishThread();
+
+                t1 = std::make_unique<std::thread>([this]() {
+                    BuildMetadataIndex(_documentPath);
+                });
+            }
+        }
+    }
+
+    if (_settingsService != nullptr)
+    {
+        RenderSavedSearches();
+    }
+
     static std::string selection;
     struct Funcs
     {
@@ -130,8 +345,10 @@ void OpenFindWidget::FinishThread()
 {
     if (t1.get() != nullptr)
     {
+        _cancelFind = true;
         t1->join();
         t1 = nullptr;
+        _cancelFind = false;
     }
 }
 
@@ -143,57 +360,679 @@ void OpenFindWidget::AddLine(
     _content << line << "\n";
 
     _linesToAddMutex.unlock();
+
+    // Results come from the find thread, the window shows them without waiting for input
+    _frameScheduler->RequestFrame();
+}
+
+void OpenFindWidget::AddLines(
+    const std::vector<std::string> &lines)
+{
+    if (lines.empty())
+    {
+        return;
+    }
+
+    _linesToAddMutex.lock();
+
+    for (const auto &line : lines)
+    {
+        _content << line << "\n";
+    }
+
+    _linesToAddMutex.unlock();
+
+    _frameScheduler->RequestFrame();
+}
+
+std::vector<std::string> OpenFindWidget::CollectPatterns() const
+{
+    std::vector<std::string> result;
+
+    if (_findMode != FindModes::MultiplePatterns)
+    {
+        if (_buf[0] != 0)
+        {
+            result.push_back(_buf);
+        }
+
+        return result;
+    }
+
+    std::istringstream lines(_patterns);
+    std::string line;
+    while (getline(lines, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        if (!line.empty())
+        {
+            result.push_back(line);
+        }
+    }
+
+    return result;
+}
+
+std::string OpenFindWidget::PatternsText() const
+{
+    return _findMode == FindModes::MultiplePatterns ? _patterns : _buf;
+}
+
+void OpenFindWidget::RenderSavedSearches()
+{
+    const SavedSearch *active = nullptr;
+    for (const auto &search : _savedSearches)
+    {
+        if (search.id == ActiveSavedSearchId())
+        {
+            active = &search;
+        }
+    }
+
+    ImGui::SetNextItemWidth(300.0f);
+    if (ImGui::BeginCombo("###savedSearches", active != nullptr ? Convert(active->name).c_str() : "Saved searches"))
+    {
+        for (const auto &search : _savedSearches)
+        {
+            std::wstringstream wss;
+            wss << search.name << L"###" << search.id;
+
+            if (ImGui::Selectable(Convert(wss.str()).c_str(), active == &search))
+            {
+                RunSavedSearch(search);
+            }
+        }
+
+        if (_savedSearches.empty())
+        {
+            ImGui::TextDisabled("No saved searches yet");
+        }
+
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+
+    if (active != nullptr)
+    {
+        if (ImGui::Button("Forget search"))
+        {
+            // A running find of this search would write its files back
+            FinishThread();
+
+            _settingsService->DeleteSavedSearch(active->id);
+            _savedSearches = _settingsService->GetSavedSearches();
+            _savedSearchId = -1;
+        }
+    }
+    else
+    {
+        RenderButton("Save search", _findMode == FindModes::Metadata || CollectPatterns().empty(), [&]() {
+            SaveSearch();
+        });
+    }
+}
+
+void OpenFindWidget::SaveSearch()
+{
+    auto patterns = CollectPatterns();
+
+    auto name = patterns.front();
+    if (patterns.size() > 1)
+    {
+        name += fmt::format(" (+{})", patterns.size() - 1);
+    }
+
+    auto root = _documentPath.filename().empty() ? _documentPath.root_path() : _documentPath.filename();
+    name += fmt::format(" in {}", root.u8string());
+
+    auto id = _settingsService->AddSavedSearch(
+        Convert(name),
+        _documentPath,
+        static_cast<int>(_findMode),
+        Convert(PatternsText()));
+
+    if (id < 0)
+    {
+        return;
+    }
+
+    _savedSearches = _settingsService->GetSavedSearches();
+
+    for (const auto &search : _savedSearches)
+    {
+        if (search.id == id)
+        {
+            RunSavedSearch(search);
+        }
+    }
+}
+
+void OpenFindWidget::RunSavedSearch(
+    const SavedSearch &search)
+{
+    FinishThread();
+
+    _findMode = static_cast<FindModes>(search.mode);
+
+    auto patterns = Convert(search.patterns);
+    auto target = _findMode == FindModes::MultiplePatterns ? _patterns : _buf;
+    auto capacity = _findMode == FindModes::MultiplePatterns ? sizeof(_patterns) : sizeof(_buf);
+    auto length = std::min(patterns.size(), capacity - 1);
+    memcpy(target, patterns.data(), length);
+    target[length] = 0;
+
+    _savedSearchId = search.id;
+
+    if (search.root != _documentPath)
+    {
+        Open(search.root);
+    }
+
+    t1 = std::make_unique<std::thread>([this, mode = _findMode, patterns = CollectPatterns(), root = search.root, savedSearchId = search.id]() {
+        StartFind(mode, patterns, root, savedSearchId);
+    });
+}
+
+// The saved search only applies as long as the mode, patterns and folder
+// are still the ones it was saved with
+int OpenFindWidget::ActiveSavedSearchId() const
+{
+    for (const auto &search : _savedSearches)
+    {
+        if (search.id != _savedSearchId)
+        {
+            continue;
+        }
+
+        if (search.mode == static_cast<int>(_findMode) && search.root == _documentPath && Convert(search.patterns) == PatternsText())
+        {
+            return search.id;
+        }
+    }
+
+    return -1;
+}
+
+void OpenFindWidget::SearchFile(
+    const AhoCorasick &matcher,
+    const std::filesystem::path &path,
+    FileSearchResult &result)
+{
+    result.lines.clear();
+    result.hitCounts.assign(matcher.PatternCount(), 0);
+
+    LineSearch search(matcher, path, result);
+
+    std::vector<char> buffer(FIND_CHUNK_SIZE);
+
+    if (GzipReader::IsGzipFile(path))
+    {
+        GzipReader reader;
+        if (reader.Open(path))
+        {
+            size_t size;
+            while (!_cancelFind && (size = reader.Read(buffer.data(), buffer.size())) > 0)
+            {
+                search.Feed(buffer.data(), size);
+            }
+        }
+    }
+    else
+    {
+        std::ifstream fileInput(path, std::ios::binary);
+        while (!_cancelFind && (fileInput.read(buffer.data(), buffer.size()) || fileInput.gcount() > 0))
+        {
+            search.Feed(buffer.data(), static_cast<size_t>(fileInput.gcount()));
+        }
+    }
+
+    search.Finish();
+}
+
+void OpenFindWidget::SearchFileBytes(
+    const BytePattern &pattern,
+    const std::filesystem::path &path,
+    FileSearchResult &result)
+{
+    result.lines.clear();
+    result.hitCounts.assign(1, 0);
+
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return;
+    }
+
+    auto data = file.Data();
+    auto size = file.Size();
+
+    pattern.FindAll(data, size, [&](size_t offset) {
+        if (_cancelFind)
+        {
+            return false;
+        }
+
+        if (result.hitCounts[0]++ >= FIND_MAX_OFFSETS_PER_FILE)
+        {
+            return true;
+        }
+
+        if (result.lines.empty())
+        {
+            result.lines.push_back(path.string());
+        }
+
+        std::string bytes;
+        for (size_t i = 0; i < pattern.Size(); i++)
+        {
+            bytes += fmt::format(" {:02X}", data[offset + i]);
+        }
+        result.lines.push_back(fmt::format(" 0x{:08X}{}", offset, bytes));
+
+        return true;
+    });
+
+    if (result.hitCounts[0] > FIND_MAX_OFFSETS_PER_FILE)
+    {
+        result.lines.push_back(fmt::format(" ... {} more", result.hitCounts[0] - FIND_MAX_OFFSETS_PER_FILE));
+    }
+
+    if (!result.lines.empty())
+    {
+        result.lines.push_back("");
+    }
 }
 
 void OpenFindWidget::RecursiveFind(
-    const std::wstring &searchFor,
     const std::filesystem::path &path,
-    int fileCount,
-    int hitCount)
+    const FileSearchFunc &searchFile,
+    FindJobs &jobs,
+    FindTotals &totals)
 {
     for (auto const &dir_entry : std::filesystem::directory_iterator{path})
     {
+        if (_cancelFind)
+        {
+            return;
+        }
+
         if (std::filesystem::is_directory(dir_entry))
         {
-            RecursiveFind(searchFor, dir_entry.path(), fileCount, hitCount);
+            RecursiveFind(dir_entry.path(), searchFile, jobs, totals);
             continue;
         }
 
-        fileCount++;
+        jobs.batch.push_back(dir_entry.path());
+
+        if (jobs.batch.size() >= FIND_FILES_PER_JOB)
+        {
+            SubmitFindBatch(searchFile, jobs, totals);
+        }
+    }
+}
 
-        bool fileHasResults = false;
+void OpenFindWidget::SubmitFindBatch(
+    const FileSearchFunc &searchFile,
+    FindJobs &jobs,
+    FindTotals &totals)
+{
+    if (jobs.batch.empty())
+    {
+        return;
+    }
 
-        std::ifstream fileInput(dir_entry.path());
-        std::string line;
-        unsigned int curLine = 0;
-        while (getline(fileInput, line))
+    auto job = [this, &searchFile, &totals, files = std::move(jobs.batch)]() {
+        for (auto const &filePath : files)
         {
-            curLine++;
-            if (line.find(Convert(searchFor), 0) != std::string::npos)
+            if (_cancelFind)
             {
-                hitCount++;
-                if (!fileHasResults)
-                {
-                    AddLine(dir_entry.path().string());
-                }
-                AddLine(fmt::format(" {:>5} {}", curLine, line));
-                fileHasResults = true;
+                return;
+            }
+
+            FileSearchResult result;
+            searchFile(filePath, result);
+            AddLines(result.lines);
+
+            std::lock_guard<std::mutex> lock(totals.mutex);
+            totals.fileCount++;
+            for (size_t i = 0; i < result.hitCounts.size(); i++)
+            {
+                totals.hitCounts[i] += result.hitCounts[i];
             }
         }
-        if (fileHasResults) AddLine("");
+    };
+
+    jobs.batch.clear();
+
+    if (_workerPool == nullptr)
+    {
+        job();
+
+        return;
+    }
+
+    // The walk waits here for the oldest batch instead of queueing the whole
+    // tree up front
+    while (jobs.inFlight.size() >= jobs.maxInFlight)
+    {
+        jobs.inFlight.front().wait();
+        jobs.inFlight.pop_front();
     }
+
+    jobs.inFlight.push_back(_workerPool->Enqueue(job));
 }
 
 void OpenFindWidget::StartFind(
-    const std::wstring &searchFor,
+    FindModes mode,
+    const std::vector<std::string> &searchFor,
+    const std::filesystem::path &path,
+    int savedSearchId)
+{
+    if (searchFor.empty())
+    {
+        return;
+    }
+
+    if (mode == FindModes::Metadata)
+    {
+        StartMetadataQuery(searchFor.front(), path);
+
+        return;
+    }
+
+    AhoCorasick matcher;
+    BytePattern bytePattern;
+    FileSearchFunc searchFile;
+
+    if (mode == FindModes::Bytes)
+    {
+        if (!bytePattern.Parse(searchFor.front()))
+        {
+            AddLine(fmt::format("\"{}\" is not a valid byte pattern, use hex bytes and ?? for any byte, like \"4D 5A ?? 00\"\n", searchFor.front()));
+
+            return;
+        }
+
+        searchFile = [&](const std::filesystem::path &file, FileSearchResult &result) {
+            SearchFileBytes(bytePattern, file, result);
+        };
+    }
+    else
+    {
+        for (const auto &pattern : searchFor)
+        {
+            matcher.AddPattern(pattern);
+        }
+        matcher.Build();
+
+        searchFile = [&](const std::filesystem::path &file, FileSearchResult &result) {
+            SearchFile(matcher, file, result);
+        };
+    }
+
+    FindTotals totals;
+    totals.hitCounts.assign(searchFor.size(), 0);
+
+    // For a saved search only the files that changed since the last run are
+    // searched again, the results of all other files come from the settings
+    std::map<std::filesystem::path, SavedSearchFile> cachedFiles;
+    std::map<std::filesystem::path, SavedSearchFile> changedFiles;
+    std::set<std::filesystem::path> seenFiles;
+    std::mutex savedSearchMutex;
+    std::atomic<size_t> reusedCount = 0;
+
+    if (savedSearchId >= 0 && _settingsService != nullptr)
+    {
+        cachedFiles = _settingsService->GetSavedSearchFiles(savedSearchId);
+
+        searchFile = [&, scanFile = searchFile](const std::filesystem::path &file, FileSearchResult &result) {
+            std::error_code ec;
+            auto modified = static_cast<double>(std::filesystem::last_write_time(file, ec).time_since_epoch().count());
+            auto size = static_cast<double>(std::filesystem::file_size(file, ec));
+
+            auto cached = cachedFiles.find(file);
+            if (cached != cachedFiles.end() && cached->second.modified == modified && cached->second.size == size && cached->second.hitCounts.size() == searchFor.size())
+            {
+                result.lines = cached->second.lines;
+                result.hitCounts = cached->second.hitCounts;
+                reusedCount++;
+
+                std::lock_guard<std::mutex> lock(savedSearchMutex);
+                seenFiles.insert(file);
+
+                return;
+            }
+
+            scanFile(file, result);
+
+            if (_cancelFind)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(savedSearchMutex);
+            seenFiles.insert(file);
+            changedFiles[file] = SavedSearchFile{modified, size, result.hitCounts, result.lines};
+        };
+    }
+
+    if (mode == FindModes::Bytes)
+    {
+        AddLine(fmt::format("Starting search for bytes {} in files from : \"{}\"\n", bytePattern.ToString(), path.string()));
+    }
+    else if (searchFor.size() == 1)
+    {
+        AddLine(fmt::format("Starting search for \"{}\" in files from : \"{}\"\n", searchFor.front(), path.string()));
+    }
+    else
+    {
+        AddLine(fmt::format("Starting search for {} patterns in files from : \"{}\"\n", searchFor.size(), path.string()));
+    }
+
+    // One pool thread is always left for other work
+    FindJobs jobs;
+    if (_workerPool != nullptr && _workerPool->ThreadCount() > 1)
+    {
+        jobs.maxInFlight = _workerPool->ThreadCount() - 1;
+    }
+
+    RecursiveFind(path, searchFile, jobs, totals);
+    SubmitFindBatch(searchFile, jobs, totals);
+
+    for (auto &job : jobs.inFlight)
+    {
+        job.wait();
+    }
+
+    if (_cancelFind)
+    {
+        AddLine("Search cancelled\n");
+
+        return;
+    }
+
+    if (savedSearchId >= 0 && _settingsService != nullptr)
+    {
+        FinishSavedSearch(savedSearchId, cachedFiles, changedFiles, seenFiles, reusedCount);
+    }
+
+    auto &hitCounts = totals.hitCounts;
+    auto fileCount = totals.fileCount;
+
+    if (mode == FindModes::Bytes)
+    {
+        AddLine(fmt::format("Found bytes {} {} times in {} files\n", bytePattern.ToString(), hitCounts.front(), fileCount));
+
+        return;
+    }
+
+    if (searchFor.size() == 1)
+    {
+        AddLine(fmt::format("Found \"{}\" {} times in {} files\n", searchFor.front(), hitCounts.front(), fileCount));
+
+        return;
+    }
+
+    AddLine(fmt::format("Searched {} files:", fileCount));
+    for (size_t i = 0; i < searchFor.size(); i++)
+    {
+        AddLine(fmt::format(" {:>5}x \"{}\"", hitCounts[i], searchFor[i]));
+    }
+    AddLine("");
+}
+
+void OpenFindWidget::FinishSavedSearch(
+    int savedSearchId,
+    const std::map<std::filesystem::path, SavedSearchFile> &cachedFiles,
+    const std::map<std::filesystem::path, SavedSearchFile> &changedFiles,
+    const std::set<std::filesystem::path> &seenFiles,
+    size_t reusedCount)
+{
+    std::vector<std::filesystem::path> removedFiles;
+    std::vector<std::string> changes;
+
+    for (const auto &changedFile : changedFiles)
+    {
+        auto cached = cachedFiles.find(changedFile.first);
+        auto hadHits = cached != cachedFiles.end() && !cached->second.lines.empty();
+        auto hasHits = !changedFile.second.lines.empty();
+
+        if (hasHits && !hadHits)
+        {
+            changes.push_back(fmt::format(" + {}", changedFile.first.string()));
+        }
+        else if (!hasHits && hadHits)
+        {
+            changes.push_back(fmt::format(" - {}", changedFile.first.string()));
+        }
+        else if (hasHits && cached->second.lines != changedFile.second.lines)
+        {
+            changes.push_back(fmt::format(" ~ {}", changedFile.first.string()));
+        }
+    }
+
+    for (const auto &cachedFile : cachedFiles)
+    {
+        if (seenFiles.find(cachedFile.first) != seenFiles.end())
+        {
+            continue;
+        }
+
+        removedFiles.push_back(cachedFile.first);
+
+        if (!cachedFile.second.lines.empty())
+        {
+            changes.push_back(fmt::format(" - {} (deleted)", cachedFile.first.string()));
+        }
+    }
+
+    _settingsService->UpdateSavedSearchFiles(savedSearchId, changedFiles, removedFiles);
+
+    if (cachedFiles.empty())
+    {
+        return;
+    }
+
+    AddLine(fmt::format("Searched {} changed files again, reused the results of {} unchanged files, {} removed files", changedFiles.size(), reusedCount, removedFiles.size()));
+
+    if (changes.empty())
+    {
+        AddLine("No changes in the results since the last run\n");
+
+        return;
+    }
+
+    AddLine("Changes in the results since the last run:");
+    AddLines(changes);
+    AddLine("");
+}
+
+void OpenFindWidget::StartMetadataQuery(
+    const std::string &queryText,
+    const std::filesystem::path &path)
+{
+    MetadataQuery query;
+    if (!query.Parse(queryText))
+    {
+        AddLine(fmt::format("{}\n", query.Error()));
+
+        return;
+    }
+
+    auto now = MetadataQuery::Now();
+    std::atomic<size_t> matches = 0;
+
+    AddLine(fmt::format("Starting metadata query \"{}\" in files from : \"{}\"\n", queryText, path.string()));
+
+    int64_t indexedAt = 0;
+    auto indexedRoot = _metadataIndex != nullptr ? _metadataIndex->FindIndexedRoot(path, indexedAt) : std::filesystem::path();
+
+    if (!indexedRoot.empty())
+    {
+        auto considered = _metadataIndex->Query(path, query, now, [&](const FileMetadata &metadata) {
+            matches++;
+            AddLines(FormatMetadata(metadata, MetadataFieldAll));
+        });
+
+        AddLine("");
+        AddLine(fmt::format("Found {} entries, {} checked, in the index of \"{}\" built {}\n", matches.load(), considered, indexedRoot.string(), FormatTime(indexedAt)));
+
+        return;
+    }
+
+    std::atomic<size_t> scanned = 0;
+    auto fields = query.NeededFields();
+
+    MetadataWalker walker(_workerPool, _cancelFind);
+    walker.Walk(path, fields, [&](const FileMetadata &metadata) {
+        scanned++;
+
+        if (query.Matches(metadata, now))
+        {
+            matches++;
+            AddLines(FormatMetadata(metadata, fields));
+        }
+    });
+
+    if (_cancelFind)
+    {
+        AddLine("Search cancelled\n");
+
+        return;
+    }
+
+    AddLine("");
+    AddLine(fmt::format("Found {} of {} entries\n", matches.load(), scanned.load()));
+}
+
+void OpenFindWidget::BuildMetadataIndex(
     const std::filesystem::path &path)
 {
-    int fileCount = 0;
-    int hitCount = 0;
+    std::mutex entriesMutex;
+    std::vector<FileMetadata> entries;
+    auto now = MetadataQuery::Now();
+
+    AddLine(fmt::format("Building metadata index of \"{}\"", path.string()));
+
+    MetadataWalker walker(_workerPool, _cancelFind);
+    walker.Walk(path, MetadataFieldAll, [&](const FileMetadata &metadata) {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        entries.push_back(metadata);
+    });
 
-    AddLine(fmt::format("Starting search for \"{}\" in files from : \"{}\"\n", Convert(searchFor), path.string()));
+    if (_cancelFind)
+    {
+        AddLine("Indexing cancelled\n");
+
+        return;
+    }
 
-    RecursiveFind(searchFor, path, fileCount, hitCount);
+    _metadataIndex->Replace(path, entries, now);
 
-    AddLine(fmt::format("Found \"{}\" {} times in {} files\n", Convert(searchFor), hitCount, fileCount));
+    AddLine(fmt::format("Indexed {} entries, metadata queries below this folder now use the index\n", entries.size()));
 }
@@ -1,8 +1,10 @@
 #include "openfolderwidget.h"
 
 #include <IconsMaterialDesign.h>
+#include <algorithm>
 #include <imgui.h>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 
@@ -71,6 +73,17 @@ OpenFolderWidget::OpenFolderWidget(
     : OpenDocument(index, services)
 {
     _settingsService = services->Resolve<ISettingsService *>();
+    _thumbnailCache = services->Resolve<ThumbnailCache *>();
+    _exifIndex = services->Resolve<ExifIndex *>();
+    _thumbnailAtlas = services->Resolve<TextureCache *>()->Thumbnails();
+}
+
+OpenFolderWidget::~OpenFolderWidget()
+{
+    if (_thumbnailCache != nullptr)
+    {
+        _thumbnailCache->Release(Id());
+    }
 }
 
 bool folderFirst(
@@ -111,7 +124,9 @@ void OpenFolderWidget::Refresh(
         _itemsInFolder.push_back(item);
     }
 
-    std::sort(_itemsInFolder.begin(), _itemsInFolder.end(), folderFirst);
+    _exifIndex->Scan(_documentPath);
+
+    SortItems();
 
     _pathInSections.clear();
     auto tmp = _documentPath;
@@ -127,6 +142,38 @@ void OpenFolderWidget::Refresh(
     std::reverse(_pathInSections.begin(), _pathInSections.end());
 }
 
+void OpenFolderWidget::SortItems()
+{
+    std::sort(_itemsInFolder.begin(), _itemsInFolder.end(), folderFirst);
+
+    _sortedGeneration = _exifIndex->Generation();
+
+    if (!_sortByCaptureTime)
+    {
+        return;
+    }
+
+    auto firstFile = std::find_if(
+        _itemsInFolder.begin(),
+        _itemsInFolder.end(),
+        [](const folderItem &item) { return !item.isDir; });
+
+    std::vector<std::filesystem::path> files;
+    std::map<std::filesystem::path, folderItem> itemsByPath;
+    for (auto it = firstFile; it != _itemsInFolder.end(); ++it)
+    {
+        files.push_back(it->path);
+        itemsByPath.insert(std::make_pair(it->path, *it));
+    }
+
+    _exifIndex->SortByCaptureTime(files);
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        *(firstFile + i) = itemsByPath.at(files[i]);
+    }
+}
+
 void OpenFolderWidget::OnPathChanged(
     const std::filesystem::path &oldPath)
 {
@@ -362,6 +409,8 @@ void OpenFolderWidget::OnRender()
         }
         else if (!_showFind)
         {
+            auto rowStep = _showGrid ? _gridColumns : 1;
+
             if (ImGui::IsKeyPressed(ImGuiKey_UpArrow))
             {
                 if (ImGui::GetIO().KeyAlt)
@@ -370,12 +419,20 @@ void OpenFolderWidget::OnRender()
                 }
                 else
                 {
-                    MoveSelectionUp(ImGui::GetIO().KeyCtrl ? 5 : 1);
+                    MoveSelectionUp((ImGui::GetIO().KeyCtrl ? 5 : 1) * rowStep);
                 }
             }
             else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow))
             {
-                MoveSelectionDown(ImGui::GetIO().KeyCtrl ? 5 : 1);
+                MoveSelectionDown((ImGui::GetIO().KeyCtrl ? 5 : 1) * rowStep);
+            }
+            else if (_showGrid && ImGui::IsKeyPressed(ImGuiKey_LeftArrow))
+            {
+                MoveSelectionUp();
+            }
+            else if (_showGrid && ImGui::IsKeyPressed(ImGuiKey_RightArrow))
+            {
+                MoveSelectionDown();
             }
             else if (ImGui::IsKeyPressed(ImGuiKey_Enter))
             {
@@ -425,6 +482,23 @@ void OpenFolderWidget::OnRender()
         !_showInfo,
         [&]() { ToggleShowInfo(); });
 
+    ImGui::SetCursorPos(ImVec2(ImGui::GetContentRegionAvail().x - 130, pos.y));
+    RenderButton(
+        _showGrid ? ICON_MD_VIEW_LIST : ICON_MD_GRID_VIEW,
+        false,
+        [&]() { ToggleShowGrid(); });
+
+    ImGui::SetCursorPos(ImVec2(ImGui::GetContentRegionAvail().x - 180, pos.y));
+    RenderButton(
+        _sortByCaptureTime ? ICON_MD_SORT_BY_ALPHA : ICON_MD_SCHEDULE,
+        false,
+        [&]() { ToggleSortByCaptureTime(); });
+
+    if (_sortByCaptureTime && _sortedGeneration != _exifIndex->Generation())
+    {
+        SortItems();
+    }
+
     ImGui::SetCursorPos(pos);
     RenderButton(
         ICON_MD_WEST,
@@ -477,6 +551,72 @@ void OpenFolderWidget::OnRender()
 
     ImGui::BeginChild("entries", ImVec2(0.0f, (_showFind ? -60.0f : 0.0f) + (_showInfo ? -130.0f : 0.0f)));
 
+    if (_showGrid)
+    {
+        RenderGrid();
+    }
+    else
+    {
+        RenderList();
+    }
+
+    ImGui::EndChild();
+
+    if (_showInfo)
+    {
+        ImGui::PushStyleColor(
+            ImGuiCol_ChildBg,
+            IM_COL32(0, 0, 0, 15));
+
+        ImGui::BeginChild("Info", ImVec2(0.0f, 120.0f));
+
+        ImGui::Text("Filename:\t%s", Convert(_documentPath.filename().wstring()).c_str());
+
+        ImGui::Text("TODO");
+
+        ImGui::EndChild();
+
+        ImGui::PopStyleColor();
+    }
+
+    if (_showFind)
+    {
+        ImGui::BeginChild("Find");
+        if (shiftFocusToFind)
+        {
+            ImGui::SetKeyboardFocusHere(0);
+        }
+        if (ImGui::InputText("Find filename", _buffer, 64))
+        {
+            _findBuffer = Convert(_buffer);
+            _currentSelection.activePath.clear();
+        }
+        ImGui::EndChild();
+    }
+
+    ImGui::End();
+
+    RenderYesNoDialog(
+        _showDeletePopup,
+        L"Delete item?",
+        L"Are you sure?",
+        [this]() {
+            DeleteSelection();
+        });
+
+    RenderYesNoDialog(
+        _showMoveToTrashPopup,
+        L"Move item to trash?",
+        L"Are you sure?",
+        [this]() {
+            MoveSelectionToTrash();
+        });
+
+    RenderOpenWithoptionsDialog();
+}
+
+void OpenFolderWidget::RenderList()
+{
     for (auto const &dir_entry : _itemsInFolder)
     {
         if (dir_entry.name.find(_findBuffer) == std::string::npos)
@@ -544,60 +684,214 @@ void OpenFolderWidget::OnRender()
 
         ImGui::PopID();
     }
+}
 
-    ImGui::EndChild();
+static int OrientationToQuarterTurns(
+    int orientation)
+{
+    switch (orientation)
+    {
+        case 3:
+        case 4:
+            return 2;
+        case 5:
+        case 6:
+            return 1;
+        case 7:
+        case 8:
+            return 3;
+    }
 
-    if (_showInfo)
+    return 0;
+}
+
+static void DrawThumbnail(
+    ImDrawList *drawList,
+    const ThumbnailAtlas::Placement &placement,
+    const ImVec2 &cellMin,
+    float cellSize)
+{
+    auto turns = OrientationToQuarterTurns(placement.orientation);
+    auto size = placement.size;
+    if (turns % 2 == 1)
     {
-        ImGui::PushStyleColor(
-            ImGuiCol_ChildBg,
-            IM_COL32(0, 0, 0, 15));
+        std::swap(size.x, size.y);
+    }
 
-        ImGui::BeginChild("Info", ImVec2(0.0f, 120.0f));
+    auto scale = cellSize / std::max(size.x, size.y);
+    auto min = ImVec2(
+        cellMin.x + (cellSize - size.x * scale) / 2.0f,
+        cellMin.y + (cellSize - size.y * scale) / 2.0f);
+    auto max = ImVec2(
+        min.x + size.x * scale,
+        min.y + size.y * scale);
+
+    // Clockwise from the top left, turning the image clockwise shifts which
+    // corner of the thumbnail ends up in each corner of the cell
+    ImVec2 uvs[4] = {
+        placement.uvMin,
+        ImVec2(placement.uvMax.x, placement.uvMin.y),
+        placement.uvMax,
+        ImVec2(placement.uvMin.x, placement.uvMax.y),
+    };
+
+    drawList->AddImageQuad(
+        (ImTextureID)(size_t)placement.textureId,
+        min,
+        ImVec2(max.x, min.y),
+        max,
+        ImVec2(min.x, max.y),
+        uvs[(4 - turns) % 4],
+        uvs[(5 - turns) % 4],
+        uvs[(6 - turns) % 4],
+        uvs[(7 - turns) % 4]);
+}
 
-        ImGui::Text("Filename:\t%s", Convert(_documentPath.filename().wstring()).c_str());
+void OpenFolderWidget::RenderGrid()
+{
+    std::vector<const folderItem *> items;
+    for (auto const &dir_entry : _itemsInFolder)
+    {
+        if (dir_entry.name.find(_findBuffer) != std::string::npos)
+        {
+            items.push_back(&dir_entry);
+        }
+    }
 
-        ImGui::Text("TODO");
+    auto &style = ImGui::GetStyle();
+    auto cellSize = ImVec2(THUMBNAIL_GRID_CELL, THUMBNAIL_GRID_CELL + ImGui::GetTextLineHeightWithSpacing());
 
-        ImGui::EndChild();
+    _gridColumns = std::max(1, (int)((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / (cellSize.x + style.ItemSpacing.x)));
+    auto rowCount = ((int)items.size() + _gridColumns - 1) / _gridColumns;
 
-        ImGui::PopStyleColor();
-    }
+    std::vector<std::filesystem::path> visibleImages;
+    std::vector<std::filesystem::path> nearbyImages;
+    int uploads = 0;
+    int firstVisibleRow = rowCount;
+    int lastVisibleRow = 0;
 
-    if (_showFind)
+    ImGuiListClipper clipper;
+    clipper.Begin(rowCount, cellSize.y + style.ItemSpacing.y);
+    while (clipper.Step())
     {
-        ImGui::BeginChild("Find");
-        if (shiftFocusToFind)
-        {
-            ImGui::SetKeyboardFocusHere(0);
-        }
-        if (ImGui::InputText("Find filename", _buffer, 64))
+        firstVisibleRow = std::min(firstVisibleRow, clipper.DisplayStart);
+        lastVisibleRow = std::max(lastVisibleRow, clipper.DisplayEnd);
+
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
         {
-            _findBuffer = Convert(_buffer);
-            _currentSelection.activePath.clear();
+            for (int column = 0; column < _gridColumns; column++)
+            {
+                auto index = row * _gridColumns + column;
+                if (index >= (int)items.size())
+                {
+                    break;
+                }
+
+                auto &item = *items[index];
+
+                if (column > 0)
+                {
+                    ImGui::SameLine();
+                }
+
+                ImGui::PushID(item.name.c_str());
+
+                auto cellMin = ImGui::GetCursorScreenPos();
+                auto isDir = item.isDir;
+
+                if (ImGui::Selectable("##cell", _currentSelection.IsSelected(item.path), 0, cellSize))
+                {
+                    _currentSelection.SetSelection(item.path);
+                }
+
+                RenderPathItemContextMenu(item.path);
+
+                if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0))
+                {
+                    ActivateItem(item.path);
+                }
+
+                auto drawList = ImGui::GetWindowDrawList();
+
+                ThumbnailAtlas::Placement placement;
+                bool hasThumbnail = false;
+                if (!isDir && ImageDecoder::IsSupported(item.path))
+                {
+                    visibleImages.push_back(item.path);
+
+                    hasThumbnail = _thumbnailAtlas->Find(item.path, placement);
+                    if (!hasThumbnail && uploads < THUMBNAIL_GRID_UPLOADS_PER_FRAME)
+                    {
+                        std::shared_ptr<DecodedImage> thumbnail;
+                        if (_thumbnailCache->Lookup(item.path, thumbnail) == DecodeStates::Ready && _thumbnailAtlas->Add(item.path, *thumbnail))
+                        {
+                            uploads++;
+                            hasThumbnail = _thumbnailAtlas->Find(item.path, placement);
+                        }
+                    }
+                }
+
+                if (hasThumbnail)
+                {
+                    DrawThumbnail(drawList, placement, cellMin, THUMBNAIL_GRID_CELL);
+                }
+                else
+                {
+                    auto icon = isDir ? ICON_MD_FOLDER : ICON_MD_DESCRIPTION;
+                    auto iconSize = ImGui::CalcTextSize(icon);
+                    drawList->AddText(
+                        ImVec2(
+                            cellMin.x + (THUMBNAIL_GRID_CELL - iconSize.x) / 2.0f,
+                            cellMin.y + (THUMBNAIL_GRID_CELL - iconSize.y) / 2.0f),
+                        ImGui::GetColorU32(ImGuiCol_Text),
+                        icon);
+                }
+
+                auto labelMin = ImVec2(cellMin.x, cellMin.y + THUMBNAIL_GRID_CELL);
+                auto labelMax = ImVec2(cellMin.x + cellSize.x, cellMin.y + cellSize.y);
+                drawList->PushClipRect(labelMin, labelMax, true);
+                drawList->AddText(labelMin, ImGui::GetColorU32(ImGuiCol_Text), Convert(item.name).c_str());
+                drawList->PopClipRect();
+
+                if (item.path == _currentSelection.activePath)
+                {
+                    drawList->AddRect(
+                        cellMin,
+                        labelMax,
+                        IM_COL32(0, 20, 50, 255));
+                }
+
+                ImGui::PopID();
+            }
         }
-        ImGui::EndChild();
     }
 
-    ImGui::End();
+    // Thumbnails for the rows just outside the view are asked for after the
+    // visible ones, so they are usually done before they scroll into view
+    auto addNearbyRows = [&](int firstRow, int lastRow) {
+        for (int row = std::max(0, firstRow); row < std::min(rowCount, lastRow); row++)
+        {
+            for (int index = row * _gridColumns; index < std::min((int)items.size(), (row + 1) * _gridColumns); index++)
+            {
+                auto &item = *items[index];
+                if (!item.isDir && ImageDecoder::IsSupported(item.path))
+                {
+                    nearbyImages.push_back(item.path);
+                }
+            }
+        }
+    };
 
-    RenderYesNoDialog(
-        _showDeletePopup,
-        L"Delete item?",
-        L"Are you sure?",
-        [this]() {
-            DeleteSelection();
-        });
+    addNearbyRows(lastVisibleRow, lastVisibleRow + THUMBNAIL_GRID_LOOKAHEAD_ROWS);
+    addNearbyRows(firstVisibleRow - THUMBNAIL_GRID_LOOKAHEAD_ROWS, firstVisibleRow);
 
-    RenderYesNoDialog(
-        _showMoveToTrashPopup,
-        L"Move item to trash?",
-        L"Are you sure?",
-        [this]() {
-            MoveSelectionToTrash();
-        });
+    visibleImages.insert(visibleImages.end(), nearbyImages.begin(), nearbyImages.end());
 
-    RenderOpenWithoptionsDialog();
+    if (visibleImages != _requestedThumbnails)
+    {
+        _requestedThumbnails = visibleImages;
+        _thumbnailCache->Request(Id(), _requestedThumbnails);
+    }
 }
 
 void OpenFolderWidget::RenderOpenWithoptionsDialog()
@@ -736,6 +1030,24 @@ void OpenFolderWidget::ToggleShowInfo()
     }
 }
 
+void OpenFolderWidget::ToggleShowGrid()
+{
+    _showGrid = !_showGrid;
+
+    if (!_showGrid)
+    {
+        _requestedThumbnails.clear();
+        _thumbnailCache->Release(Id());
+    }
+}
+
+void OpenFolderWidget::ToggleSortByCaptureTime()
+{
+    _sortByCaptureTime = !_sortByCaptureTime;
+
+    SortItems();
+}
+
 void OpenFolderWidget::ToggleBookmark()
 {
     _isBookmark = !_isBookmark;
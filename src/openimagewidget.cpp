@@ -1,116 +1,476 @@
 #include "openimagewidget.h"
+#include "imagearchive.h"
 
-#include <EXIF.H>
 #include <IconsMaterialDesign.h>
 #include <algorithm>
 #include <cmath>
+#include <fmt/format.h>
 #include <glad/glad.h>
 #include <imgui.h>
 #include <iostream>
-#include <stb_image.h>
 
 OpenImageWidget::OpenImageWidget(
     int index,
     ServiceProvider *services)
     : OpenDocument(index, services)
-{}
+{
+    _workerPool = services->Resolve<WorkerPool *>();
+    _frameScheduler = services->Resolve<FrameScheduler *>();
+    _textureUploader = services->Resolve<TextureUploader *>();
+    _textureCache = services->Resolve<TextureCache *>();
+    _decodedImageCache = services->Resolve<DecodedImageCache *>();
+    _histogramCache = services->Resolve<HistogramCache *>();
+    _imageDirectoryIndex = services->Resolve<ImageDirectoryIndex *>();
+    _exifIndex = services->Resolve<ExifIndex *>();
+    _animationPlayer = std::make_unique<AnimationPlayer>(_workerPool, _frameScheduler);
+}
+
+OpenImageWidget::~OpenImageWidget()
+{
+    _decodedImageCache->Release(Id());
+    _textureCache->Release(Id());
+
+    ClearTiles();
+}
 
 void OpenImageWidget::OnPathChanged(
     const std::filesystem::path &oldPath)
 {
-    _zoom = 1.0f;
-    _pan = ImVec2();
+    UpdateListing();
 
-    if (_textureId != 0)
+    _decodeDimension = DecodeDimension();
+    _isLoadingFullResolution = false;
+    _isShowingThumbnail = false;
+    _pendingTexture = CachedTexture();
+    HoldTextures();
+
+    ClearTiles();
+
+    // The first frame is decoded as a still image as well, it is shown
+    // until it is clear the gif is animated
+    _animationPlayer->Close();
+    if (GifDecoder::IsGif(_documentPath))
     {
-        glDeleteTextures(1, &_textureId);
-        _textureId = 0;
+        _animationPlayer->Open(_documentPath);
     }
 
-    int x, y, channels;
-    auto imageData = stbi_load(_documentPath.string().c_str(), &x, &y, &channels, 4);
-    if (imageData == nullptr)
+    auto texture = FindTexture(_documentPath, 0);
+    if (texture == nullptr)
     {
-        return;
+        texture = FindTexture(_documentPath, _decodeDimension);
     }
 
-    _textureSize.x = x;
-    _textureSize.y = y;
+    if (texture != nullptr)
+    {
+        _isLoading = true;
+        ShowWhenUploaded(*texture, true);
+    }
+    else
+    {
+        texture = FindTexture(_documentPath, DecodeRequest::EmbeddedThumbnail);
+        if (texture != nullptr)
+        {
+            ShowTexture(*texture, true);
+        }
 
-    glGenTextures(1, &_textureId);
-    glBindTexture(GL_TEXTURE_2D, _textureId);
+        _isLoading = true;
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    RequestImages();
+}
 
-    stbi_image_free(imageData);
+// Images are decoded at a size that fits the viewport, rounded up to a power
+// of two so small changes of the window size don't cause new decodes
+int OpenImageWidget::DecodeDimension() const
+{
+    auto longest = std::max(_viewportSize.x, _viewportSize.y);
 
-    _prevImage.clear();
-    _nextImage.clear();
-    bool foundCurrentEntry = false;
-    for (auto const &dir_entry : std::filesystem::directory_iterator{_documentPath.parent_path()})
+    int dimension = 1024;
+    while (dimension < longest)
     {
-        if (!IsImage(dir_entry))
+        dimension *= 2;
+    }
+
+    return dimension;
+}
+
+// The images that are likely to be opened next, nearest first and mostly in
+// the direction the user is browsing
+std::vector<std::filesystem::path> OpenImageWidget::PrefetchPaths() const
+{
+    std::vector<std::filesystem::path> result;
+
+    for (int i = 1; i <= IMAGE_PREFETCH_AHEAD; i++)
+    {
+        auto path = ImageAtOffset(i * _browsingDirection);
+        if (!path.empty())
         {
-            continue;
+            result.push_back(path);
+        }
+    }
+
+    for (int i = 1; i <= IMAGE_PREFETCH_BEHIND; i++)
+    {
+        auto path = ImageAtOffset(-i * _browsingDirection);
+        if (!path.empty())
+        {
+            result.push_back(path);
         }
-        if (foundCurrentEntry)
+    }
+
+    return result;
+}
+
+// Decoding happens on the worker pool, the current image stays visible until
+// the new one is ready. Images that already have a texture are not decoded again.
+void OpenImageWidget::RequestImages()
+{
+    std::vector<DecodeRequest> requests;
+
+    // The embedded thumbnail takes milliseconds, it is shown until the real
+    // decode is done
+    if (_isLoading && !_isShowingThumbnail && ImageDecoder::IsJpeg(_documentPath))
+    {
+        requests.push_back({_documentPath, DecodeRequest::EmbeddedThumbnail});
+    }
+
+    if (_isLoading)
+    {
+        requests.push_back({_documentPath, _decodeDimension});
+    }
+
+    if (_isLoadingFullResolution)
+    {
+        requests.push_back({_documentPath, 0});
+    }
+
+    for (const auto &path : PrefetchPaths())
+    {
+        if (FindTexture(path, _decodeDimension) == nullptr)
         {
-            _nextImage = dir_entry;
-            break;
+            requests.push_back({path, _decodeDimension});
         }
+    }
+
+    _decodedImageCache->Request(Id(), requests);
+}
 
-        if (dir_entry == _documentPath)
+// Called every frame on the GL thread, uploads the current image once it is
+// decoded and after that one prefetched image at a time
+void OpenImageWidget::UpdateTextures()
+{
+    if (_pendingTexture.textureId != 0)
+    {
+        if (!_textureCache->IsComplete(_pendingTexture))
         {
-            foundCurrentEntry = true;
-            continue;
+            return;
         }
 
-        _prevImage = dir_entry;
+        auto texture = _pendingTexture;
+        _pendingTexture = CachedTexture();
+
+        ShowTexture(texture, _pendingResetView);
     }
 
-    auto ext = _documentPath.extension().wstring();
+    std::shared_ptr<DecodedImage> image;
 
-    std::transform(
-        ext.begin(),
-        ext.end(),
-        ext.begin(),
-        [](unsigned char c) { return std::tolower(c); });
+    if (_isLoading && !_isShowingThumbnail)
+    {
+        DecodeRequest thumbnailRequest{_documentPath, DecodeRequest::EmbeddedThumbnail};
+
+        if (_decodedImageCache->Lookup(thumbnailRequest, image) == DecodeStates::Ready)
+        {
+            ShowTexture(_textureCache->Upload(thumbnailRequest, image), true);
+            _isLoading = true;
+        }
+    }
 
-    if (ext == L".jpg" || ext == L".jpeg")
+    if (_isLoading || _isLoadingFullResolution)
     {
-        _rotate = 0.0f;
+        DecodeRequest request{_documentPath, _isLoading ? _decodeDimension : 0};
 
-        auto file = fopen(_documentPath.string().c_str(), "rb");
+        auto state = _decodedImageCache->Lookup(request, image);
 
-        Cexif exif;
-        if (exif.DecodeExif(file))
+        if (state == DecodeStates::Ready && !_isLoading && NeedsTiling(*image))
         {
-            if (exif.m_exifinfo->Orientation == 1)
-            {
-                _rotate = 0.0;
-            }
-            else if (exif.m_exifinfo->Orientation == 8)
-            {
-                _rotate += -90.0 * 4.0 * atan(1.0) / 180.0;
-            }
-            else if (exif.m_exifinfo->Orientation == 3)
+            _isLoadingFullResolution = false;
+            _tiledImage = std::make_shared<TiledImage>(image);
+            _inspectedRequest = request;
+            _inspectedImage = image;
+            _tileQueue = std::make_shared<TileQueue>();
+        }
+        else if (state == DecodeStates::Ready)
+        {
+            ShowWhenUploaded(_textureCache->Upload(request, image), _isLoading);
+        }
+        else if (state == DecodeStates::Failed)
+        {
+            if (_isLoading)
             {
-                _rotate += 180.0 * 4.0 * atan(1.0) / 180.0;
+                _textureId = 0;
+                HoldTextures();
             }
-            else if (exif.m_exifinfo->Orientation == 6)
+
+            _isLoading = false;
+            _isLoadingFullResolution = false;
+        }
+        else if (state == DecodeStates::NotCached)
+        {
+            RequestImages();
+        }
+
+        return;
+    }
+
+    if (_textureCache->IsUploading())
+    {
+        return;
+    }
+
+    for (const auto &path : PrefetchPaths())
+    {
+        if (FindTexture(path, _decodeDimension) != nullptr)
+        {
+            continue;
+        }
+
+        DecodeRequest request{path, _decodeDimension};
+
+        if (_decodedImageCache->Lookup(request, image) == DecodeStates::Ready)
+        {
+            _textureCache->Upload(request, image);
+
+            return;
+        }
+    }
+}
+
+const CachedTexture *OpenImageWidget::FindTexture(
+    const std::filesystem::path &path,
+    int maxDimension)
+{
+    return _textureCache->Find({path, maxDimension});
+}
+
+void OpenImageWidget::ShowWhenUploaded(
+    const CachedTexture &texture,
+    bool resetView)
+{
+    if (_textureCache->IsComplete(texture))
+    {
+        ShowTexture(texture, resetView);
+
+        return;
+    }
+
+    _pendingTexture = texture;
+    _pendingResetView = resetView;
+
+    HoldTextures();
+}
+
+void OpenImageWidget::ShowTexture(
+    const CachedTexture &texture,
+    bool resetView)
+{
+    _isLoading = false;
+    _isShowingThumbnail = texture.maxDimension == DecodeRequest::EmbeddedThumbnail;
+    _textureId = texture.textureId;
+    _textureResolution = texture.size;
+    _textureIsReduced = texture.size.x < texture.imageSize.x;
+    _imageSize = texture.imageSize;
+    _inspectedRequest = DecodeRequest{texture.path, texture.maxDimension};
+    _inspectedImage = nullptr;
+
+    if (texture.maxDimension == 0)
+    {
+        _isLoadingFullResolution = false;
+    }
+
+    if (resetView)
+    {
+        _rotate = ImageDecoder::OrientationToRotation(texture.orientation);
+        _zoom = 1.0f;
+        _pan = ImVec2();
+    }
+
+    HoldTextures();
+}
+
+void OpenImageWidget::HoldTextures()
+{
+    _textureCache->Hold(Id(), {_textureId, _pendingTexture.textureId});
+}
+
+void OpenImageWidget::UpdateListing()
+{
+    // The pages of an archive are browsed as one sequence, subfolders included
+    std::filesystem::path archive, member;
+    _isInArchive = ImageArchive::Split(_documentPath, archive, member);
+
+    _listingGeneration = _exifIndex->Generation();
+    _listing = _imageDirectoryIndex->Get(_isInArchive ? archive : _documentPath.parent_path(), _listingOrder);
+    _imageIndex = _listing->IndexOf(_documentPath);
+}
+
+std::filesystem::path OpenImageWidget::ImageAtOffset(
+    int offset) const
+{
+    if (_listing == nullptr || _imageIndex < 0)
+    {
+        return std::filesystem::path();
+    }
+
+    auto index = _imageIndex + offset;
+    if (index < 0 || index >= static_cast<int>(_listing->Count()))
+    {
+        return std::filesystem::path();
+    }
+
+    return _listing->At(index);
+}
+
+void OpenImageWidget::UpdateInspectedImage()
+{
+    if (_inspectedImage != nullptr || _textureId == 0 || _inspectedRequest.path.empty())
+    {
+        return;
+    }
+
+    _decodedImageCache->Lookup(_inspectedRequest, _inspectedImage);
+}
+
+// Text on a dark box, readable on any image
+static void DrawLabel(
+    const ImVec2 &pos,
+    const std::string &text)
+{
+    auto drawList = ImGui::GetWindowDrawList();
+    auto padding = ImGui::GetStyle().FramePadding;
+    auto size = ImGui::CalcTextSize(text.c_str());
+
+    drawList->AddRectFilled(
+        pos,
+        ImVec2(pos.x + size.x + padding.x * 2.0f, pos.y + size.y + padding.y * 2.0f),
+        IM_COL32(0, 0, 0, 160),
+        ImGui::GetStyle().FrameRounding);
+    drawList->AddText(ImVec2(pos.x + padding.x, pos.y + padding.y), IM_COL32_WHITE, text.c_str());
+}
+
+void OpenImageWidget::RenderHistogram(
+    const ImVec2 &pos)
+{
+    if (_inspectedImage == nullptr)
+    {
+        return;
+    }
+
+    auto histogram = _histogramCache->Get(_inspectedRequest, _inspectedImage);
+
+    auto drawList = ImGui::GetWindowDrawList();
+    auto bottom = pos.y + IMAGE_HISTOGRAM_HEIGHT;
+    auto binWidth = IMAGE_HISTOGRAM_WIDTH / 256.0f;
+
+    drawList->AddRectFilled(
+        pos,
+        ImVec2(pos.x + IMAGE_HISTOGRAM_WIDTH, bottom),
+        IM_COL32(0, 0, 0, 160),
+        ImGui::GetStyle().FrameRounding);
+
+    if (histogram.countedPixels == 0)
+    {
+        DrawLabel(pos, "Counting...");
+
+        return;
+    }
+
+    // Clipped shadows and highlights pile up in the outer bins, they are
+    // left out of the scale so they don't flatten the rest
+    uint32_t peak = 1;
+    for (int channel = 0; channel < 3; channel++)
+    {
+        for (int bin = 1; bin < 255; bin++)
+        {
+            peak = std::max(peak, histogram.counts[channel * 256 + bin]);
+        }
+    }
+
+    static const ImU32 colors[] = {
+        IM_COL32(255, 64, 64, 110),
+        IM_COL32(64, 255, 64, 110),
+        IM_COL32(64, 128, 255, 110),
+    };
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+        for (int bin = 0; bin < 256; bin++)
+        {
+            auto count = histogram.counts[channel * 256 + bin];
+            if (count == 0)
             {
-                _rotate += 90.0 * 4.0 * atan(1.0) / 180.0;
+                continue;
             }
+
+            auto height = std::min(1.0f, static_cast<float>(count) / peak) * IMAGE_HISTOGRAM_HEIGHT;
+
+            drawList->AddRectFilled(
+                ImVec2(pos.x + bin * binWidth, bottom - height),
+                ImVec2(pos.x + (bin + 1) * binWidth, bottom),
+                colors[channel]);
         }
+    }
 
-        fclose(file);
+    if (!histogram.IsComplete())
+    {
+        DrawLabel(pos, fmt::format("{}%", histogram.countedPixels * 100 / histogram.totalPixels));
     }
 }
 
+void OpenImageWidget::RenderPixelReadout(
+    const ImVec2 &center,
+    const ImVec2 &size,
+    const ImVec2 &pos)
+{
+    auto mouse = ImGui::GetIO().MousePos;
+    auto dx = mouse.x - center.x;
+    auto dy = mouse.y - center.y;
+    auto cosA = cosf(_rotate);
+    auto sinA = sinf(_rotate);
+
+    // Back from the screen to the unrotated image, 0..1 on both axes
+    auto u = (dx * cosA + dy * sinA) / size.x + 0.5f;
+    auto v = (dy * cosA - dx * sinA) / size.y + 0.5f;
+    if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+    {
+        return;
+    }
+
+    auto x = static_cast<int>(u * _imageSize.x);
+    auto y = static_cast<int>(v * _imageSize.y);
+
+    if (_inspectedImage == nullptr)
+    {
+        DrawLabel(pos, fmt::format("{}, {}", x, y));
+
+        return;
+    }
+
+    // A reduced image gives the average of the pixels it stands for
+    auto px = std::min(static_cast<int>(u * _inspectedImage->Width()), _inspectedImage->Width() - 1);
+    auto py = std::min(static_cast<int>(v * _inspectedImage->Height()), _inspectedImage->Height() - 1);
+    auto pixel = _inspectedImage->Pixels() + (static_cast<size_t>(py) * _inspectedImage->Width() + px) * 4;
+
+    DrawLabel(pos, fmt::format("{}, {}   R {}  G {}  B {}  A {}", x, y, pixel[0], pixel[1], pixel[2], pixel[3]));
+
+    auto swatch = ImGui::GetTextLineHeight();
+    auto swatchPos = ImVec2(pos.x, pos.y + swatch + ImGui::GetStyle().FramePadding.y * 2.0f + ImGui::GetStyle().ItemSpacing.y);
+
+    ImGui::GetWindowDrawList()->AddRectFilled(
+        swatchPos,
+        ImVec2(swatchPos.x + swatch * 2.0f, swatchPos.y + swatch),
+        IM_COL32(pixel[0], pixel[1], pixel[2], 255));
+}
+
 namespace ImGui
 {
 #include <math.h>
@@ -122,7 +482,7 @@ namespace ImGui
     {
         return ImVec2(v.x * cos_a - v.y * sin_a, v.x * sin_a + v.y * cos_a);
     }
-    void ImageRotated(ImTextureID tex_id, ImVec2 center, ImVec2 size, float angle)
+    void ImageRotated(ImTextureID tex_id, ImVec2 center, ImVec2 size, float angle, ImVec2 uvMin = ImVec2(0.0f, 0.0f), ImVec2 uvMax = ImVec2(1.0f, 1.0f))
     {
         ImDrawList *draw_list = ImGui::GetWindowDrawList();
 
@@ -136,19 +496,233 @@ namespace ImGui
                 center + ImRotate(ImVec2(-size.x * 0.5f, +size.y * 0.5f), cos_a, sin_a)};
         ImVec2 uvs[4] =
             {
-                ImVec2(0.0f, 0.0f),
-                ImVec2(1.0f, 0.0f),
-                ImVec2(1.0f, 1.0f),
-                ImVec2(0.0f, 1.0f)};
+                uvMin,
+                ImVec2(uvMax.x, uvMin.y),
+                uvMax,
+                ImVec2(uvMin.x, uvMax.y)};
 
         draw_list->AddImageQuad(tex_id, pos[0], pos[1], pos[2], pos[3], uvs[0], uvs[1], uvs[2], uvs[3], IM_COL32_WHITE);
     }
+    // Draws a texture over the part regionMin-regionMax (0..1) of a rotated image
+    void ImageRotatedRegion(ImTextureID tex_id, ImVec2 center, ImVec2 size, float angle, ImVec2 regionMin, ImVec2 regionMax)
+    {
+        ImDrawList *draw_list = ImGui::GetWindowDrawList();
+
+        float cos_a = cosf(angle);
+        float sin_a = sinf(angle);
+        ImVec2 pos[4] =
+            {
+                center + ImRotate(ImVec2((regionMin.x - 0.5f) * size.x, (regionMin.y - 0.5f) * size.y), cos_a, sin_a),
+                center + ImRotate(ImVec2((regionMax.x - 0.5f) * size.x, (regionMin.y - 0.5f) * size.y), cos_a, sin_a),
+                center + ImRotate(ImVec2((regionMax.x - 0.5f) * size.x, (regionMax.y - 0.5f) * size.y), cos_a, sin_a),
+                center + ImRotate(ImVec2((regionMin.x - 0.5f) * size.x, (regionMax.y - 0.5f) * size.y), cos_a, sin_a)};
+
+        draw_list->AddImageQuad(tex_id, pos[0], pos[1], pos[2], pos[3], ImVec2(0.0f, 0.0f), ImVec2(1.0f, 0.0f), ImVec2(1.0f, 1.0f), ImVec2(0.0f, 1.0f), IM_COL32_WHITE);
+    }
 } // namespace ImGui
 
+// Large images are not uploaded as one texture, they would not fit in
+// GL_MAX_TEXTURE_SIZE or take too much VRAM. They are shown as tiles instead.
+bool OpenImageWidget::NeedsTiling(
+    const DecodedImage &image) const
+{
+    static GLint maxTextureSize = 0;
+    if (maxTextureSize == 0)
+    {
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    }
+
+    auto longest = std::max(image.Width(), image.Height());
+
+    return longest > IMAGE_TILING_THRESHOLD || longest > maxTextureSize;
+}
+
+void OpenImageWidget::ClearTiles()
+{
+    if (_tileQueue != nullptr)
+    {
+        _tileQueue->isCancelled = true;
+    }
+
+    for (auto &tile : _tiles)
+    {
+        _textureUploader->DeleteTexture(tile.second.textureId);
+    }
+
+    _tiles.clear();
+    _pendingTiles.clear();
+    _tiledImage = nullptr;
+    _tileQueue = nullptr;
+    _inspectedImage = nullptr;
+}
+
+// Draws the tiles that intersect the clip rectangle, on the level that
+// matches the zoom. Missing tiles are made on the worker pool, until they
+// arrive the reduced texture below them stays visible.
+void OpenImageWidget::RenderTiles(
+    const ImVec2 &center,
+    const ImVec2 &size,
+    const ImVec2 &clipMin,
+    const ImVec2 &clipMax)
+{
+    _frame++;
+
+    UploadReadyTiles();
+
+    auto level = _tiledImage->LevelForScale(size.x / _tiledImage->Width());
+
+    // Map the corners of the clip rectangle back onto the unrotated image
+    auto cosA = std::cos(-_rotate);
+    auto sinA = std::sin(-_rotate);
+    float minX = 1.0f, minY = 1.0f, maxX = 0.0f, maxY = 0.0f;
+    ImVec2 corners[4] = {clipMin, ImVec2(clipMax.x, clipMin.y), clipMax, ImVec2(clipMin.x, clipMax.y)};
+
+    for (const auto &corner : corners)
+    {
+        auto dx = corner.x - center.x;
+        auto dy = corner.y - center.y;
+        auto u = (dx * cosA - dy * sinA) / size.x + 0.5f;
+        auto v = (dx * sinA + dy * cosA) / size.y + 0.5f;
+
+        minX = std::min(minX, u);
+        minY = std::min(minY, v);
+        maxX = std::max(maxX, u);
+        maxY = std::max(maxY, v);
+    }
+
+    auto tileSpan = static_cast<float>(TiledImage::TileSize << level);
+    auto firstX = std::max(0, static_cast<int>(minX * _tiledImage->Width() / tileSpan));
+    auto firstY = std::max(0, static_cast<int>(minY * _tiledImage->Height() / tileSpan));
+    auto lastX = std::min(_tiledImage->TilesX(level) - 1, static_cast<int>(maxX * _tiledImage->Width() / tileSpan));
+    auto lastY = std::min(_tiledImage->TilesY(level) - 1, static_cast<int>(maxY * _tiledImage->Height() / tileSpan));
+
+    for (int y = firstY; y <= lastY; y++)
+    {
+        for (int x = firstX; x <= lastX; x++)
+        {
+            TileKey key{level, x, y};
+
+            auto found = _tiles.find(key);
+            if (found == _tiles.end())
+            {
+                if (_pendingTiles.size() < IMAGE_MAX_PENDING_TILES && _pendingTiles.insert(key).second)
+                {
+                    _workerPool->Enqueue([tiledImage = _tiledImage, tileQueue = _tileQueue, frameScheduler = _frameScheduler, key]() {
+                        if (tileQueue->isCancelled)
+                        {
+                            return;
+                        }
+
+                        auto tile = tiledImage->RenderTile(key.level, key.x, key.y);
+
+                        {
+                            std::lock_guard<std::mutex> lock(tileQueue->mutex);
+                            tileQueue->readyTiles.push_back(std::make_pair(key, tile));
+                        }
+
+                        frameScheduler->RequestFrame();
+                    });
+                }
+
+                continue;
+            }
+
+            found->second.lastUsedFrame = _frame;
+
+            int left, top, right, bottom;
+            _tiledImage->TileBounds(level, x, y, left, top, right, bottom);
+
+            ImGui::ImageRotatedRegion(
+                (void *)(intptr_t)(GLuint)found->second.textureId,
+                center,
+                size,
+                _rotate,
+                ImVec2(static_cast<float>(left) / _tiledImage->Width(), static_cast<float>(top) / _tiledImage->Height()),
+                ImVec2(static_cast<float>(right) / _tiledImage->Width(), static_cast<float>(bottom) / _tiledImage->Height()));
+        }
+    }
+
+    EvictTiles();
+}
+
+void OpenImageWidget::UploadReadyTiles()
+{
+    std::vector<std::pair<TileKey, std::shared_ptr<DecodedImage>>> readyTiles;
+
+    {
+        std::lock_guard<std::mutex> lock(_tileQueue->mutex);
+
+        auto count = std::min<size_t>(_tileQueue->readyTiles.size(), IMAGE_TILE_UPLOADS_PER_FRAME);
+        readyTiles.assign(_tileQueue->readyTiles.begin(), _tileQueue->readyTiles.begin() + count);
+        _tileQueue->readyTiles.erase(_tileQueue->readyTiles.begin(), _tileQueue->readyTiles.begin() + count);
+    }
+
+    for (const auto &readyTile : readyTiles)
+    {
+        _pendingTiles.erase(readyTile.first);
+
+        if (readyTile.second == nullptr)
+        {
+            continue;
+        }
+
+        // Tiles are small enough to be uploaded right away
+        TileTexture tile;
+        tile.lastUsedFrame = _frame;
+        tile.textureId = _textureUploader->Begin(readyTile.second, false);
+
+        _tiles[readyTile.first] = tile;
+    }
+}
+
+// Tiles drawn this frame are never evicted, the others go least recently
+// used first
+void OpenImageWidget::EvictTiles()
+{
+    const size_t tileBytes = static_cast<size_t>(TiledImage::TileSize) * TiledImage::TileSize * 4;
+
+    while (_tiles.size() * tileBytes > IMAGE_TILE_BUDGET)
+    {
+        auto oldest = _tiles.end();
+        for (auto it = _tiles.begin(); it != _tiles.end(); ++it)
+        {
+            if (it->second.lastUsedFrame < _frame && (oldest == _tiles.end() || it->second.lastUsedFrame < oldest->second.lastUsedFrame))
+            {
+                oldest = it;
+            }
+        }
+
+        if (oldest == _tiles.end())
+        {
+            return;
+        }
+
+        _textureUploader->DeleteTexture(oldest->second.textureId);
+        _tiles.erase(oldest);
+    }
+}
+
 void OpenImageWidget::OnRender()
 {
     const float buttonSize = 40.f;
 
+    // The EXIF scan of the directory may still be running, the order is
+    // updated as capture times come in
+    if (_listingOrder == ImageOrders::CaptureTime && _listingGeneration != _exifIndex->Generation())
+    {
+        UpdateListing();
+    }
+
+    UpdateTextures();
+
+    _animationPlayer->Update();
+
+    auto isAnimating = _animationPlayer->IsPlaying();
+    if (isAnimating)
+    {
+        _imageSize = _animationPlayer->Size();
+    }
+
     ImGui::Begin(ConstructWindowID().c_str(), &_isOpen, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
 
     auto available = ImGui::GetContentRegionAvail();
@@ -164,7 +738,9 @@ void OpenImageWidget::OnRender()
         available.x,
         available.y - (buttonSize + ImGui::GetStyle().ItemSpacing.y + ImGui::GetStyle().ItemSpacing.y));
 
-    auto scale = ImVec2(availableForImage.x / _textureSize.x, availableForImage.y / _textureSize.y);
+    _viewportSize = availableForImage;
+
+    auto scale = ImVec2(availableForImage.x / _imageSize.x, availableForImage.y / _imageSize.y);
     if (scale.x < scale.y)
     {
         scale.y = scale.x;
@@ -181,7 +757,8 @@ void OpenImageWidget::OnRender()
 
     ImGui::InvisibleButton("###panning", availableForImage);
 
-    if (ImGui::IsItemHovered())
+    auto isImageHovered = ImGui::IsItemHovered();
+    if (isImageHovered)
     {
         _zoom += (ImGui::GetIO().MouseWheel / 10.0f);
         if (_zoom < 0.1f) _zoom = 0.1f;
@@ -190,6 +767,10 @@ void OpenImageWidget::OnRender()
         {
             _rotate += 90.0 * 4.0 * atan(1.0) / 180.0;
         }
+        if (ImGui::IsKeyPressed(ImGuiKey_I))
+        {
+            _isInspecting = !_isInspecting;
+        }
     }
     if (ImGui::IsItemActive() && ImGui::IsMouseDown(ImGuiMouseButton_Left))
     {
@@ -198,8 +779,15 @@ void OpenImageWidget::OnRender()
     }
 
     auto imageSize = ImVec2(
-        scale.x * _textureSize.x,
-        scale.y * _textureSize.y);
+        scale.x * _imageSize.x,
+        scale.y * _imageSize.y);
+
+    // Zoomed in past the resolution of the reduced texture
+    if (_textureIsReduced && _tiledImage == nullptr && !_isLoading && !_isLoadingFullResolution && imageSize.x > _textureResolution.x)
+    {
+        _isLoadingFullResolution = true;
+        RequestImages();
+    }
 
     auto imagePos = ImVec2(
         spos.x + _pan.x + (availableForImage.x - imageSize.x) / 2.0f,
@@ -207,18 +795,67 @@ void OpenImageWidget::OnRender()
 
     ImGui::SetCursorPos(imagePos);
 
-    ImGui::ImageRotated(
-        (void *)(intptr_t)(GLuint)_textureId,
-        ImVec2(imagePos.x + (imageSize.x / 2.0f), imagePos.y + (imageSize.y / 2.0f)),
-        imageSize,
-        _rotate);
+    if (isAnimating)
+    {
+        ImVec2 uvMin, uvMax;
+        _animationPlayer->CurrentFrame(uvMin, uvMax);
+
+        ImGui::ImageRotated(
+            (void *)(intptr_t)(GLuint)_animationPlayer->TextureId(),
+            ImVec2(imagePos.x + (imageSize.x / 2.0f), imagePos.y + (imageSize.y / 2.0f)),
+            imageSize,
+            _rotate,
+            uvMin,
+            uvMax);
+    }
+    else
+    {
+        ImGui::ImageRotated(
+            (void *)(intptr_t)(GLuint)_textureId,
+            ImVec2(imagePos.x + (imageSize.x / 2.0f), imagePos.y + (imageSize.y / 2.0f)),
+            imageSize,
+            _rotate);
+    }
+
+    if (_tiledImage != nullptr && !isAnimating && imageSize.x > _textureResolution.x)
+    {
+        RenderTiles(
+            ImVec2(imagePos.x + (imageSize.x / 2.0f), imagePos.y + (imageSize.y / 2.0f)),
+            imageSize,
+            spos,
+            ImVec2(spos.x + availableForImage.x, spos.y + availableForImage.y));
+    }
+
+    if (_isLoading && !isAnimating)
+    {
+        ImGui::SetCursorScreenPos(spos);
+        ImGui::TextDisabled("Loading %s...", Convert(_documentPath.filename().wstring()).c_str());
+    }
+
+    // The frames of an animation are not decoded images, there is nothing to inspect
+    if (_isInspecting && !isAnimating && _textureId != 0)
+    {
+        auto margin = ImGui::GetStyle().ItemSpacing;
+
+        UpdateInspectedImage();
+
+        RenderHistogram(ImVec2(spos.x + availableForImage.x - IMAGE_HISTOGRAM_WIDTH - margin.x, spos.y + margin.y));
+
+        if (isImageHovered)
+        {
+            RenderPixelReadout(
+                ImVec2(imagePos.x + (imageSize.x / 2.0f), imagePos.y + (imageSize.y / 2.0f)),
+                imageSize,
+                ImVec2(spos.x + margin.x, spos.y + margin.y));
+        }
+    }
 
     ImGui::SetCursorPos(
         ImVec2(ImGui::GetStyle().ItemSpacing.y,
                available.y - ImGui::GetStyle().ItemSpacing.y));
     {
         StyleGuard style;
-        if (_prevImage.empty())
+        if (ImageAtOffset(-1).empty())
         {
             style.Push(ImGuiCol_Text, IM_COL32(0, 0, 0, 55));
         }
@@ -228,6 +865,39 @@ void OpenImageWidget::OnRender()
         }
     }
 
+    if (_listing != nullptr && _imageIndex >= 0)
+    {
+        ImGui::SetCursorPos(
+            ImVec2(ImGui::GetStyle().ItemSpacing.y * 2 + buttonSize,
+                   available.y - ImGui::GetStyle().ItemSpacing.y + (buttonSize - ImGui::GetFrameHeight()) / 2.0f));
+
+        // One based position of the image in its folder, enter another to jump there
+        auto position = _imageIndex + 1;
+        ImGui::SetNextItemWidth(80.0f);
+        if (ImGui::InputInt("###position", &position, 0, 0, ImGuiInputTextFlags_EnterReturnsTrue))
+        {
+            OpenImageInParentDirectory(position - 1);
+        }
+        ImGui::SameLine();
+        ImGui::Text("/ %d", static_cast<int>(_listing->Count()));
+
+        // Archives are always in page order
+        if (!_isInArchive)
+        {
+            ImGui::SameLine();
+            if (ImGui::Button(_listingOrder == ImageOrders::CaptureTime ? ICON_MD_SORT_BY_ALPHA : ICON_MD_SCHEDULE))
+            {
+                _listingOrder = _listingOrder == ImageOrders::CaptureTime ? ImageOrders::Name : ImageOrders::CaptureTime;
+                UpdateListing();
+                RequestImages();
+            }
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip(_listingOrder == ImageOrders::CaptureTime ? "Sort by name" : "Sort by capture time");
+            }
+        }
+    }
+
     ImGui::SetCursorPos(
         ImVec2(available.x / 2.0f + 1,
                available.y - ImGui::GetStyle().ItemSpacing.y));
@@ -248,12 +918,31 @@ void OpenImageWidget::OnRender()
         _rotate += 90.0 * 4.0 * atan(1.0) / 180.0;
     }
 
+    ImGui::SetCursorPos(
+        ImVec2(available.x - buttonSize * 2.0f,
+               available.y - ImGui::GetStyle().ItemSpacing.y));
+    {
+        StyleGuard style;
+        if (_isInspecting)
+        {
+            style.Push(ImGuiCol_Button, ImGui::GetColorU32(ImGuiCol_ButtonActive));
+        }
+        if (ImGui::Button(ICON_MD_BAR_CHART, ImVec2(buttonSize, buttonSize)))
+        {
+            _isInspecting = !_isInspecting;
+        }
+    }
+    if (ImGui::IsItemHovered())
+    {
+        ImGui::SetTooltip("Histogram and pixel values (I)");
+    }
+
     ImGui::SetCursorPos(
         ImVec2(available.x + ImGui::GetStyle().ItemSpacing.y - buttonSize,
                available.y - ImGui::GetStyle().ItemSpacing.y));
     {
         StyleGuard style;
-        if (_nextImage.empty())
+        if (ImageAtOffset(1).empty())
         {
             style.Push(ImGuiCol_Text, IM_COL32(0, 0, 0, 55));
         }
@@ -285,43 +974,45 @@ void OpenImageWidget::OnRender()
 
 void OpenImageWidget::OpenPreviousImageInParentDirectory()
 {
-    if (_prevImage.empty())
+    auto path = ImageAtOffset(-1);
+    if (path.empty())
     {
         return;
     }
 
-    Open(_prevImage);
+    _browsingDirection = -1;
+
+    Open(path);
 }
 
 void OpenImageWidget::OpenNextImageInParentDirectory()
 {
-    if (_nextImage.empty())
+    auto path = ImageAtOffset(1);
+    if (path.empty())
     {
         return;
     }
 
-    Open(_nextImage);
+    _browsingDirection = 1;
+
+    Open(path);
+}
+
+void OpenImageWidget::OpenImageInParentDirectory(
+    int index)
+{
+    if (_listing == nullptr || index < 0 || index >= static_cast<int>(_listing->Count()))
+    {
+        return;
+    }
+
+    _browsingDirection = index < _imageIndex ? -1 : 1;
+
+    Open(_listing->At(index));
 }
+
 bool OpenImageWidget::IsImage(
     const std::filesystem::path &path)
 {
-    auto ext = path.extension().wstring();
-
-    std::transform(
-        ext.begin(),
-        ext.end(),
-        ext.begin(),
-        [](unsigned char c) { return std::tolower(c); });
-
-    if (ext == L".png") return true;
-    if (ext == L".jpg") return true;
-    if (ext == L".jpeg") return true;
-    if (ext == L".bmp") return true;
-    if (ext == L".gif") return true;
-    if (ext == L".tga") return true;
-    if (ext == L".pic") return true;
-    if (ext == L".ppm") return true;
-    if (ext == L".pgm") return true;
-
-    return false;
+    return ImageDecoder::IsSupported(path);
 }
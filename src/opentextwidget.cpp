@@ -1,7 +1,11 @@
 #include "opentextwidget.h"
 
 #include <IconsMaterialDesign.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
 #include <fstream>
+#include <string>
 #include <imgui.h>
 
 OpenTextWidget::OpenTextWidget(
@@ -10,29 +14,159 @@ OpenTextWidget::OpenTextWidget(
     ImFont *monoSpaceFont)
     : OpenDocument(index, services),
       _monoSpaceFont(monoSpaceFont)
-{}
+{
+    _workerPool = services->Resolve<WorkerPool *>();
+    _frameScheduler = services->Resolve<FrameScheduler *>();
+    _lineIndex = std::make_unique<LineIndex>(_workerPool, _frameScheduler);
+}
+
+OpenTextWidget::~OpenTextWidget()
+{
+    CloseFile();
+}
 
 void OpenTextWidget::OnPathChanged(
     const std::filesystem::path &oldPath)
 {
-    std::ifstream t(_documentPath);
+    CloseFile();
+
+    _error.clear();
+    _cursor = 0;
+    _anchor = 0;
+    _cursorX = 0.0f;
+
+    OpenFile();
+}
+
+void OpenTextWidget::OpenFile()
+{
+    // Even mapping can take a while on a network mount
+    _openJob = std::make_shared<OpenJob>();
+    _openJob->path = _documentPath;
+
+    _workerPool->Enqueue([openJob = _openJob, frameScheduler = _frameScheduler]() {
+        OpenInBackground(openJob, frameScheduler);
+    });
+}
+
+void OpenTextWidget::CloseFile()
+{
+    if (_openJob != nullptr)
+    {
+        _openJob->isCancelled = true;
+        _openJob = nullptr;
+    }
+
+    _text.Close();
+    _lineIndex->Close();
+    _file = nullptr;
+}
+
+void OpenTextWidget::UpdateOpenJob()
+{
+    if (_openJob == nullptr)
+    {
+        return;
+    }
+
+    std::shared_ptr<MappedFile> file;
+
+    {
+        std::lock_guard<std::mutex> lock(_openJob->mutex);
+
+        if (!_openJob->isDone)
+        {
+            return;
+        }
+
+        file = std::move(_openJob->file);
+    }
+
+    _openJob = nullptr;
+
+    if (file == nullptr)
+    {
+        _error = "Could not open the file";
+
+        return;
+    }
+
+    _file = file;
+    _lineIndex->Open(file);
+}
+
+void OpenTextWidget::OpenInBackground(
+    std::shared_ptr<OpenJob> openJob,
+    FrameScheduler *frameScheduler)
+{
+    if (openJob->isCancelled)
+    {
+        return;
+    }
+
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(openJob->path))
+    {
+        file = nullptr;
+    }
 
-    auto str = std::string(
-        (std::istreambuf_iterator<char>(t)),
-        std::istreambuf_iterator<char>());
+    std::lock_guard<std::mutex> lock(openJob->mutex);
 
-    _content.resize(str.size() + 1);
-    memcpy(_content.Data, str.data(), str.size());
-    _content.Data[str.size()] = 0;
+    openJob->file = std::move(file);
+    openJob->isDone = true;
+
+    if (!openJob->isCancelled)
+    {
+        frameScheduler->RequestFrame();
+    }
 }
 
 void OpenTextWidget::SaveFile()
 {
-    std::ofstream t(_documentPath);
+    if (!_text.IsOpen() || !_text.IsModified())
+    {
+        return;
+    }
+
+    // The file is still mapped, so the text is written next to it and
+    // replaces it once the mapping is closed
+    auto savingPath = _documentPath;
+    savingPath += ".saving";
+
+    {
+        std::ofstream file(savingPath, std::ios::binary);
+        _text.Write(file);
+
+        if (!file)
+        {
+            file.close();
+
+            std::error_code ec;
+            std::filesystem::remove(savingPath, ec);
 
-    t << _content.Data;
+            _error = "Could not save the file";
 
-    _isDirty = false;
+            return;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::permissions(savingPath, std::filesystem::status(_documentPath, ec).permissions(), ec);
+
+    CloseFile();
+
+    std::filesystem::rename(savingPath, _documentPath, ec);
+    if (ec)
+    {
+        _error = "Could not replace the file, it was saved as " + savingPath.filename().string();
+    }
+    else
+    {
+        _error.clear();
+    }
+
+    // The saved file is the new original, undo starts over
+    OpenFile();
 }
 
 void OpenTextWidget::SaveFileAs()
@@ -45,53 +179,670 @@ void OpenTextWidget::OnRender()
 
     RenderButton(
         ICON_MD_SAVE,
-        !_isDirty,
+        !_text.IsModified(),
         [&]() { SaveFile(); });
 
     ImGui::SameLine();
 
     RenderButton(
         ICON_MD_SAVE_AS,
-        false,
+        !_text.IsOpen(),
         [&]() { SaveFileAs(); });
 
+    ImGui::SameLine();
+
+    RenderButton(
+        ICON_MD_UNDO,
+        !_text.CanUndo(),
+        [&]() {
+            _cursor = _anchor = _text.Undo();
+            _scrollToCursor = true;
+        });
+
+    ImGui::SameLine();
+
+    RenderButton(
+        ICON_MD_REDO,
+        !_text.CanRedo(),
+        [&]() {
+            _cursor = _anchor = _text.Redo();
+            _scrollToCursor = true;
+        });
+
+    RenderText();
+
+    ImGui::End();
+}
+
+void OpenTextWidget::RenderText()
+{
+    UpdateOpenJob();
+
+    _lineIndex->Update();
+
+    if (!_text.IsOpen() && _file != nullptr && _lineIndex->IsComplete())
+    {
+        _text.Open(reinterpret_cast<const char *>(_file->Data()), _lineIndex->Size(), _lineIndex.get());
+        _cursor = std::min(_cursor, _text.Length());
+        _anchor = std::min(_anchor, _text.Length());
+
+        // New lines are typed the way the file has them
+        auto isCrLf = _lineIndex->LineCount() > 1 && _lineIndex->LineEnd(0) + 1 < _lineIndex->LineStart(1);
+        _lineBreak = isCrLf ? "\r\n" : "\n";
+    }
+
+    if (!_error.empty())
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", _error.c_str());
+    }
+    else if (!_text.IsOpen())
+    {
+        ImGui::SameLine();
+        RenderProgress();
+
+        ImGui::SameLine();
+        ImGui::TextDisabled("Read only");
+    }
+
+    // Lines that are not indexed yet can't be jumped to
+    auto lineCount = _text.IsOpen() ? _text.LineCount() : _lineIndex->LineCount();
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(120.0f);
+    if (ImGui::InputInt("Line###goToLine", &_goToLine, 0, 0, ImGuiInputTextFlags_EnterReturnsTrue))
+    {
+        _goToLine = std::clamp(_goToLine, 1, static_cast<int>(std::min(lineCount, static_cast<size_t>(INT_MAX))));
+        _scrollToLine = _goToLine - 1;
+
+        if (_text.IsOpen())
+        {
+            _cursor = _anchor = _text.LineStart(_scrollToLine);
+            _cursorX = 0.0f;
+        }
+    }
+
     ImGui::PushFont(_monoSpaceFont);
 
-    struct Funcs
+    ImGui::BeginChild("###text", ImGui::GetContentRegionAvail(), false, ImGuiWindowFlags_HorizontalScrollbar);
+
+    auto lineHeight = ImGui::GetTextLineHeightWithSpacing();
+    if (_scrollToLine >= 0)
+    {
+        ImGui::SetScrollY(_scrollToLine * lineHeight);
+        _scrollToLine = -1;
+    }
+
+    auto isFocused = _text.IsOpen() && ImGui::IsWindowFocused();
+    if (isFocused)
+    {
+        HandleKeyboard(static_cast<size_t>(std::max(ImGui::GetWindowHeight() / lineHeight - 1.0f, 1.0f)));
+    }
+
+    auto drawnLineCount = _file != nullptr ? std::min(_text.IsOpen() ? _text.LineCount() : _lineIndex->EstimatedLineCount(), static_cast<size_t>(INT_MAX)) : 0;
+    auto gutterDigits = std::to_string(drawnLineCount);
+    auto gutterWidth = ImGui::CalcTextSize(gutterDigits.c_str()).x + ImGui::GetStyle().ItemSpacing.x;
+    auto cursorLine = _text.IsOpen() ? _text.LineOf(_cursor) : 0;
+    auto origin = ImGui::GetCursorScreenPos();
+
+    // A click puts the cursor at the closest character and dragging selects
+    // up to where the mouse is, the scrollbars are not part of the text
+    auto mouse = ImGui::GetMousePos();
+    auto windowPos = ImGui::GetWindowPos();
+    auto contentMax = ImGui::GetWindowContentRegionMax();
+    auto isClicked = _text.IsOpen() && ImGui::IsWindowHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left) && mouse.x < windowPos.x + contentMax.x && mouse.y < windowPos.y + contentMax.y;
+    if (!ImGui::IsMouseDown(ImGuiMouseButton_Left))
+    {
+        _isMouseSelecting = false;
+    }
+    if (isClicked || (_isMouseSelecting && _text.IsOpen()))
+    {
+        auto line = static_cast<size_t>(std::max((mouse.y - origin.y) / lineHeight, 0.0f));
+
+        _cursorX = mouse.x - origin.x - gutterWidth;
+        MoveCursorToLine(line);
+
+        if (isClicked && !ImGui::GetIO().KeyShift)
+        {
+            _anchor = _cursor;
+        }
+
+        _isMouseSelecting = true;
+        cursorLine = _text.LineOf(_cursor);
+    }
+
+    auto selectionBegin = std::min(_anchor, _cursor);
+    auto selectionEnd = std::max(_anchor, _cursor);
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(drawnLineCount), lineHeight);
+    while (clipper.Step())
     {
-        static int MyResizeCallback(ImGuiInputTextCallbackData *data)
+        for (int line = clipper.DisplayStart; line < clipper.DisplayEnd; line++)
         {
-            if (data->EventFlag == ImGuiInputTextFlags_CallbackResize)
+            // Not indexed yet
+            if (!_text.IsOpen() && static_cast<size_t>(line) >= _lineIndex->LineCount())
+            {
+                ImGui::TextUnformatted("");
+                continue;
+            }
+
+            ImGui::TextDisabled("%*d", static_cast<int>(gutterDigits.size()), line + 1);
+            ImGui::SameLine();
+
+            auto text = LineText(line);
+            auto textPos = ImGui::GetCursorScreenPos();
+
+            if (_text.IsOpen() && selectionBegin < selectionEnd)
             {
-                ImVector<char> *my_str = (ImVector<char> *)data->UserData;
-                IM_ASSERT(my_str->begin() == data->Buf);
-                my_str->resize(data->BufSize); // NB: On resizing calls, generally data->BufSize == data->BufTextLen + 1
-                data->Buf = my_str->begin();
+                RenderSelection(line, text, textPos, selectionBegin, selectionEnd);
+            }
+
+            ImGui::TextUnformatted(text.data(), text.data() + text.size());
+
+            if (isFocused && static_cast<size_t>(line) == cursorLine)
+            {
+                auto column = std::min(_cursor - _text.LineStart(line), text.size());
+                auto caretX = textPos.x + ImGui::CalcTextSize(text.data(), text.data() + column).x;
+
+                ImGui::GetWindowDrawList()->AddLine(
+                    ImVec2(caretX, textPos.y),
+                    ImVec2(caretX, textPos.y + ImGui::GetTextLineHeight()),
+                    ImGui::GetColorU32(ImGuiCol_Text));
+
+                if (_scrollToCursor)
+                {
+                    auto x = caretX - origin.x;
+                    if (x < ImGui::GetScrollX())
+                    {
+                        ImGui::SetScrollX(std::max(x - gutterWidth, 0.0f));
+                    }
+                    else if (x > ImGui::GetScrollX() + contentMax.x - lineHeight)
+                    {
+                        ImGui::SetScrollX(x - contentMax.x + lineHeight);
+                    }
+                }
             }
-            return 0;
         }
+    }
+    clipper.End();
 
-        // Note: Because ImGui:: is a namespace you would typically add your own function into the namespace.
-        // For example, you code may declare a function 'ImGui::InputText(const char* label, MyString* my_str)'
-        static bool MyInputTextMultiline(const char *label, ImVector<char> *my_str, const ImVec2 &size = ImVec2(0, 0), ImGuiInputTextFlags flags = 0)
+    if (_scrollToCursor)
+    {
+        auto y = cursorLine * lineHeight;
+        if (y < ImGui::GetScrollY())
+        {
+            ImGui::SetScrollY(y);
+        }
+        else if (y + 2 * lineHeight > ImGui::GetScrollY() + ImGui::GetWindowHeight())
         {
-            IM_ASSERT((flags & ImGuiInputTextFlags_CallbackResize) == 0);
-            return ImGui::InputTextMultiline(label, my_str->begin(), (size_t)my_str->size(), size, flags | ImGuiInputTextFlags_CallbackResize, Funcs::MyResizeCallback, (void *)my_str);
+            ImGui::SetScrollY(y + 2 * lineHeight - ImGui::GetWindowHeight());
         }
+
+        _scrollToCursor = false;
+    }
+
+    ImGui::EndChild();
+
+    ImGui::PopFont();
+}
+
+void OpenTextWidget::RenderProgress()
+{
+    auto progressSize = ImVec2(160.0f, 0.0f);
+
+    if (_openJob != nullptr)
+    {
+        ImGui::ProgressBar(0.0f, progressSize, "Opening");
+
+        return;
+    }
+
+    auto size = _lineIndex->Size();
+    auto fraction = size > 0 ? static_cast<float>(static_cast<double>(_lineIndex->IndexedBytes()) / size) : 1.0f;
+
+    ImGui::ProgressBar(fraction, progressSize);
+}
+
+void OpenTextWidget::RenderSelection(
+    size_t line,
+    const std::string &text,
+    const ImVec2 &textPos,
+    size_t selectionBegin,
+    size_t selectionEnd)
+{
+    auto lineStart = _text.LineStart(line);
+    auto lineEnd = line + 1 < _text.LineCount() ? _text.LineStart(line + 1) : _text.Length();
+    if (selectionEnd <= lineStart || selectionBegin >= lineEnd)
+    {
+        return;
+    }
+
+    auto begin = std::min(selectionBegin > lineStart ? selectionBegin - lineStart : 0, text.size());
+    auto end = std::min(selectionEnd - lineStart, text.size());
+
+    auto x0 = textPos.x + ImGui::CalcTextSize(text.data(), text.data() + begin).x;
+    auto x1 = textPos.x + ImGui::CalcTextSize(text.data(), text.data() + end).x;
+
+    // A selected line break shows as a space after the line
+    if (selectionEnd >= lineEnd && line + 1 < _text.LineCount())
+    {
+        x1 += ImGui::CalcTextSize(" ").x;
+    }
+
+    ImGui::GetWindowDrawList()->AddRectFilled(
+        ImVec2(x0, textPos.y),
+        ImVec2(x1, textPos.y + ImGui::GetTextLineHeightWithSpacing()),
+        ImGui::GetColorU32(ImGuiCol_TextSelectedBg));
+}
+
+void OpenTextWidget::HandleKeyboard(
+    size_t pageLines)
+{
+    auto &io = ImGui::GetIO();
+    auto cursorLine = _text.LineOf(_cursor);
+
+    // With shift held the anchor stays and the selection grows
+    auto moveTo = [&](size_t offset) {
+        _cursor = offset;
+        if (!io.KeyShift)
+        {
+            _anchor = _cursor;
+        }
+
+        UpdateCursorX();
+
+        _text.EndUndoStep();
+        _scrollToCursor = true;
     };
 
-    if (_content.empty())
-        _content.push_back(0);
+    auto moveToLine = [&](size_t line) {
+        MoveCursorToLine(line);
+        if (!io.KeyShift)
+        {
+            _anchor = _cursor;
+        }
+    };
+
+    // Typing and pasting replace the selection
+    auto insert = [&](const std::string &text) {
+        EraseSelection();
+
+        _text.Insert(_cursor, text);
+        _cursor += text.size();
+        _anchor = _cursor;
+
+        UpdateCursorX();
+        _scrollToCursor = true;
+    };
+
+    auto selectedText = [&]() {
+        auto begin = std::min(_anchor, _cursor);
+
+        return _text.Text(begin, std::max(_anchor, _cursor) - begin);
+    };
 
-    if (Funcs::MyInputTextMultiline(
-            "##SearchResults",
-            &_content,
-            ImGui::GetContentRegionAvail()))
+    if (io.KeyCtrl)
     {
-        _isDirty = true;
+        if ((ImGui::IsKeyPressed(ImGuiKey_Z) && io.KeyShift) || ImGui::IsKeyPressed(ImGuiKey_Y))
+        {
+            if (_text.CanRedo())
+            {
+                _cursor = _anchor = _text.Redo();
+                UpdateCursorX();
+                _scrollToCursor = true;
+            }
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_Z))
+        {
+            if (_text.CanUndo())
+            {
+                _cursor = _anchor = _text.Undo();
+                UpdateCursorX();
+                _scrollToCursor = true;
+            }
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_S))
+        {
+            SaveFile();
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_A))
+        {
+            _anchor = 0;
+            _cursor = _text.Length();
+            UpdateCursorX();
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_C))
+        {
+            if (_anchor != _cursor)
+            {
+                ImGui::SetClipboardText(selectedText().c_str());
+            }
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_X))
+        {
+            if (_anchor != _cursor)
+            {
+                ImGui::SetClipboardText(selectedText().c_str());
+
+                _text.EndUndoStep();
+                EraseSelection();
+                _text.EndUndoStep();
+            }
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_V))
+        {
+            auto clipboard = ImGui::GetClipboardText();
+            if (clipboard != nullptr)
+            {
+                _text.EndUndoStep();
+                insert(clipboard);
+                _text.EndUndoStep();
+            }
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow))
+        {
+            moveTo(PreviousWord(_cursor));
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow))
+        {
+            moveTo(NextWord(_cursor));
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_Home))
+        {
+            moveTo(0);
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_End))
+        {
+            moveTo(_text.Length());
+        }
+
+        return;
     }
 
-    ImGui::PopFont();
+    if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow))
+    {
+        // Without shift the cursor goes to the start of the selection
+        moveTo(_anchor != _cursor && !io.KeyShift ? std::min(_anchor, _cursor) : PreviousCharacter(_cursor));
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow))
+    {
+        moveTo(_anchor != _cursor && !io.KeyShift ? std::max(_anchor, _cursor) : NextCharacter(_cursor));
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_Home))
+    {
+        moveTo(_text.LineStart(cursorLine));
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_End))
+    {
+        moveTo(_text.LineEnd(cursorLine));
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_UpArrow))
+    {
+        moveToLine(cursorLine > 0 ? cursorLine - 1 : 0);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow))
+    {
+        moveToLine(cursorLine + 1);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_PageUp))
+    {
+        moveToLine(cursorLine > pageLines ? cursorLine - pageLines : 0);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_PageDown))
+    {
+        moveToLine(cursorLine + pageLines);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_Enter) || ImGui::IsKeyPressed(ImGuiKey_KeypadEnter))
+    {
+        insert(_lineBreak);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_Tab))
+    {
+        insert("\t");
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_Backspace))
+    {
+        if (!EraseSelection())
+        {
+            auto previous = PreviousCharacter(_cursor);
 
-    ImGui::End();
+            _text.Erase(previous, _cursor - previous);
+            _cursor = _anchor = previous;
+        }
+
+        UpdateCursorX();
+        _scrollToCursor = true;
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_Delete))
+    {
+        if (!EraseSelection())
+        {
+            _text.Erase(_cursor, NextCharacter(_cursor) - _cursor);
+        }
+
+        UpdateCursorX();
+        _scrollToCursor = true;
+    }
+
+    std::string typed;
+    for (auto c : io.InputQueueCharacters)
+    {
+        // Tab and new lines come as keys
+        if (c < 0x20 || c == 0x7f)
+        {
+            continue;
+        }
+
+        if (c < 0x80)
+        {
+            typed += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            typed += static_cast<char>(0xc0 | (c >> 6));
+            typed += static_cast<char>(0x80 | (c & 0x3f));
+        }
+        else
+        {
+            typed += static_cast<char>(0xe0 | (c >> 12));
+            typed += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            typed += static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+
+    if (!typed.empty())
+    {
+        insert(typed);
+    }
+}
+
+bool OpenTextWidget::EraseSelection()
+{
+    if (_anchor == _cursor)
+    {
+        return false;
+    }
+
+    auto begin = std::min(_anchor, _cursor);
+
+    // Its own undo step, text typed over it joins that step
+    _text.EndUndoStep();
+    _text.Erase(begin, std::max(_anchor, _cursor) - begin);
+
+    _cursor = _anchor = begin;
+
+    return true;
+}
+
+void OpenTextWidget::UpdateCursorX()
+{
+    auto lineStart = _text.LineStart(_text.LineOf(_cursor));
+    auto before = _text.Text(lineStart, std::min(_cursor - lineStart, static_cast<size_t>(TEXT_MAX_DRAWN_LINE_LENGTH)));
+
+    _cursorX = ImGui::CalcTextSize(before.data(), before.data() + before.size()).x;
+}
+
+void OpenTextWidget::MoveCursorToLine(
+    size_t line)
+{
+    line = std::min(line, _text.LineCount() - 1);
+
+    _cursor = _text.LineStart(line) + ColumnAt(LineText(line), _cursorX);
+
+    _text.EndUndoStep();
+    _scrollToCursor = true;
+}
+
+std::string OpenTextWidget::LineText(
+    size_t line) const
+{
+    if (_text.IsOpen())
+    {
+        auto start = _text.LineStart(line);
+        auto end = std::min(_text.LineEnd(line), start + TEXT_MAX_DRAWN_LINE_LENGTH);
+
+        return _text.Text(start, end - start);
+    }
+
+    auto data = reinterpret_cast<const char *>(_file->Data());
+    auto start = _lineIndex->LineStart(line);
+    auto end = std::min(_lineIndex->LineEnd(line), start + TEXT_MAX_DRAWN_LINE_LENGTH);
+
+    return std::string(data + start, data + end);
+}
+
+size_t OpenTextWidget::PreviousCharacter(
+    size_t offset) const
+{
+    if (offset == 0)
+    {
+        return 0;
+    }
+
+    auto begin = offset >= 4 ? offset - 4 : 0;
+    auto before = _text.Text(begin, offset - begin);
+
+    // A line break is one character, even when it is two bytes
+    if (before.size() >= 2 && before.compare(before.size() - 2, 2, "\r\n") == 0)
+    {
+        return offset - 2;
+    }
+
+    auto i = before.size() - 1;
+    while (i > 0 && (static_cast<unsigned char>(before[i]) & 0xc0) == 0x80)
+    {
+        i--;
+    }
+
+    return begin + i;
+}
+
+size_t OpenTextWidget::NextCharacter(
+    size_t offset) const
+{
+    auto after = _text.Text(offset, 4);
+    if (after.empty())
+    {
+        return offset;
+    }
+
+    if (after.compare(0, 2, "\r\n") == 0)
+    {
+        return offset + 2;
+    }
+
+    size_t i = 1;
+    while (i < after.size() && (static_cast<unsigned char>(after[i]) & 0xc0) == 0x80)
+    {
+        i++;
+    }
+
+    return offset + i;
+}
+
+static int CharacterClass(
+    unsigned char c)
+{
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+        return 0;
+    }
+
+    // Bytes of UTF-8 sequences count as letters
+    return isalnum(c) || c == '_' || c >= 0x80 ? 1 : 2;
+}
+
+size_t OpenTextWidget::PreviousWord(
+    size_t offset) const
+{
+    // A word longer than this stops the cursor in its middle
+    auto begin = offset >= TEXT_MAX_DRAWN_LINE_LENGTH ? offset - TEXT_MAX_DRAWN_LINE_LENGTH : 0;
+    auto before = _text.Text(begin, offset - begin);
+
+    auto i = before.size();
+    while (i > 0 && CharacterClass(before[i - 1]) == 0)
+    {
+        i--;
+    }
+
+    if (i > 0)
+    {
+        auto wordClass = CharacterClass(before[i - 1]);
+        while (i > 0 && CharacterClass(before[i - 1]) == wordClass)
+        {
+            i--;
+        }
+    }
+
+    return begin + i;
+}
+
+size_t OpenTextWidget::NextWord(
+    size_t offset) const
+{
+    auto after = _text.Text(offset, TEXT_MAX_DRAWN_LINE_LENGTH);
+
+    size_t i = 0;
+    if (i < after.size())
+    {
+        auto wordClass = CharacterClass(after[i]);
+        while (wordClass != 0 && i < after.size() && CharacterClass(after[i]) == wordClass)
+        {
+            i++;
+        }
+    }
+
+    while (i < after.size() && CharacterClass(after[i]) == 0)
+    {
+        i++;
+    }
+
+    return offset + i;
+}
+
+size_t OpenTextWidget::ColumnAt(
+    const std::string &text,
+    float x)
+{
+    auto width = 0.0f;
+    for (size_t i = 0; i < text.size();)
+    {
+        auto next = i + 1;
+        while (next < text.size() && (static_cast<unsigned char>(text[next]) & 0xc0) == 0x80)
+        {
+            next++;
+        }
+
+        auto characterWidth = ImGui::CalcTextSize(text.data() + i, text.data() + next).x;
+        if (x < width + characterWidth / 2)
+        {
+            return i;
+        }
+
+        width += characterWidth;
+        i = next;
+    }
+
+    return text.size();
 }
@@ -0,0 +1,590 @@
+#include "piecetable.h"
+
+#include <algorithm>
+
+PieceTable::PieceTable()
+    : _random(std::random_device()())
+{}
+
+void PieceTable::Open(
+    const char *original,
+    size_t size,
+    const LineIndex *originalLines)
+{
+    Close();
+
+    _original = original;
+    _originalSize = size;
+    _originalLines = originalLines;
+
+    if (size > 0)
+    {
+        Piece piece;
+        piece.source = Sources::Original;
+        piece.start = 0;
+        piece.length = size;
+
+        _root = NewNode(piece);
+    }
+}
+
+void PieceTable::Close()
+{
+    _original = nullptr;
+    _originalSize = 0;
+    _originalLines = nullptr;
+    _added.clear();
+    _addedLineBreaks.clear();
+    _nodes.clear();
+    _freeNodes.clear();
+    _root = -1;
+    _undoSteps.clear();
+    _undoPosition = 0;
+    _savedPosition = 0;
+}
+
+size_t PieceTable::Length() const
+{
+    return _root >= 0 ? _nodes[_root].subtreeLength : 0;
+}
+
+size_t PieceTable::LineCount() const
+{
+    return (_root >= 0 ? _nodes[_root].subtreeLineBreaks : 0) + 1;
+}
+
+size_t PieceTable::LineStart(
+    size_t line) const
+{
+    if (line == 0)
+    {
+        return 0;
+    }
+
+    // The line starts after the line break before it
+    auto index = line - 1;
+    size_t offset = 0;
+
+    for (auto node = _root; node >= 0;)
+    {
+        auto &current = _nodes[node];
+        auto leftBreaks = current.left >= 0 ? _nodes[current.left].subtreeLineBreaks : 0;
+
+        if (index < leftBreaks)
+        {
+            node = current.left;
+            continue;
+        }
+
+        index -= leftBreaks;
+        offset += current.left >= 0 ? _nodes[current.left].subtreeLength : 0;
+
+        if (index < current.lineBreaks)
+        {
+            auto lineBreak = FindLineBreak(current.piece.source, current.piece.start, index);
+
+            return offset + (lineBreak - current.piece.start) + 1;
+        }
+
+        index -= current.lineBreaks;
+        offset += current.piece.length;
+        node = current.right;
+    }
+
+    return Length();
+}
+
+size_t PieceTable::LineEnd(
+    size_t line) const
+{
+    auto end = line + 1 < LineCount() ? LineStart(line + 1) - 1 : Length();
+
+    if (end > LineStart(line) && Text(end - 1, 1) == "\r")
+    {
+        end--;
+    }
+
+    return end;
+}
+
+size_t PieceTable::LineOf(
+    size_t offset) const
+{
+    size_t line = 0;
+
+    for (auto node = _root; node >= 0;)
+    {
+        auto &current = _nodes[node];
+        auto leftLength = current.left >= 0 ? _nodes[current.left].subtreeLength : 0;
+
+        if (offset < leftLength)
+        {
+            node = current.left;
+            continue;
+        }
+
+        offset -= leftLength;
+        line += current.left >= 0 ? _nodes[current.left].subtreeLineBreaks : 0;
+
+        if (offset < current.piece.length)
+        {
+            return line + CountLineBreaks(current.piece.source, current.piece.start, current.piece.start + offset);
+        }
+
+        offset -= current.piece.length;
+        line += current.lineBreaks;
+        node = current.right;
+    }
+
+    return line;
+}
+
+std::string PieceTable::Text(
+    size_t offset,
+    size_t length) const
+{
+    std::string text;
+
+    offset = std::min(offset, Length());
+    length = std::min(length, Length() - offset);
+    text.reserve(length);
+
+    CollectText(_root, offset, length, text);
+
+    return text;
+}
+
+void PieceTable::Insert(
+    size_t offset,
+    const std::string &text)
+{
+    if (text.empty() || !IsOpen())
+    {
+        return;
+    }
+
+    offset = std::min(offset, Length());
+
+    Piece piece;
+    piece.source = Sources::Added;
+    piece.start = _added.size();
+    piece.length = text.size();
+
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] == '\n')
+        {
+            _addedLineBreaks.push_back(_added.size() + i);
+        }
+    }
+    _added += text;
+
+    InsertPieces(offset, {piece});
+
+    auto &step = StepFor(offset, text.size(), true);
+
+    // Typed text follows the piece before it in the append buffer, so the
+    // step keeps a single piece
+    if (!step.inserted.empty() && step.inserted.back().source == Sources::Added && step.inserted.back().start + step.inserted.back().length == piece.start)
+    {
+        step.inserted.back().length += piece.length;
+    }
+    else
+    {
+        step.inserted.push_back(piece);
+    }
+
+    // A new line ends the step, like the end of a word would
+    if (text.find('\n') != std::string::npos)
+    {
+        step.isOpen = false;
+    }
+}
+
+void PieceTable::Erase(
+    size_t offset,
+    size_t length)
+{
+    if (!IsOpen() || offset >= Length())
+    {
+        return;
+    }
+
+    length = std::min(length, Length() - offset);
+    if (length == 0)
+    {
+        return;
+    }
+
+    auto removed = RemovePieces(offset, length);
+    auto &step = StepFor(offset, length, false);
+
+    if (offset < step.offset)
+    {
+        // Backspace, the removed text was before the step
+        removed.insert(removed.end(), step.removed.begin(), step.removed.end());
+        step.removed = std::move(removed);
+        step.offset = offset;
+    }
+    else
+    {
+        step.removed.insert(step.removed.end(), removed.begin(), removed.end());
+    }
+}
+
+void PieceTable::EndUndoStep()
+{
+    if (_undoPosition > 0)
+    {
+        _undoSteps[_undoPosition - 1].isOpen = false;
+    }
+}
+
+size_t PieceTable::Undo()
+{
+    if (!CanUndo())
+    {
+        return 0;
+    }
+
+    auto &step = _undoSteps[--_undoPosition];
+    step.isOpen = false;
+
+    RemovePieces(step.offset, TotalLength(step.inserted));
+    InsertPieces(step.offset, step.removed);
+
+    return step.offset + TotalLength(step.removed);
+}
+
+size_t PieceTable::Redo()
+{
+    if (!CanRedo())
+    {
+        return 0;
+    }
+
+    auto &step = _undoSteps[_undoPosition++];
+
+    RemovePieces(step.offset, TotalLength(step.removed));
+    InsertPieces(step.offset, step.inserted);
+
+    return step.offset + TotalLength(step.inserted);
+}
+
+void PieceTable::MarkSaved()
+{
+    EndUndoStep();
+
+    _savedPosition = _undoPosition;
+}
+
+void PieceTable::Write(
+    std::ostream &stream) const
+{
+    std::vector<Piece> pieces;
+    CollectPieces(_root, pieces);
+
+    for (auto &piece : pieces)
+    {
+        stream.write(Data(piece.source) + piece.start, static_cast<std::streamsize>(piece.length));
+    }
+}
+
+size_t PieceTable::CountLineBreaks(
+    Sources source,
+    size_t begin,
+    size_t end) const
+{
+    if (source == Sources::Original)
+    {
+        return _originalLines->LineOf(end) - _originalLines->LineOf(begin);
+    }
+
+    auto first = std::lower_bound(_addedLineBreaks.begin(), _addedLineBreaks.end(), begin);
+    auto last = std::lower_bound(first, _addedLineBreaks.end(), end);
+
+    return static_cast<size_t>(last - first);
+}
+
+size_t PieceTable::FindLineBreak(
+    Sources source,
+    size_t begin,
+    size_t index) const
+{
+    if (source == Sources::Original)
+    {
+        // Line n starts right after line break n - 1
+        return _originalLines->LineStart(_originalLines->LineOf(begin) + index + 1) - 1;
+    }
+
+    auto first = std::lower_bound(_addedLineBreaks.begin(), _addedLineBreaks.end(), begin);
+
+    return *(first + index);
+}
+
+int PieceTable::NewNode(
+    const Piece &piece)
+{
+    int node;
+    if (!_freeNodes.empty())
+    {
+        node = _freeNodes.back();
+        _freeNodes.pop_back();
+    }
+    else
+    {
+        node = static_cast<int>(_nodes.size());
+        _nodes.emplace_back();
+    }
+
+    auto &created = _nodes[node];
+    created = Node();
+    created.piece = piece;
+    created.lineBreaks = CountLineBreaks(piece.source, piece.start, piece.start + piece.length);
+    created.priority = static_cast<uint32_t>(_random());
+    UpdateNode(node);
+
+    return node;
+}
+
+void PieceTable::FreeTree(
+    int node)
+{
+    if (node < 0)
+    {
+        return;
+    }
+
+    FreeTree(_nodes[node].left);
+    FreeTree(_nodes[node].right);
+
+    _freeNodes.push_back(node);
+}
+
+void PieceTable::UpdateNode(
+    int node)
+{
+    auto &current = _nodes[node];
+
+    current.subtreeLength = current.piece.length;
+    current.subtreeLineBreaks = current.lineBreaks;
+
+    for (auto child : {current.left, current.right})
+    {
+        if (child >= 0)
+        {
+            current.subtreeLength += _nodes[child].subtreeLength;
+            current.subtreeLineBreaks += _nodes[child].subtreeLineBreaks;
+        }
+    }
+}
+
+void PieceTable::Split(
+    int node,
+    size_t offset,
+    int &left,
+    int &right)
+{
+    if (node < 0)
+    {
+        left = -1;
+        right = -1;
+        return;
+    }
+
+    auto leftLength = _nodes[node].left >= 0 ? _nodes[_nodes[node].left].subtreeLength : 0;
+
+    if (offset <= leftLength)
+    {
+        int splitLeft;
+        Split(_nodes[node].left, offset, left, splitLeft);
+        _nodes[node].left = splitLeft;
+        UpdateNode(node);
+        right = node;
+    }
+    else if (offset >= leftLength + _nodes[node].piece.length)
+    {
+        int splitRight;
+        Split(_nodes[node].right, offset - leftLength - _nodes[node].piece.length, splitRight, right);
+        _nodes[node].right = splitRight;
+        UpdateNode(node);
+        left = node;
+    }
+    else
+    {
+        auto cut = offset - leftLength;
+
+        Piece tail = _nodes[node].piece;
+        tail.start += cut;
+        tail.length -= cut;
+
+        // NewNode can grow _nodes, so no references are held across it
+        auto tailNode = NewNode(tail);
+        _nodes[tailNode].right = _nodes[node].right;
+        UpdateNode(tailNode);
+
+        _nodes[node].piece.length = cut;
+        _nodes[node].lineBreaks -= _nodes[tailNode].lineBreaks;
+        _nodes[node].right = -1;
+        UpdateNode(node);
+
+        left = node;
+        right = tailNode;
+    }
+}
+
+int PieceTable::Merge(
+    int left,
+    int right)
+{
+    if (left < 0)
+    {
+        return right;
+    }
+    if (right < 0)
+    {
+        return left;
+    }
+
+    if (_nodes[left].priority > _nodes[right].priority)
+    {
+        _nodes[left].right = Merge(_nodes[left].right, right);
+        UpdateNode(left);
+        return left;
+    }
+
+    _nodes[right].left = Merge(left, _nodes[right].left);
+    UpdateNode(right);
+    return right;
+}
+
+void PieceTable::CollectPieces(
+    int node,
+    std::vector<Piece> &pieces) const
+{
+    if (node < 0)
+    {
+        return;
+    }
+
+    CollectPieces(_nodes[node].left, pieces);
+    pieces.push_back(_nodes[node].piece);
+    CollectPieces(_nodes[node].right, pieces);
+}
+
+void PieceTable::CollectText(
+    int node,
+    size_t offset,
+    size_t length,
+    std::string &text) const
+{
+    if (node < 0 || length == 0)
+    {
+        return;
+    }
+
+    auto &current = _nodes[node];
+    auto leftLength = current.left >= 0 ? _nodes[current.left].subtreeLength : 0;
+    auto end = offset + length;
+
+    // Only the subtrees that overlap [offset, end) are visited
+    if (offset < leftLength)
+    {
+        CollectText(current.left, offset, std::min(end, leftLength) - offset, text);
+    }
+
+    auto pieceEnd = leftLength + current.piece.length;
+    if (offset < pieceEnd && end > leftLength)
+    {
+        auto begin = std::max(offset, leftLength);
+        text.append(Data(current.piece.source) + current.piece.start + (begin - leftLength), std::min(end, pieceEnd) - begin);
+    }
+
+    if (end > pieceEnd)
+    {
+        auto begin = std::max(offset, pieceEnd);
+        CollectText(current.right, begin - pieceEnd, end - begin, text);
+    }
+}
+
+void PieceTable::InsertPieces(
+    size_t offset,
+    const std::vector<Piece> &pieces)
+{
+    int left, right;
+    Split(_root, offset, left, right);
+
+    for (auto &piece : pieces)
+    {
+        left = Merge(left, NewNode(piece));
+    }
+
+    _root = Merge(left, right);
+}
+
+std::vector<PieceTable::Piece> PieceTable::RemovePieces(
+    size_t offset,
+    size_t length)
+{
+    int left, middle, right;
+    Split(_root, offset, left, right);
+    Split(right, length, middle, right);
+
+    std::vector<Piece> pieces;
+    CollectPieces(middle, pieces);
+    FreeTree(middle);
+
+    _root = Merge(left, right);
+
+    return pieces;
+}
+
+size_t PieceTable::TotalLength(
+    const std::vector<Piece> &pieces)
+{
+    size_t length = 0;
+    for (auto &piece : pieces)
+    {
+        length += piece.length;
+    }
+
+    return length;
+}
+
+PieceTable::UndoStep &PieceTable::StepFor(
+    size_t offset,
+    size_t length,
+    bool isInsert)
+{
+    // Edits that were undone can't be redone after a new one
+    _undoSteps.resize(_undoPosition);
+    if (_savedPosition > _undoPosition)
+    {
+        _savedPosition = SIZE_MAX;
+    }
+
+    if (!_undoSteps.empty() && _undoSteps.back().isOpen && _undoPosition != _savedPosition)
+    {
+        auto &last = _undoSteps.back();
+
+        // Typing over text that was just erased replaces it in one step
+        if (isInsert && offset == last.offset + TotalLength(last.inserted))
+        {
+            return last;
+        }
+
+        if (!isInsert && last.inserted.empty() && (offset == last.offset || offset + length == last.offset))
+        {
+            return last;
+        }
+
+        last.isOpen = false;
+    }
+
+    UndoStep step;
+    step.offset = offset;
+    _undoSteps.push_back(std::move(step));
+    _undoPosition = _undoSteps.size();
+
+    return _undoSteps.back();
+}
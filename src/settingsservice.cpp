@@ -21,12 +21,41 @@ SettingsService::SettingsService()
     {
         _db = std::make_unique<sqlitelib::Sqlite>(":memory:");
     }
+    else
+    {
+        // The find thread reads and writes the saved search files over a
+        // connection of its own, so its transactions never mix with the
+        // statements of the UI thread. Without a settings file the saved
+        // search files are not kept.
+        _searchDb = std::make_unique<sqlitelib::Sqlite>(settingFilename.string().c_str());
+
+        if (!_searchDb->is_open())
+        {
+            _searchDb = nullptr;
+        }
+    }
 
     if (_db->is_open())
     {
         EnsureTables();
     }
 
+    // The connections wait for each other's writes instead of failing
+    for (auto db : {_db.get(), _searchDb.get()})
+    {
+        try
+        {
+            if (db != nullptr && db->is_open())
+            {
+                db->prepare<int>("PRAGMA busy_timeout = 5000", -1).execute();
+            }
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << db->errmsg() << std::endl;
+        }
+    }
+
     auto query = LR"(SELECT b.path FROM Bookmarks b)";
 
     try
@@ -103,6 +132,42 @@ void SettingsService::EnsureTables()
     {
         std::cout << ex.what() << std::endl;
     }
+
+    auto savedSearchesQuery = std::wstring(LR"(CREATE TABLE IF NOT EXISTS SavedSearches (
+        id INTEGER PRIMARY KEY,
+        name TEXT NOT NULL,
+        root TEXT NOT NULL,
+        mode INTEGER NOT NULL,
+        patterns TEXT NOT NULL
+    );)");
+
+    try
+    {
+        EnsureTable(_db, _wstringConverter, savedSearchesQuery);
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+
+    auto savedSearchFilesQuery = std::wstring(LR"(CREATE TABLE IF NOT EXISTS SavedSearchFiles (
+        search_id INTEGER NOT NULL,
+        path TEXT NOT NULL,
+        modified REAL NOT NULL,
+        size REAL NOT NULL,
+        hits TEXT NOT NULL,
+        results TEXT NOT NULL,
+        PRIMARY KEY (search_id, path)
+    );)");
+
+    try
+    {
+        EnsureTable(_db, _wstringConverter, savedSearchFilesQuery);
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
 }
 
 bool SettingsService::IsBookmarked(
@@ -392,3 +457,240 @@ void SettingsService::DeleteOpenWithOption(
         std::cout << _db->errmsg() << std::endl;
     }
 }
+
+std::vector<SavedSearch> SettingsService::GetSavedSearches()
+{
+    auto query = LR"(SELECT
+    s.id,
+    s.name,
+    s.root,
+    s.mode,
+    s.patterns
+FROM
+    SavedSearches s
+ORDER BY
+    s.name)";
+
+    std::vector<SavedSearch> result;
+
+    try
+    {
+        auto queryBytes = _wstringConverter.to_bytes(query);
+        auto statement = _db->prepare<int, std::string, std::string, int, std::string>(queryBytes.c_str(), queryBytes.size());
+
+        for (const auto &row : statement.execute())
+        {
+            SavedSearch search;
+
+            search.id = std::get<0>(row);
+            search.name = _wstringConverter.from_bytes(std::get<1>(row));
+            search.root = _wstringConverter.from_bytes(std::get<2>(row));
+            search.mode = std::get<3>(row);
+            search.patterns = _wstringConverter.from_bytes(std::get<4>(row));
+
+            result.push_back(search);
+        }
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+    }
+
+    return result;
+}
+
+int SettingsService::AddSavedSearch(
+    const std::wstring &name,
+    const std::filesystem::path &root,
+    int mode,
+    const std::wstring &patterns)
+{
+    auto query = LR"(INSERT INTO SavedSearches (name, root, mode, patterns) VALUES (?, ?, ?, ?))";
+
+    auto queryBytes = _wstringConverter.to_bytes(query);
+
+    try
+    {
+        _db->prepare(queryBytes.c_str(), queryBytes.size())
+            .execute(
+                _wstringConverter.to_bytes(name),
+                _wstringConverter.to_bytes(root.wstring()),
+                mode,
+                _wstringConverter.to_bytes(patterns));
+
+        queryBytes = _wstringConverter.to_bytes(L"SELECT last_insert_rowid()");
+
+        return _db->prepare<int>(queryBytes.c_str(), queryBytes.size())
+            .execute_value();
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+
+        return -1;
+    }
+}
+
+void SettingsService::DeleteSavedSearch(
+    int id)
+{
+    auto queries = {
+        LR"(DELETE FROM SavedSearchFiles WHERE search_id = ?)",
+        LR"(DELETE FROM SavedSearches WHERE id = ?)",
+    };
+
+    for (auto query : queries)
+    {
+        auto queryBytes = _wstringConverter.to_bytes(query);
+
+        try
+        {
+            _db->prepare(queryBytes.c_str(), queryBytes.size())
+                .execute(
+                    id);
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << _db->errmsg() << std::endl;
+        }
+    }
+}
+
+// The saved search files are read and written from the find thread, so
+// these use _searchDb and u8string instead of _db and the (not thread safe)
+// _wstringConverter
+std::map<std::filesystem::path, SavedSearchFile> SettingsService::GetSavedSearchFiles(
+    int searchId)
+{
+    auto query = R"(SELECT
+    f.path,
+    f.modified,
+    f.size,
+    f.hits,
+    f.results
+FROM
+    SavedSearchFiles f
+WHERE
+    f.search_id = ?)";
+
+    std::map<std::filesystem::path, SavedSearchFile> result;
+
+    std::lock_guard<std::mutex> lock(_searchDbMutex);
+
+    if (_searchDb == nullptr)
+    {
+        return result;
+    }
+
+    try
+    {
+        auto statement = _searchDb->prepare<std::string, double, double, std::string, std::string>(query, -1);
+
+        for (const auto &row : statement.execute_cursor(searchId))
+        {
+            SavedSearchFile file;
+
+            file.modified = std::get<1>(row);
+            file.size = std::get<2>(row);
+
+            std::istringstream hits(std::get<3>(row));
+            std::string hit;
+            while (getline(hits, hit, ','))
+            {
+                file.hitCounts.push_back(std::stoi(hit));
+            }
+
+            std::istringstream lines(std::get<4>(row));
+            std::string line;
+            while (getline(lines, line))
+            {
+                file.lines.push_back(line);
+            }
+
+            result.insert(std::make_pair(std::filesystem::u8path(std::get<0>(row)), file));
+        }
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _searchDb->errmsg() << std::endl;
+    }
+
+    return result;
+}
+
+void SettingsService::UpdateSavedSearchFiles(
+    int searchId,
+    const std::map<std::filesystem::path, SavedSearchFile> &changedFiles,
+    const std::vector<std::filesystem::path> &removedFiles)
+{
+    std::lock_guard<std::mutex> lock(_searchDbMutex);
+
+    if (_searchDb == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        // IMMEDIATE takes the write lock before the check, so the search can
+        // not be forgotten between the check and the inserts
+        _searchDb->execute("BEGIN IMMEDIATE TRANSACTION", -1);
+
+        auto search = _searchDb->prepare<int>(R"(SELECT id FROM SavedSearches WHERE id = ?)", -1);
+
+        if (search.execute(searchId).empty())
+        {
+            _searchDb->execute("COMMIT", -1);
+
+            return;
+        }
+
+        auto insert = _searchDb->prepare(R"(INSERT OR REPLACE INTO SavedSearchFiles (search_id, path, modified, size, hits, results) VALUES (?, ?, ?, ?, ?, ?))", -1);
+
+        for (const auto &changedFile : changedFiles)
+        {
+            std::stringstream hits;
+            for (size_t i = 0; i < changedFile.second.hitCounts.size(); i++)
+            {
+                hits << (i > 0 ? "," : "") << changedFile.second.hitCounts[i];
+            }
+
+            std::stringstream lines;
+            for (const auto &line : changedFile.second.lines)
+            {
+                lines << line << "\n";
+            }
+
+            insert.execute(
+                searchId,
+                changedFile.first.u8string(),
+                changedFile.second.modified,
+                changedFile.second.size,
+                hits.str(),
+                lines.str());
+        }
+
+        auto remove = _searchDb->prepare(R"(DELETE FROM SavedSearchFiles WHERE search_id = ? AND path = ?)", -1);
+
+        for (const auto &removedFile : removedFiles)
+        {
+            remove.execute(
+                searchId,
+                removedFile.u8string());
+        }
+
+        _searchDb->execute("COMMIT", -1);
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _searchDb->errmsg() << std::endl;
+
+        try
+        {
+            _searchDb->execute("ROLLBACK", -1);
+        }
+        catch (std::exception &)
+        {
+        }
+    }
+}
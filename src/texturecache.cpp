@@ -0,0 +1,170 @@
+#include "texturecache.h"
+
+TextureCache::TextureCache(
+    TextureUploader *textureUploader,
+    size_t budget)
+    : _textureUploader(textureUploader),
+      _budget(budget)
+{}
+
+TextureCache::~TextureCache() = default;
+
+TextureCache::TextureKey TextureCache::KeyFor(
+    const DecodeRequest &request)
+{
+    TextureKey key;
+
+    key.request = request;
+
+    std::error_code ec;
+    key.modified = std::filesystem::last_write_time(request.path, ec);
+
+    return key;
+}
+
+const CachedTexture *TextureCache::Find(
+    const DecodeRequest &request)
+{
+    auto found = _entries.find(KeyFor(request));
+    if (found == _entries.end())
+    {
+        return nullptr;
+    }
+
+    _lru.splice(_lru.begin(), _lru, found->second.lruPosition);
+
+    return &found->second.texture;
+}
+
+const CachedTexture &TextureCache::Upload(
+    const DecodeRequest &request,
+    const std::shared_ptr<DecodedImage> &image)
+{
+    auto key = KeyFor(request);
+
+    auto found = _entries.find(key);
+    if (found != _entries.end())
+    {
+        _lru.splice(_lru.begin(), _lru, found->second.lruPosition);
+
+        return found->second.texture;
+    }
+
+    Entry entry;
+
+    entry.texture.path = request.path;
+    entry.texture.maxDimension = request.maxDimension;
+    entry.texture.size = ImVec2(image->Width(), image->Height());
+    entry.texture.imageSize = ImVec2(image->originalWidth, image->originalHeight);
+    entry.texture.orientation = image->orientation;
+    entry.texture.byteSize = image->ByteSize() * 4 / 3;
+    entry.texture.textureId = _textureUploader->Begin(image, true);
+
+    _lru.push_front(key);
+    entry.lruPosition = _lru.begin();
+
+    _usedBytes += entry.texture.byteSize;
+    _keysById[entry.texture.textureId] = key;
+
+    auto &texture = _entries.insert(std::make_pair(key, entry)).first->second.texture;
+
+    Evict();
+
+    return texture;
+}
+
+bool TextureCache::IsComplete(
+    const CachedTexture &texture) const
+{
+    return _textureUploader->IsComplete(texture.textureId);
+}
+
+bool TextureCache::IsUploading() const
+{
+    for (const auto &entry : _entries)
+    {
+        if (!_textureUploader->IsComplete(entry.second.texture.textureId))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TextureCache::Hold(
+    int owner,
+    const std::vector<unsigned int> &textureIds)
+{
+    for (auto &entry : _entries)
+    {
+        entry.second.heldBy.erase(owner);
+    }
+
+    for (auto textureId : textureIds)
+    {
+        auto found = _keysById.find(textureId);
+        if (textureId == 0 || found == _keysById.end())
+        {
+            continue;
+        }
+
+        _entries[found->second].heldBy.insert(owner);
+    }
+}
+
+void TextureCache::Release(
+    int owner)
+{
+    Hold(owner, {});
+}
+
+void TextureCache::EndFrame()
+{
+    _thumbnails.EndFrame();
+
+    Evict();
+}
+
+void TextureCache::ReleaseAll()
+{
+    for (const auto &entry : _entries)
+    {
+        _textureUploader->DeleteTexture(entry.second.texture.textureId);
+    }
+
+    _entries.clear();
+    _keysById.clear();
+    _lru.clear();
+    _usedBytes = 0;
+
+    _thumbnails.Release();
+}
+
+size_t TextureCache::UsedBytes() const
+{
+    return _usedBytes + _thumbnails.ByteSize();
+}
+
+// The most recently used texture is always kept, it is usually the one
+// that was just uploaded and is about to be held
+void TextureCache::Evict()
+{
+    auto it = _lru.end();
+    while (UsedBytes() > _budget && it != _lru.begin())
+    {
+        --it;
+
+        auto found = _entries.find(*it);
+        if (!found->second.heldBy.empty() || it == _lru.begin())
+        {
+            continue;
+        }
+
+        _usedBytes -= found->second.texture.byteSize;
+        _textureUploader->DeleteTexture(found->second.texture.textureId);
+        _keysById.erase(found->second.texture.textureId);
+        _entries.erase(found);
+        it = _lru.erase(it);
+    }
+}
@@ -0,0 +1,373 @@
+#include "textureuploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glad/glad.h>
+
+TextureUploader::TextureUploader(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler)
+{}
+
+TextureUploader::~TextureUploader()
+{
+    // The copies write into the mapped buffer, they must be done before it goes
+    for (auto &slice : _slices)
+    {
+        if (slice->copy.valid())
+        {
+            slice->copy.wait();
+        }
+    }
+}
+
+// Persistent mapping needs GL 4.4, without it every upload is direct
+void TextureUploader::Initialize()
+{
+    _isInitialized = true;
+
+    if (!GLAD_GL_VERSION_4_4)
+    {
+        return;
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEXTURE_UPLOAD_RING_SIZE, nullptr, flags);
+    _mapped = static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TEXTURE_UPLOAD_RING_SIZE, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (_mapped == nullptr)
+    {
+        glDeleteBuffers(1, &_buffer);
+        _buffer = 0;
+
+        return;
+    }
+
+    _isStreaming = true;
+}
+
+unsigned int TextureUploader::Begin(
+    std::shared_ptr<DecodedImage> image,
+    bool hasMipmaps)
+{
+    if (!_isInitialized)
+    {
+        Initialize();
+    }
+
+    GLsizei levels = 1;
+    if (hasMipmaps)
+    {
+        for (auto longest = std::max(image->Width(), image->Height()); longest > 1; longest /= 2)
+        {
+            levels++;
+        }
+    }
+
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, hasMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, image->Width(), image->Height());
+
+    if (!_isStreaming || image->ByteSize() <= TEXTURE_UPLOAD_DIRECT_SIZE)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image->Width(), image->Height(), GL_RGBA, GL_UNSIGNED_BYTE, image->Pixels());
+
+        if (hasMipmaps)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        return textureId;
+    }
+
+    auto upload = std::make_shared<Upload>();
+    upload->textureId = textureId;
+    upload->image = image;
+    upload->hasMipmaps = hasMipmaps;
+
+    _uploads[textureId] = upload;
+    _queued.push_back(upload);
+
+    _frameScheduler->RequestFrame();
+
+    return textureId;
+}
+
+bool TextureUploader::IsComplete(
+    unsigned int textureId) const
+{
+    return _uploads.find(textureId) == _uploads.end();
+}
+
+void TextureUploader::DeleteTexture(
+    unsigned int textureId)
+{
+    auto found = _uploads.find(textureId);
+    if (found != _uploads.end())
+    {
+        found->second->isCancelled = true;
+        _uploads.erase(found);
+
+        _queued.erase(
+            std::remove_if(_queued.begin(), _queued.end(), [textureId](const std::shared_ptr<Upload> &upload) { return upload->textureId == textureId; }),
+            _queued.end());
+    }
+
+    glDeleteTextures(1, &textureId);
+}
+
+void TextureUploader::Update()
+{
+    if (_slices.empty() && _queued.empty())
+    {
+        return;
+    }
+
+    Retire();
+
+    Submit();
+
+    auto isStarted = StartCopies();
+
+    // Fences are polled, nothing else wakes the main loop when they signal
+    auto isWaitingForGpu = std::any_of(_slices.begin(), _slices.end(), [](const std::shared_ptr<Slice> &slice) { return slice->isSubmitted; });
+
+    if (!isStarted || isWaitingForGpu)
+    {
+        _frameScheduler->RequestFrame();
+    }
+}
+
+// The ring is used in order, so regions are freed from the oldest slice on
+bool TextureUploader::Allocate(
+    size_t size,
+    size_t &offset)
+{
+    if (_slices.empty())
+    {
+        _ringHead = 0;
+    }
+
+    auto tail = _slices.empty() ? _ringHead : _slices.front()->offset;
+
+    if (!_slices.empty() && _ringHead == tail)
+    {
+        return false;
+    }
+
+    if (_ringHead >= tail)
+    {
+        if (_ringHead + size <= TEXTURE_UPLOAD_RING_SIZE)
+        {
+            offset = _ringHead;
+        }
+        else if (size <= tail)
+        {
+            offset = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (_ringHead + size <= tail)
+    {
+        offset = _ringHead;
+    }
+    else
+    {
+        return false;
+    }
+
+    _ringHead = offset + size;
+
+    return true;
+}
+
+void TextureUploader::Retire()
+{
+    while (!_slices.empty() && _slices.front()->isSubmitted)
+    {
+        auto &slice = _slices.front();
+
+        if (slice->fence != nullptr)
+        {
+            auto fence = static_cast<GLsync>(slice->fence);
+            auto result = glClientWaitSync(fence, 0, 0);
+            if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            {
+                return;
+            }
+
+            glDeleteSync(fence);
+        }
+
+        auto &upload = slice->upload;
+        upload->slicesInFlight--;
+
+        if (!upload->isCancelled && upload->slicesInFlight == 0 && upload->image == nullptr)
+        {
+            _uploads.erase(upload->textureId);
+        }
+
+        _slices.pop_front();
+    }
+}
+
+void TextureUploader::Submit()
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+
+    for (auto &slice : _slices)
+    {
+        if (slice->isSubmitted)
+        {
+            continue;
+        }
+
+        // Later slices are not submitted before earlier ones, the last slice
+        // of an image generates its mipmaps
+        if (!slice->isCopied)
+        {
+            break;
+        }
+
+        slice->isSubmitted = true;
+
+        auto &upload = slice->upload;
+        if (upload->isCancelled)
+        {
+            continue;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, upload->textureId);
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            0,
+            slice->firstRow,
+            upload->image->Width(),
+            slice->rowCount,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            reinterpret_cast<const void *>(slice->offset));
+
+        auto isLastSlice = slice->firstRow + slice->rowCount == upload->image->Height();
+        if (isLastSlice && upload->hasMipmaps)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        slice->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        if (isLastSlice)
+        {
+            // The decoded pixels are not needed for this texture any more
+            upload->image = nullptr;
+        }
+    }
+
+    // Left bound, every other texture upload would read from the ring
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool TextureUploader::StartCopies()
+{
+    size_t budget = TEXTURE_UPLOAD_FRAME_BUDGET;
+
+    while (!_queued.empty())
+    {
+        auto &upload = _queued.front();
+
+        auto rowBytes = static_cast<size_t>(upload->image->Width()) * 4;
+        auto rowsPerSlice = std::max<size_t>(1, TEXTURE_UPLOAD_SLICE_SIZE / rowBytes);
+        auto rowCount = static_cast<int>(std::min<size_t>(rowsPerSlice, upload->image->Height() - upload->nextRow));
+        auto size = rowBytes * rowCount;
+
+        if (size > budget)
+        {
+            return false;
+        }
+
+        size_t offset = 0;
+        if (!Allocate(size, offset))
+        {
+            // Waiting for fences, which already asks for frames
+            return true;
+        }
+
+        auto slice = std::make_shared<Slice>();
+        slice->upload = upload;
+        slice->offset = offset;
+        slice->firstRow = upload->nextRow;
+        slice->rowCount = rowCount;
+
+        auto source = upload->image->Pixels() + rowBytes * slice->firstRow;
+        auto destination = _mapped + offset;
+        auto frameScheduler = _frameScheduler;
+
+        // Holds on to the pixels, whatever happens to the upload meanwhile
+        slice->copy = _workerPool->Enqueue([slice = slice.get(), image = upload->image, source, destination, size, frameScheduler]() {
+            std::memcpy(destination, source, size);
+            slice->isCopied = true;
+            frameScheduler->RequestFrame();
+        });
+
+        _slices.push_back(slice);
+
+        upload->slicesInFlight++;
+        upload->nextRow += rowCount;
+        budget -= size;
+
+        if (upload->nextRow == upload->image->Height())
+        {
+            _queued.pop_front();
+        }
+    }
+
+    return true;
+}
+
+void TextureUploader::Release()
+{
+    for (auto &slice : _slices)
+    {
+        if (slice->copy.valid())
+        {
+            slice->copy.wait();
+        }
+
+        if (slice->fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(slice->fence));
+        }
+    }
+
+    _slices.clear();
+    _queued.clear();
+    _uploads.clear();
+
+    if (_buffer != 0)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &_buffer);
+    }
+
+    _buffer = 0;
+    _mapped = nullptr;
+    _isStreaming = false;
+}
@@ -0,0 +1,179 @@
+#include "thumbnailatlas.h"
+
+#include <algorithm>
+#include <glad/glad.h>
+
+ThumbnailAtlas::~ThumbnailAtlas()
+{
+    Release();
+}
+
+void ThumbnailAtlas::Release()
+{
+    if (!_pages.empty())
+    {
+        glDeleteTextures(static_cast<GLsizei>(_pages.size()), _pages.data());
+    }
+
+    _pages.clear();
+    _isPageChanged.clear();
+    _slots.clear();
+    _slotsByPath.clear();
+}
+
+// With the mipmaps, a third on top of the first level
+size_t ThumbnailAtlas::ByteSize() const
+{
+    return _pages.size() * THUMBNAIL_ATLAS_SIZE * THUMBNAIL_ATLAS_SIZE * 4 * 4 / 3;
+}
+
+// The uv range leaves out a texel on each side, the mipmaps blend in what
+// is around the thumbnail in its slot
+bool ThumbnailAtlas::Find(
+    const std::filesystem::path &path,
+    Placement &placement)
+{
+    auto found = _slotsByPath.find(path);
+    if (found == _slotsByPath.end())
+    {
+        return false;
+    }
+
+    auto &slot = _slots[found->second];
+    slot.lastUsedFrame = _frame;
+
+    auto index = found->second % SlotsPerPage;
+    auto left = static_cast<float>((index % SlotsPerRow) * THUMBNAIL_SIZE);
+    auto top = static_cast<float>((index / SlotsPerRow) * THUMBNAIL_SIZE);
+    const auto size = static_cast<float>(THUMBNAIL_ATLAS_SIZE);
+
+    placement.textureId = _pages[found->second / SlotsPerPage];
+    placement.uvMin = ImVec2((left + 1.0f) / size, (top + 1.0f) / size);
+    placement.uvMax = ImVec2((left + slot.width - 1.0f) / size, (top + slot.height - 1.0f) / size);
+    placement.size = ImVec2(static_cast<float>(slot.width), static_cast<float>(slot.height));
+    placement.orientation = slot.orientation;
+
+    return true;
+}
+
+bool ThumbnailAtlas::Add(
+    const std::filesystem::path &path,
+    const DecodedImage &thumbnail)
+{
+    if (thumbnail.Width() > THUMBNAIL_SIZE || thumbnail.Height() > THUMBNAIL_SIZE)
+    {
+        return false;
+    }
+
+    auto index = FreeSlot();
+    if (index < 0)
+    {
+        return false;
+    }
+
+    auto &slot = _slots[index];
+    if (!slot.path.empty())
+    {
+        _slotsByPath.erase(slot.path);
+    }
+
+    slot.path = path;
+    slot.lastUsedFrame = _frame;
+    slot.width = thumbnail.Width();
+    slot.height = thumbnail.Height();
+    slot.orientation = thumbnail.orientation;
+    _slotsByPath[path] = index;
+
+    auto page = index / SlotsPerPage;
+    auto indexInPage = index % SlotsPerPage;
+
+    glBindTexture(GL_TEXTURE_2D, _pages[page]);
+    glTexSubImage2D(
+        GL_TEXTURE_2D,
+        0,
+        (indexInPage % SlotsPerRow) * THUMBNAIL_SIZE,
+        (indexInPage / SlotsPerRow) * THUMBNAIL_SIZE,
+        thumbnail.Width(),
+        thumbnail.Height(),
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        thumbnail.Pixels());
+
+    _isPageChanged[page] = true;
+
+    return true;
+}
+
+// An empty slot, a new page, or the least recently used slot that was not
+// drawn this frame
+int ThumbnailAtlas::FreeSlot()
+{
+    int oldest = -1;
+
+    for (int i = 0; i < static_cast<int>(_slots.size()); i++)
+    {
+        if (_slots[i].path.empty())
+        {
+            return i;
+        }
+
+        if (_slots[i].lastUsedFrame < _frame && (oldest < 0 || _slots[i].lastUsedFrame < _slots[oldest].lastUsedFrame))
+        {
+            oldest = i;
+        }
+    }
+
+    if (_pages.size() < THUMBNAIL_ATLAS_PAGES)
+    {
+        AddPage();
+
+        return static_cast<int>(_slots.size()) - SlotsPerPage;
+    }
+
+    return oldest;
+}
+
+void ThumbnailAtlas::AddPage()
+{
+    GLuint textureId = 0;
+
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Slots are a power of two and aligned, the first levels never mix two slots
+    GLsizei levels = 1;
+    for (auto size = THUMBNAIL_SIZE; size > 32; size /= 2)
+    {
+        levels++;
+    }
+
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, THUMBNAIL_ATLAS_SIZE, THUMBNAIL_ATLAS_SIZE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    _pages.push_back(textureId);
+    _isPageChanged.push_back(false);
+    _slots.resize(_slots.size() + SlotsPerPage);
+}
+
+void ThumbnailAtlas::EndFrame()
+{
+    for (size_t i = 0; i < _pages.size(); i++)
+    {
+        if (!_isPageChanged[i])
+        {
+            continue;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, _pages[i]);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        _isPageChanged[i] = false;
+    }
+
+    _frame++;
+}
@@ -0,0 +1,473 @@
+#include "thumbnailcache.h"
+#include "imagekernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <miniz.h>
+
+// Every byte is stored as the difference with the same channel of the pixel
+// to its left, photos compress a lot better that way
+static void DeltaEncode(
+    unsigned char *pixels,
+    int width,
+    int height)
+{
+    for (int y = 0; y < height; y++)
+    {
+        auto row = pixels + static_cast<size_t>(y) * width * 4;
+        for (int i = width * 4 - 1; i >= 4; i--)
+        {
+            row[i] = static_cast<unsigned char>(row[i] - row[i - 4]);
+        }
+    }
+}
+
+static void DeltaDecode(
+    unsigned char *pixels,
+    int width,
+    int height)
+{
+    for (int y = 0; y < height; y++)
+    {
+        auto row = pixels + static_cast<size_t>(y) * width * 4;
+        for (int i = 4; i < width * 4; i++)
+        {
+            row[i] = static_cast<unsigned char>(row[i] + row[i - 4]);
+        }
+    }
+}
+
+ThumbnailCache::ThumbnailCache(
+    WorkerPool *workerPool,
+    FrameScheduler *frameScheduler,
+    size_t budget)
+    : _workerPool(workerPool),
+      _frameScheduler(frameScheduler),
+      _budget(budget)
+{}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _isStopping = true;
+
+    _jobsDone.wait(lock, [this]() { return _jobsInFlight == 0; });
+
+    Store(_pendingWrites);
+}
+
+bool ThumbnailCache::Open(
+    const std::filesystem::path &databaseFile)
+{
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    _db = std::make_unique<sqlitelib::Sqlite>(databaseFile.string().c_str());
+
+    if (!_db->is_open())
+    {
+        _db = nullptr;
+
+        return false;
+    }
+
+    EnsureTables();
+
+    return true;
+}
+
+void ThumbnailCache::EnsureTables()
+{
+    auto queries = {
+        R"(CREATE TABLE IF NOT EXISTS Thumbnails (
+        path TEXT PRIMARY KEY,
+        size REAL NOT NULL,
+        modified REAL NOT NULL,
+        width INTEGER NOT NULL,
+        height INTEGER NOT NULL,
+        orientation INTEGER NOT NULL,
+        original_width INTEGER NOT NULL,
+        original_height INTEGER NOT NULL,
+        pixels BLOB NOT NULL
+    );)",
+    };
+
+    for (auto query : queries)
+    {
+        try
+        {
+            _db->execute(query, -1);
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << _db->errmsg() << std::endl;
+        }
+    }
+}
+
+void ThumbnailCache::Request(
+    int owner,
+    const std::vector<std::filesystem::path> &paths)
+{
+    std::set<std::filesystem::path> wanted(paths.begin(), paths.end());
+    std::vector<std::filesystem::path> toMake;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            if (wanted.find(it->first) == wanted.end())
+            {
+                it->second.wantedBy.erase(owner);
+            }
+
+            if (it->second.state == DecodeStates::Queued && it->second.wantedBy.empty())
+            {
+                it = _entries.erase(it);
+                continue;
+            }
+
+            ++it;
+        }
+
+        for (const auto &path : paths)
+        {
+            auto found = _entries.find(path);
+            if (found == _entries.end())
+            {
+                found = _entries.insert(std::make_pair(path, Entry())).first;
+                found->second.lruPosition = _lru.end();
+
+                toMake.push_back(path);
+                _jobsInFlight++;
+            }
+
+            found->second.wantedBy.insert(owner);
+        }
+
+        Evict();
+    }
+
+    for (const auto &path : toMake)
+    {
+        _workerPool->Enqueue([this, path]() { Make(path); });
+    }
+}
+
+void ThumbnailCache::Release(
+    int owner)
+{
+    Request(owner, {});
+}
+
+DecodeStates ThumbnailCache::Lookup(
+    const std::filesystem::path &path,
+    std::shared_ptr<DecodedImage> &thumbnail)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _entries.find(path);
+    if (found == _entries.end())
+    {
+        return DecodeStates::NotCached;
+    }
+
+    if (found->second.state == DecodeStates::Ready)
+    {
+        _lru.splice(_lru.begin(), _lru, found->second.lruPosition);
+        thumbnail = found->second.thumbnail;
+    }
+
+    return found->second.state;
+}
+
+void ThumbnailCache::Make(
+    const std::filesystem::path &path)
+{
+    bool shouldMake = false;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _entries.find(path);
+        if (!_isStopping && found != _entries.end() && found->second.state == DecodeStates::Queued)
+        {
+            found->second.state = DecodeStates::Decoding;
+            shouldMake = true;
+        }
+    }
+
+    std::shared_ptr<DecodedImage> thumbnail;
+    std::vector<StoredThumbnail> toStore;
+
+    if (shouldMake)
+    {
+        std::error_code sizeError, modifiedError;
+        auto size = static_cast<double>(std::filesystem::file_size(path, sizeError));
+        auto modified = static_cast<double>(std::filesystem::last_write_time(path, modifiedError).time_since_epoch().count());
+
+        thumbnail = Load(path, size, modified);
+
+        if (thumbnail == nullptr)
+        {
+            thumbnail = Generate(path);
+
+            if (thumbnail != nullptr && !sizeError && !modifiedError)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _pendingWrites.push_back({path, size, modified, thumbnail});
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _entries.find(path);
+        if (shouldMake && found != _entries.end())
+        {
+            found->second.state = thumbnail != nullptr ? DecodeStates::Ready : DecodeStates::Failed;
+            found->second.thumbnail = thumbnail;
+
+            _lru.push_front(path);
+            found->second.lruPosition = _lru.begin();
+
+            if (thumbnail != nullptr)
+            {
+                _usedBytes += thumbnail->ByteSize();
+            }
+
+            Evict();
+        }
+
+        // Written in batches, one transaction per thumbnail is slow
+        if (_pendingWrites.size() >= THUMBNAIL_WRITE_BATCH || (_jobsInFlight == 1 && !_pendingWrites.empty()))
+        {
+            toStore.swap(_pendingWrites);
+        }
+    }
+
+    Store(toStore);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _jobsInFlight--;
+        _jobsDone.notify_all();
+    }
+
+    if (shouldMake)
+    {
+        _frameScheduler->RequestFrame();
+    }
+}
+
+// Camera previews in jpegs are good enough for a grid and take no decoding
+// of the full image, other images are decoded at a reduced size. The box
+// filter of the decoder gets them to about twice the size, Lanczos does the
+// rest so they stay sharp. Thumbnails are stored upright.
+std::shared_ptr<DecodedImage> ThumbnailCache::Generate(
+    const std::filesystem::path &path)
+{
+    std::shared_ptr<DecodedImage> thumbnail;
+
+    if (ImageDecoder::IsJpeg(path))
+    {
+        auto embedded = ImageDecoder::DecodeEmbeddedThumbnail(path);
+        if (embedded != nullptr && std::max(embedded->Width(), embedded->Height()) >= THUMBNAIL_MIN_EMBEDDED_SIZE)
+        {
+            thumbnail = embedded;
+        }
+    }
+
+    if (thumbnail == nullptr)
+    {
+        thumbnail = ImageDecoder::Decode(path, THUMBNAIL_SIZE * 2);
+    }
+
+    if (thumbnail == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto longest = std::max(thumbnail->Width(), thumbnail->Height());
+    if (longest > THUMBNAIL_SIZE)
+    {
+        auto scale = static_cast<float>(THUMBNAIL_SIZE) / static_cast<float>(longest);
+        auto resized = ImageKernels::LanczosResize(
+            *thumbnail,
+            static_cast<int>(std::lround(thumbnail->Width() * scale)),
+            static_cast<int>(std::lround(thumbnail->Height() * scale)));
+
+        if (resized == nullptr)
+        {
+            return nullptr;
+        }
+
+        thumbnail = resized;
+    }
+
+    if (thumbnail->orientation != 1)
+    {
+        thumbnail = ImageKernels::Orient(*thumbnail, thumbnail->orientation);
+    }
+
+    return thumbnail;
+}
+
+std::shared_ptr<DecodedImage> ThumbnailCache::Load(
+    const std::filesystem::path &path,
+    double size,
+    double modified)
+{
+    std::vector<std::tuple<double, double, int, int, int, int, int, std::vector<char>>> rows;
+
+    {
+        std::lock_guard<std::mutex> lock(_dbMutex);
+
+        if (_db == nullptr)
+        {
+            return nullptr;
+        }
+
+        try
+        {
+            rows = _db->prepare<double, double, int, int, int, int, int, std::vector<char>>(
+                          "SELECT size, modified, width, height, orientation, original_width, original_height, pixels FROM Thumbnails WHERE path = ?", -1)
+                       .execute(path.u8string());
+        }
+        catch (std::exception &ex)
+        {
+            std::cout << _db->errmsg() << std::endl;
+        }
+    }
+
+    // A thumbnail of an older version of the file is made again
+    if (rows.empty() || std::get<0>(rows.front()) != size || std::get<1>(rows.front()) != modified)
+    {
+        return nullptr;
+    }
+
+    auto width = std::get<2>(rows.front());
+    auto height = std::get<3>(rows.front());
+    auto &compressed = std::get<7>(rows.front());
+
+    auto byteSize = static_cast<mz_ulong>(width) * height * 4;
+    auto pixels = static_cast<unsigned char *>(std::malloc(byteSize));
+    if (pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto uncompressedSize = byteSize;
+    auto status = mz_uncompress(pixels, &uncompressedSize, reinterpret_cast<const unsigned char *>(compressed.data()), static_cast<mz_ulong>(compressed.size()));
+    if (status != MZ_OK || uncompressedSize != byteSize)
+    {
+        std::free(pixels);
+
+        return nullptr;
+    }
+
+    DeltaDecode(pixels, width, height);
+
+    auto thumbnail = std::make_shared<DecodedImage>(width, height, pixels);
+    thumbnail->orientation = std::get<4>(rows.front());
+    thumbnail->originalWidth = std::get<5>(rows.front());
+    thumbnail->originalHeight = std::get<6>(rows.front());
+
+    return thumbnail;
+}
+
+void ThumbnailCache::Store(
+    const std::vector<StoredThumbnail> &thumbnails)
+{
+    if (thumbnails.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_dbMutex);
+
+    if (_db == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        _db->execute("BEGIN TRANSACTION", -1);
+
+        auto insert = _db->prepare(R"(INSERT OR REPLACE INTO Thumbnails (path, size, modified, width, height, orientation, original_width, original_height, pixels) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?))", -1);
+
+        std::vector<unsigned char> delta;
+
+        for (const auto &stored : thumbnails)
+        {
+            auto &thumbnail = *stored.thumbnail;
+
+            delta.assign(thumbnail.Pixels(), thumbnail.Pixels() + thumbnail.ByteSize());
+            DeltaEncode(delta.data(), thumbnail.Width(), thumbnail.Height());
+
+            auto compressedSize = mz_compressBound(static_cast<mz_ulong>(delta.size()));
+            std::vector<char> compressed(compressedSize);
+            if (mz_compress(reinterpret_cast<unsigned char *>(compressed.data()), &compressedSize, delta.data(), static_cast<mz_ulong>(delta.size())) != MZ_OK)
+            {
+                continue;
+            }
+
+            compressed.resize(compressedSize);
+
+            insert.execute(
+                stored.path.u8string(),
+                stored.size,
+                stored.modified,
+                thumbnail.Width(),
+                thumbnail.Height(),
+                thumbnail.orientation,
+                thumbnail.originalWidth,
+                thumbnail.originalHeight,
+                compressed);
+        }
+
+        _db->execute("COMMIT", -1);
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << _db->errmsg() << std::endl;
+
+        try
+        {
+            _db->execute("ROLLBACK", -1);
+        }
+        catch (std::exception &)
+        {
+        }
+    }
+}
+
+// Thumbnails somebody still wants are kept, even when that means going over budget
+void ThumbnailCache::Evict()
+{
+    auto it = _lru.end();
+    while (_usedBytes > _budget && it != _lru.begin())
+    {
+        --it;
+
+        auto found = _entries.find(*it);
+        if (!found->second.wantedBy.empty())
+        {
+            continue;
+        }
+
+        if (found->second.thumbnail != nullptr)
+        {
+            _usedBytes -= found->second.thumbnail->ByteSize();
+        }
+
+        _entries.erase(found);
+        it = _lru.erase(it);
+    }
+}
@@ -0,0 +1,113 @@
+#include "tiledimage.h"
+#include "imagekernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+TiledImage::TiledImage(
+    std::shared_ptr<DecodedImage> image)
+    : _image(image)
+{
+    auto longest = std::max(Width(), Height());
+
+    while ((longest >> (_levelCount - 1)) > TileSize)
+    {
+        _levelCount++;
+    }
+}
+
+int TiledImage::TilesX(
+    int level) const
+{
+    auto tileSpan = TileSize << level;
+
+    return (Width() + tileSpan - 1) / tileSpan;
+}
+
+int TiledImage::TilesY(
+    int level) const
+{
+    auto tileSpan = TileSize << level;
+
+    return (Height() + tileSpan - 1) / tileSpan;
+}
+
+int TiledImage::LevelForScale(
+    float scale) const
+{
+    if (scale >= 1.0f || scale <= 0.0f)
+    {
+        return 0;
+    }
+
+    auto level = static_cast<int>(std::floor(std::log2(1.0f / scale)));
+
+    return std::min(level, _levelCount - 1);
+}
+
+void TiledImage::TileBounds(
+    int level,
+    int x,
+    int y,
+    int &left,
+    int &top,
+    int &right,
+    int &bottom) const
+{
+    auto tileSpan = TileSize << level;
+
+    left = x * tileSpan;
+    top = y * tileSpan;
+    right = std::min(left + tileSpan, Width());
+    bottom = std::min(top + tileSpan, Height());
+}
+
+// Every pixel of a tile on level n is the average of a 2^n x 2^n block of the
+// full resolution image
+std::shared_ptr<DecodedImage> TiledImage::RenderTile(
+    int level,
+    int x,
+    int y) const
+{
+    int left, top, right, bottom;
+    TileBounds(level, x, y, left, top, right, bottom);
+
+    auto factor = 1 << level;
+    auto width = (right - left + factor - 1) / factor;
+    auto height = (bottom - top + factor - 1) / factor;
+
+    auto pixels = static_cast<unsigned char *>(malloc(static_cast<size_t>(width) * height * 4));
+    if (pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto source = _image->Pixels();
+    auto sourceStride = static_cast<size_t>(Width()) * 4;
+
+    if (level == 0)
+    {
+        for (int row = 0; row < height; row++)
+        {
+            memcpy(
+                pixels + static_cast<size_t>(row) * width * 4,
+                source + static_cast<size_t>(top + row) * sourceStride + static_cast<size_t>(left) * 4,
+                static_cast<size_t>(width) * 4);
+        }
+
+        return std::make_shared<DecodedImage>(width, height, pixels);
+    }
+
+    ImageKernels::BoxDownsample(
+        source + static_cast<size_t>(top) * sourceStride + static_cast<size_t>(left) * 4,
+        sourceStride,
+        right - left,
+        bottom - top,
+        factor,
+        pixels,
+        static_cast<size_t>(width) * 4);
+
+    return std::make_shared<DecodedImage>(width, height, pixels);
+}
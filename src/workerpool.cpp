@@ -0,0 +1,75 @@
+#include "workerpool.h"
+
+WorkerPool::WorkerPool(
+    size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = 4;
+    }
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        _threads.emplace_back([this]() { Work(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_jobsMutex);
+        _isStopping = true;
+    }
+
+    _jobsAvailable.notify_all();
+
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<void> WorkerPool::Enqueue(
+    std::function<void()> job)
+{
+    std::packaged_task<void()> task(std::move(job));
+    auto result = task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(_jobsMutex);
+        _jobs.push_back(std::move(task));
+    }
+
+    _jobsAvailable.notify_one();
+
+    return result;
+}
+
+void WorkerPool::Work()
+{
+    while (true)
+    {
+        std::packaged_task<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(_jobsMutex);
+
+            _jobsAvailable.wait(lock, [this]() { return _isStopping || !_jobs.empty(); });
+
+            if (_isStopping && _jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+
+        job();
+    }
+}
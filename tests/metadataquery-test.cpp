@@ -0,0 +1,69 @@
+// Checks how metadata queries are parsed and matched. Built with
+// -DDISK_DABBLE_TESTS=ON and run by ctest.
+
+#include "metadataquery.h"
+
+#include <cstdio>
+#include <string>
+
+static int failures = 0;
+
+static void Check(
+    bool condition,
+    const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static FileMetadata File(
+    const std::string &name,
+    const std::string &owner)
+{
+    FileMetadata metadata;
+    metadata.path = name;
+    metadata.type = FileTypes::File;
+    metadata.owner = owner;
+
+    return metadata;
+}
+
+static void CheckNameTerms()
+{
+    MetadataQuery query;
+
+    Check(query.Parse("*.log *.txt name:a*,b* size>1"), "name terms parse");
+    Check(query.NameGlobs().size() == 4, "every name term is kept");
+
+    Check(query.Parse("*.c"), "a second query parses");
+    Check(query.NameGlobs().size() == 1, "a second query starts empty");
+}
+
+static void CheckOwnerTerms()
+{
+    MetadataQuery query;
+
+    Check(query.Parse("owner:alice owner:bob,carol"), "two owner terms parse");
+    Check(query.Owners().size() == 3, "every owner term is kept");
+    Check(query.Matches(File("a.txt", "alice"), 0), "the first owner term matches");
+    Check(query.Matches(File("b.txt", "Bob"), 0), "the second owner term matches");
+    Check(!query.Matches(File("d.txt", "dave"), 0), "other owners do not match");
+}
+
+int main()
+{
+    CheckNameTerms();
+    CheckOwnerTerms();
+
+    if (failures != 0)
+    {
+        return 1;
+    }
+
+    std::printf("ok\n");
+
+    return 0;
+}